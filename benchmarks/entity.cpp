@@ -0,0 +1,54 @@
+#include "ecs/ecs.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace
+{
+
+struct Position { float x, y, z; };
+struct Velocity { float x, y, z; };
+
+void RegisterComponents(ecs::Registry& registry)
+{
+    registry.RegisterComponent<Position>();
+    registry.RegisterComponent<Velocity>();
+}
+
+// Spawn and despawn state.range(0) entities with two components one at a time.
+void BM_CreateDestroyEntity(benchmark::State& state)
+{
+    const auto num_entities = static_cast<size_t>(state.range(0));
+    ecs::Registry registry;
+    RegisterComponents(registry);
+    std::vector<ecs::Entity> entities(num_entities);
+
+    for (auto _ : state) {
+        for (auto& entity : entities) {
+            entity = registry.CreateEntity().AddComponent<Position>().AddComponent<Velocity>().Build();
+            registry.GetComponent<Velocity>(entity) = Velocity{ 0.f, 1.f, 0.f };
+        }
+        for (auto entity : entities) registry.DestroyEntity(entity);
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+}
+
+// Spawn and despawn state.range(0) entities with two components through the bulk API.
+void BM_CreateDestroyEntities(benchmark::State& state)
+{
+    const auto num_entities = static_cast<size_t>(state.range(0));
+    ecs::Registry registry;
+    RegisterComponents(registry);
+
+    for (auto _ : state) {
+        auto entities = registry.CreateEntities(num_entities, Position{}, Velocity{ 0.f, 1.f, 0.f });
+        registry.DestroyEntities(entities);
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+}
+
+BENCHMARK(BM_CreateDestroyEntity)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CreateDestroyEntities)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+
+} // namespace
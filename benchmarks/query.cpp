@@ -0,0 +1,209 @@
+#include "ecs/ecs.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+struct Position { float x, y, z; };
+struct Velocity { float x, y, z; };
+struct Health   { float value; };
+struct Archetypal { float x, y, z; };
+struct ArchetypalVelocity { float x, y, z; };
+struct Frozen {};
+
+} // namespace
+
+template <>
+struct ecs::ComponentStorageTraits<Archetypal> { using StorageType = ArchetypeComponentStorage<Archetypal>; };
+template <>
+struct ecs::ComponentStorageTraits<ArchetypalVelocity> { using StorageType = ArchetypeComponentStorage<ArchetypalVelocity>; };
+
+namespace
+{
+
+// Registry with state.range(0) entities having Position and Velocity, every other one also Health.
+void Populate(ecs::Registry& registry, benchmark::State& state)
+{
+    registry.RegisterComponent<Position>();
+    registry.RegisterComponent<Velocity>();
+    registry.RegisterComponent<Health>();
+    auto entities = registry.CreateEntities(static_cast<size_t>(state.range(0)), Position{}, Velocity{ 1.f, 1.f, 1.f });
+    for (size_t i = 0; i < entities.size(); i += 2) registry.AddComponent<Health>(entities[i]);
+}
+
+// List all entities and filter those having Health.
+void BM_EntityQueryFilter(benchmark::State& state)
+{
+    ecs::Registry registry;
+    Populate(registry, state);
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        auto entities = query().Filter([&registry](ecs::Entity entity) { return registry.HasComponent<Health>(entity); });
+        benchmark::DoNotOptimize(entities.Entities().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Iterate the entities having Health through a cached query, which is kept up to date instead of being rebuilt.
+void BM_CachedQuery(benchmark::State& state)
+{
+    ecs::Registry registry;
+    Populate(registry, state);
+    auto& query = registry.CreateQuery<Position, Health>();
+    for (auto _ : state) {
+        query.Each<Position, Health>([](ecs::Entity, Position& p, Health& h) { h.value += p.x; });
+    }
+    state.SetItemsProcessed(state.iterations() * query.Size());
+}
+
+// Iterate a single component through a view.
+void BM_ViewSingle(benchmark::State& state)
+{
+    ecs::Registry registry;
+    Populate(registry, state);
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        query.View<Position>().Each([](ecs::Entity, Position& p) { p.x += 1.f; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Iterate two components through a view, looking up the second one per entity.
+void BM_ViewMulti(benchmark::State& state)
+{
+    ecs::Registry registry;
+    Populate(registry, state);
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        query.View<Position, const Velocity>().Each([](ecs::Entity, Position& p, const Velocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Iterate three components, one of them owned by half the entities.
+void BM_ViewSparse(benchmark::State& state)
+{
+    ecs::Registry registry;
+    Populate(registry, state);
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        query.View<Position, const Velocity, Health>().Each([](ecs::Entity, Position& p, const Velocity& v, Health& h) { p.x += v.x; h.value -= 1.f; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Registry with state.range(0) entities having Position, which received their Velocity in random order.
+void PopulateShuffled(ecs::Registry& registry, benchmark::State& state)
+{
+    registry.RegisterComponent<Position>();
+    registry.RegisterComponent<Velocity>();
+    auto entities = registry.CreateEntities(static_cast<size_t>(state.range(0)), Position{});
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+    for (ecs::Entity entity : entities) registry.AddComponent<Velocity>(entity) = Velocity{ 1.f, 1.f, 1.f };
+}
+
+// Join Position and Velocity stored in unrelated orders, optionally after sorting Velocity like Position.
+template <bool SORTED>
+void BM_ViewMultiShuffled(benchmark::State& state)
+{
+    ecs::Registry registry;
+    PopulateShuffled(registry, state);
+    if (SORTED) registry.SortComponentsAs<Velocity, Position>();
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        query.View<Position, const Velocity>().Each([](ecs::Entity, Position& p, const Velocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same join through an owning group, which walks both storages as parallel arrays.
+void BM_GroupEach(benchmark::State& state)
+{
+    ecs::Registry registry;
+    PopulateShuffled(registry, state);
+    auto& group = registry.CreateGroup<Position, Velocity>();
+    for (auto _ : state) {
+        group.Each([](ecs::Entity, Position& p, Velocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Registry with state.range(0) entities having Position and Health, every third one tagged Frozen.
+void PopulateTagged(ecs::Registry& registry, benchmark::State& state)
+{
+    registry.RegisterComponent<Position>();
+    registry.RegisterComponent<Health>();
+    registry.RegisterComponent<Frozen>();
+    auto entities = registry.CreateEntities(static_cast<size_t>(state.range(0)), Position{}, Health{});
+    for (size_t i = 0; i < entities.size(); i += 3) registry.AddComponent<Frozen>(entities[i]);
+}
+
+// Collect the entities having Position and Health but not Frozen by looking them up in the storages.
+void BM_FilterTags(benchmark::State& state)
+{
+    ecs::Registry registry;
+    PopulateTagged(registry, state);
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        auto entities = query().Filter([&registry](ecs::Entity entity) {
+            return registry.HasComponent<Position>(entity) && registry.HasComponent<Health>(entity) && !registry.HasComponent<Frozen>(entity);
+        });
+        benchmark::DoNotOptimize(entities.Entities().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same selection by scanning the component signatures.
+void BM_MatchTags(benchmark::State& state)
+{
+    ecs::Registry registry;
+    PopulateTagged(registry, state);
+    ecs::EntityQuery query(registry);
+    for (auto _ : state) {
+        auto entities = query.Match<Position, Health>(ecs::Without<Frozen>{});
+        benchmark::DoNotOptimize(entities.Entities().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Hands out the archetypes of the registry, which are only reachable from systems.
+struct ArchetypeWorldSystem : public ecs::System {
+    ecs::ArchetypeWorld*& world;
+    explicit ArchetypeWorldSystem(ecs::ArchetypeWorld*& world) : world(world) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override { world = &access.Archetypes(); }
+};
+
+// Iterate two components stored in archetype chunks.
+void BM_ArchetypeEach(benchmark::State& state)
+{
+    ecs::Registry registry;
+    registry.RegisterComponent<Archetypal>();
+    registry.RegisterComponent<ArchetypalVelocity>();
+    registry.CreateEntities(static_cast<size_t>(state.range(0)), Archetypal{}, ArchetypalVelocity{ 1.f, 1.f, 1.f });
+    ecs::ArchetypeWorld* world = nullptr;
+    registry.RegisterSystem<ArchetypeWorldSystem>(world);
+    registry.Run();
+    for (auto _ : state) {
+        world->Each<Archetypal, const ArchetypalVelocity>([](ecs::Entity, Archetypal& p, const ArchetypalVelocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_EntityQueryFilter)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CachedQuery)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ViewSingle)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ViewMulti)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ViewSparse)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ViewMultiShuffled, false)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ViewMultiShuffled, true)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FilterTags)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MatchTags)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GroupEach)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ArchetypeEach)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+
+} // namespace
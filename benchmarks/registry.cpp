@@ -0,0 +1,113 @@
+#include "ecs/ecs.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// Component of Size bytes.
+template <size_t Size>
+struct Payload { std::byte data[Size]; };
+
+// Registry holding state.range(0) entities without components.
+template <typename ComponentT>
+std::vector<ecs::Entity> CreateEntities(ecs::Registry& registry, benchmark::State& state)
+{
+    registry.RegisterComponent<ComponentT>();
+    return registry.CreateEntities(static_cast<size_t>(state.range(0)));
+}
+
+// Create state.range(0) entities one at a time.
+void BM_CreateEntity(benchmark::State& state)
+{
+    const auto num_entities = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        ecs::Registry registry;
+        for (size_t i = 0; i < num_entities; ++i) benchmark::DoNotOptimize(registry.CreateEntity().Build());
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+}
+
+// Add a component to state.range(0) entities one at a time, removing them again untimed.
+template <typename ComponentT>
+void BM_AddComponent(benchmark::State& state)
+{
+    ecs::Registry registry;
+    const auto entities = CreateEntities<ComponentT>(registry, state);
+    for (auto _ : state) {
+        for (auto entity : entities) benchmark::DoNotOptimize(&registry.AddComponent<ComponentT>(entity));
+        state.PauseTiming();
+        for (auto entity : entities) registry.RemoveComponent<ComponentT>(entity);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size());
+    state.SetBytesProcessed(state.iterations() * entities.size() * sizeof(ComponentT));
+}
+
+// Look up the component of state.range(0) entities by handle.
+template <typename ComponentT>
+void BM_GetComponent(benchmark::State& state)
+{
+    ecs::Registry registry;
+    const auto entities = CreateEntities<ComponentT>(registry, state);
+    for (auto entity : entities) registry.AddComponent<ComponentT>(entity);
+    for (auto _ : state) {
+        for (auto entity : entities) benchmark::DoNotOptimize(&registry.GetComponent<ComponentT>(entity));
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size());
+    state.SetBytesProcessed(state.iterations() * entities.size() * sizeof(ComponentT));
+}
+
+// Remove the component of state.range(0) entities one at a time, adding them again untimed.
+template <typename ComponentT>
+void BM_RegistryRemoveComponent(benchmark::State& state)
+{
+    ecs::Registry registry;
+    const auto entities = CreateEntities<ComponentT>(registry, state);
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto entity : entities) registry.AddComponent<ComponentT>(entity);
+        state.ResumeTiming();
+        for (auto entity : entities) registry.RemoveComponent<ComponentT>(entity);
+    }
+    state.SetItemsProcessed(state.iterations() * entities.size());
+}
+
+// Restore a registry of state.range(0) entities with a 64 byte component from an in-memory snapshot.
+void BM_LoadSnapshot(benchmark::State& state)
+{
+    ecs::Registry saved;
+    const auto entities = CreateEntities<Payload<64>>(saved, state);
+    for (ecs::Entity entity : entities) saved.AddComponent<Payload<64>>(entity);
+    std::stringstream stream;
+    saved.SaveSnapshot(stream);
+    const std::string snapshot = stream.str();
+
+    ecs::Registry registry;
+    registry.RegisterComponent<Payload<64>>();
+    for (auto _ : state) registry.LoadSnapshot(snapshot.data(), snapshot.size());
+    state.SetItemsProcessed(state.iterations() * entities.size());
+    state.SetBytesProcessed(state.iterations() * snapshot.size());
+}
+
+BENCHMARK(BM_CreateEntity)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_AddComponent, Payload<4>)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_AddComponent, Payload<64>)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_AddComponent, Payload<256>)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_GetComponent, Payload<4>)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_GetComponent, Payload<64>)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_GetComponent, Payload<256>)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_RegistryRemoveComponent, Payload<4>)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RegistryRemoveComponent, Payload<64>)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_LoadSnapshot)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,332 @@
+#include "ecs/ecs.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+struct Position { float x, y, z; };
+struct Transform { float matrix[64]; };
+struct Particle  { float x, y, z, vx, vy, vz; };
+struct SceneNode { float local[3], world[3]; ecs::Entity parent; };
+struct Body      { float x, y, z; };
+
+} // namespace
+
+template <>
+struct ecs::SoALayout<Particle> : ecs::Fields<&Particle::x, &Particle::y, &Particle::z, &Particle::vx, &Particle::vy, &Particle::vz> {};
+template <>
+struct ecs::SpatialLayout<Body> : ecs::Fields<&Body::x, &Body::y, &Body::z> {};
+
+namespace
+{
+
+// Remove every component of a storage holding state.range(0) components in random order.
+// The reported time per item stays flat across sizes when removal is O(1).
+template <typename StorageT>
+void BM_RemoveComponent(benchmark::State& state)
+{
+    const auto num_entities = static_cast<ecs::Entity>(state.range(0));
+    std::vector<ecs::Entity> entities(num_entities);
+    std::iota(entities.begin(), entities.end(), ecs::Entity(0));
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+
+    StorageT storage;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (ecs::Entity e = 0; e < num_entities; ++e) storage.AddComponent(e);
+        state.ResumeTiming();
+
+        for (ecs::Entity e : entities) storage.RemoveComponent(e);
+        benchmark::DoNotOptimize(storage.Size());
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+}
+
+BENCHMARK_TEMPLATE(BM_RemoveComponent, ecs::PackedComponentStorage<Position>)
+    ->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveComponent, ecs::SparseComponentStorage<Position>)
+    ->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveComponent, ecs::PagedComponentStorage<Position>)
+    ->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMillisecond);
+
+// Add state.range(0) components of 256 bytes one by one to an empty storage.
+// Reports the slowest single insertion as max_us, which exposes reallocation spikes of contiguous storages.
+template <typename StorageT>
+void BM_AddComponentLatency(benchmark::State& state)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto num_entities = static_cast<ecs::Entity>(state.range(0));
+    Clock::duration max_latency{};
+    for (auto _ : state) {
+        StorageT storage;
+        for (ecs::Entity e = 0; e < num_entities; ++e) {
+            const auto start = Clock::now();
+            benchmark::DoNotOptimize(&storage.AddComponent(e));
+            max_latency = std::max(max_latency, Clock::now() - start);
+        }
+        state.PauseTiming();
+        storage = StorageT();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+    state.counters["max_us"] = std::chrono::duration<double, std::micro>(max_latency).count();
+}
+
+BENCHMARK_TEMPLATE(BM_AddComponentLatency, ecs::SparseComponentStorage<Transform>)
+    ->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_AddComponentLatency, ecs::PagedComponentStorage<Transform>)
+    ->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMillisecond);
+
+constexpr float DELTA_TIME = 1.f / 60.f;
+
+// Integrate velocities of state.range(0) particles kept as an array of structs.
+void BM_IntegrateAoS(benchmark::State& state)
+{
+    const auto num_entities = static_cast<ecs::Entity>(state.range(0));
+    ecs::PackedComponentStorage<Particle> storage;
+    for (ecs::Entity e = 0; e < num_entities; ++e) storage.AddComponent(e) = Particle{ 0.f, 0.f, 0.f, 1.f, 2.f, 3.f };
+    for (auto _ : state) {
+        for (ecs::ComponentIndex i = 0; i < storage.Size(); ++i) {
+            Particle& p = storage[i];
+            p.x += p.vx * DELTA_TIME;
+            p.y += p.vy * DELTA_TIME;
+            p.z += p.vz * DELTA_TIME;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+}
+
+// Same workload over the columns of a SoAComponentStorage, which the compiler vectorizes.
+void BM_IntegrateSoA(benchmark::State& state)
+{
+    const auto num_entities = static_cast<ecs::Entity>(state.range(0));
+    ecs::SoAComponentStorage<Particle> storage;
+    for (ecs::Entity e = 0; e < num_entities; ++e) storage.AddComponent(e) = Particle{ 0.f, 0.f, 0.f, 1.f, 2.f, 3.f };
+    for (auto _ : state) {
+        auto integrate = [n = storage.Size()](float* __restrict position, const float* __restrict velocity) {
+            for (size_t i = 0; i < n; ++i) position[i] += velocity[i] * DELTA_TIME;
+        };
+        integrate(storage.Column<&Particle::x>().Data(), storage.Column<&Particle::vx>().Data());
+        integrate(storage.Column<&Particle::y>().Data(), storage.Column<&Particle::vy>().Data());
+        integrate(storage.Column<&Particle::z>().Data(), storage.Column<&Particle::vz>().Data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * num_entities);
+}
+
+BENCHMARK(BM_IntegrateAoS)->RangeMultiplier(10)->Range(1'000, 1'000'000);
+BENCHMARK(BM_IntegrateSoA)->RangeMultiplier(10)->Range(1'000, 1'000'000);
+
+// Random forest of state.range(0) nodes with shuffled entities: node k gets one of the nodes before it as parent.
+std::vector<std::pair<ecs::Entity, ecs::Entity>> MakeForest(benchmark::State& state)
+{
+    const auto num_entities = static_cast<ecs::Entity>(state.range(0));
+    std::vector<ecs::Entity> entities(num_entities);
+    std::iota(entities.begin(), entities.end(), ecs::Entity(0));
+    std::mt19937 random(42);
+    std::shuffle(entities.begin(), entities.end(), random);
+    std::vector<std::pair<ecs::Entity, ecs::Entity>> forest;
+    for (size_t k = 0; k < entities.size(); ++k) {
+        forest.emplace_back(entities[k], k < 16 ? ecs::INVALID_ENTITY : entities[random() % k]);
+    }
+    return forest;
+}
+
+// Compute world positions by walking up the parents stored in every component.
+void BM_PropagateParentLookup(benchmark::State& state)
+{
+    ecs::SparseComponentStorage<SceneNode> storage;
+    const auto forest = MakeForest(state);
+    for (const auto& [entity, parent] : forest) storage.AddComponent(entity) = SceneNode{ { 1.f, 2.f, 3.f }, {}, parent };
+    for (auto _ : state) {
+        for (ecs::ComponentIndex i = 0; i < storage.Size(); ++i) {
+            SceneNode& node = storage[i];
+            for (int c = 0; c < 3; ++c) node.world[c] = node.local[c];
+            for (ecs::Entity parent = node.parent; parent != ecs::INVALID_ENTITY;) {
+                const SceneNode& ancestor = storage.GetComponent(parent);
+                for (int c = 0; c < 3; ++c) node.world[c] += ancestor.local[c];
+                parent = ancestor.parent;
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same propagation over a HierarchyStorage in breadth-first order, a single sweep after the layout.
+void BM_PropagateHierarchy(benchmark::State& state)
+{
+    ecs::HierarchyStorage<SceneNode> storage;
+    const auto forest = MakeForest(state);
+    for (const auto& [entity, parent] : forest) storage.AddComponent(entity) = SceneNode{ { 1.f, 2.f, 3.f }, {}, parent };
+    for (const auto& [entity, parent] : forest) storage.SetParent(entity, parent);
+    storage.Layout();
+    for (auto _ : state) {
+        storage.Propagate([](SceneNode& node, const SceneNode* parent) {
+            for (int c = 0; c < 3; ++c) node.world[c] = node.local[c] + (parent ? parent->world[c] : 0.f);
+        });
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same propagation level by level from parallel tasks.
+void BM_ParallelPropagateHierarchy(benchmark::State& state)
+{
+    ecs::HierarchyStorage<SceneNode> storage;
+    const auto forest = MakeForest(state);
+    for (const auto& [entity, parent] : forest) storage.AddComponent(entity) = SceneNode{ { 1.f, 2.f, 3.f }, {}, parent };
+    for (const auto& [entity, parent] : forest) storage.SetParent(entity, parent);
+    tf::Executor executor;
+    tf::Taskflow taskflow;
+    taskflow.emplace([&storage](tf::Subflow& subflow) {
+        ecs::ParallelPropagate(subflow, storage, [](SceneNode& node, const SceneNode* parent) {
+            for (int c = 0; c < 3; ++c) node.world[c] = node.local[c] + (parent ? parent->world[c] : 0.f);
+        }, 4096);
+        subflow.join();
+    });
+    for (auto _ : state) executor.run(taskflow).wait();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// state.range(0) bodies scattered at a density of one per unit cube.
+template <typename StorageT>
+void Scatter(StorageT& storage, benchmark::State& state)
+{
+    std::mt19937 gen(42);
+    const float extent = std::cbrt(float(state.range(0)));
+    std::uniform_real_distribution<float> dist(0.f, extent);
+    for (ecs::Entity e = 0; e < ecs::Entity(state.range(0)); ++e) storage.AddComponent(e) = Body{ dist(gen), dist(gen), dist(gen) };
+}
+
+constexpr int NUM_RADIUS_QUERIES = 64;
+constexpr float QUERY_RADIUS = 2.f;
+
+// Radius queries answered by testing every component.
+void BM_RadiusScan(benchmark::State& state)
+{
+    ecs::SparseComponentStorage<Body> storage;
+    Scatter(storage, state);
+    const float extent = std::cbrt(float(state.range(0)));
+    for (auto _ : state) {
+        size_t found = 0;
+        for (int q = 0; q < NUM_RADIUS_QUERIES; ++q) {
+            const float c = extent * float(q) / NUM_RADIUS_QUERIES;
+            for (ecs::ComponentIndex i = 0; i < storage.Size(); ++i) {
+                const Body& body = storage[i];
+                const float dx = body.x - c, dy = body.y - c, dz = body.z - c;
+                found += dx * dx + dy * dy + dz * dz <= QUERY_RADIUS * QUERY_RADIUS;
+            }
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_RADIUS_QUERIES);
+}
+
+// The same radius queries answered by a SpatialHashStorage, visiting only the overlapped cells.
+void BM_RadiusSpatialHash(benchmark::State& state)
+{
+    ecs::SpatialHashStorage<Body> storage;
+    Scatter(storage, state);
+    storage.SetCellSize(QUERY_RADIUS);
+    const float extent = std::cbrt(float(state.range(0)));
+    for (auto _ : state) {
+        size_t found = 0;
+        for (int q = 0; q < NUM_RADIUS_QUERIES; ++q) {
+            const float c = extent * float(q) / NUM_RADIUS_QUERIES;
+            storage.QueryRadius({ c, c, c }, QUERY_RADIUS, [&found](ecs::Entity) { ++found; });
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_RADIUS_QUERIES);
+}
+
+// Re-index a tenth of the bodies after they moved.
+void BM_SpatialHashUpdate(benchmark::State& state)
+{
+    ecs::SpatialHashStorage<Body> storage;
+    Scatter(storage, state);
+    storage.SetCellSize(QUERY_RADIUS);
+    float step = 0.5f;
+    for (auto _ : state) {
+        for (ecs::Entity e = 0; e < ecs::Entity(state.range(0)); e += 10) {
+            storage.GetComponent(e).x += step;
+            storage.MarkChanged(e, 1);
+        }
+        storage.Update();
+        step = -step;
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) / 10);
+}
+
+// All pairs within QUERY_RADIUS by testing every pair.
+void BM_PairsBruteForce(benchmark::State& state)
+{
+    ecs::SparseComponentStorage<Body> storage;
+    Scatter(storage, state);
+    for (auto _ : state) {
+        size_t found = 0;
+        for (ecs::ComponentIndex i = 0; i < storage.Size(); ++i) {
+            for (ecs::ComponentIndex j = i + 1; j < storage.Size(); ++j) {
+                const Body& a = storage[i];
+                const Body& b = storage[j];
+                const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+                found += dx * dx + dy * dy + dz * dz <= QUERY_RADIUS * QUERY_RADIUS;
+            }
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_PairsSpatialHash(benchmark::State& state)
+{
+    ecs::SpatialHashStorage<Body> storage;
+    Scatter(storage, state);
+    storage.SetCellSize(QUERY_RADIUS);
+    for (auto _ : state) {
+        size_t found = 0;
+        storage.ForEachPair(QUERY_RADIUS, [&found](ecs::Entity, ecs::Entity) { ++found; });
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ParallelPairsSpatialHash(benchmark::State& state)
+{
+    ecs::SpatialHashStorage<Body> storage;
+    Scatter(storage, state);
+    storage.SetCellSize(QUERY_RADIUS);
+    std::atomic<size_t> found{ 0 };
+    tf::Executor executor;
+    tf::Taskflow taskflow;
+    taskflow.emplace([&](tf::Subflow& subflow) {
+        ecs::ParallelPairs(subflow, storage, QUERY_RADIUS, [&found](ecs::Entity, ecs::Entity) { found.fetch_add(1, std::memory_order_relaxed); });
+        subflow.join();
+    });
+    for (auto _ : state) executor.run(taskflow).wait();
+    benchmark::DoNotOptimize(found.load());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_PropagateParentLookup)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PropagateHierarchy)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ParallelPropagateHierarchy)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_RadiusScan)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RadiusSpatialHash)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SpatialHashUpdate)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PairsBruteForce)->RangeMultiplier(10)->Range(1'000, 10'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PairsSpatialHash)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ParallelPairsSpatialHash)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+} // namespace
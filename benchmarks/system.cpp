@@ -0,0 +1,184 @@
+#include "ecs/ecs.h"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+struct Position { float x, y, z; };
+struct Hit      { ecs::Entity target; float damage; };
+
+// Number of distinct system types available to the benchmarks.
+constexpr size_t MAX_SYSTEMS = 64;
+
+// Systems are indexed by their type, so every instance needs a type of its own.
+template <size_t I>
+struct EmptySystem : public ecs::System {
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override {}
+};
+
+// Reads all positions. Systems that only read never conflict and may run in parallel.
+template <size_t I>
+struct ReaderSystem : public ecs::System {
+    using Reads = ecs::Components<Position>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        float sum = 0.f;
+        entity_query.View<const Position>().Each([&sum](ecs::Entity, const Position& p) { sum += p.x; });
+        benchmark::DoNotOptimize(sum);
+    }
+};
+
+// Register the first count systems of SystemT<0>, ..., SystemT<MAX_SYSTEMS - 1>.
+template <template <size_t> class SystemT, size_t... Is>
+void RegisterSystems(ecs::Registry& registry, size_t count, std::index_sequence<Is...>)
+{
+    ((Is < count ? registry.RegisterSystem<SystemT<Is>>() : void()), ...);
+}
+
+// Run state.range(0) empty systems to measure the scheduling overhead of a step.
+void BM_RunOverhead(benchmark::State& state)
+{
+    ecs::Registry registry;
+    RegisterSystems<EmptySystem>(registry, static_cast<size_t>(state.range(0)), std::make_index_sequence<MAX_SYSTEMS>{});
+    for (auto _ : state) registry.Run();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Run 100 steps of state.range(0) empty systems within a single submission, see BM_RunOverhead.
+void BM_RunForOverhead(benchmark::State& state)
+{
+    constexpr size_t NUM_STEPS = 100;
+    ecs::Registry registry;
+    RegisterSystems<EmptySystem>(registry, static_cast<size_t>(state.range(0)), std::make_index_sequence<MAX_SYSTEMS>{});
+    for (auto _ : state) registry.RunFor(NUM_STEPS);
+    state.SetItemsProcessed(state.iterations() * state.range(0) * NUM_STEPS);
+}
+
+// Run state.range(1) systems iterating over 100k positions each on state.range(0) worker threads.
+void BM_SystemFanOut(benchmark::State& state)
+{
+    constexpr size_t NUM_ENTITIES = 100'000;
+    ecs::Registry registry(static_cast<size_t>(state.range(0)));
+    registry.RegisterComponent<Position>();
+    registry.CreateEntities(NUM_ENTITIES, Position{ 1.f, 1.f, 1.f });
+    RegisterSystems<ReaderSystem>(registry, static_cast<size_t>(state.range(1)), std::make_index_sequence<MAX_SYSTEMS>{});
+    for (auto _ : state) registry.Run();
+    state.SetItemsProcessed(state.iterations() * state.range(1) * NUM_ENTITIES);
+}
+
+// Number of systems sending events and events each of them sends per step from its subflow tasks.
+constexpr size_t NUM_SENDERS = 8;
+constexpr size_t NUM_TASKS   = 4;
+constexpr size_t NUM_HITS    = 10'000;
+
+// Events collected in a vector shared by all systems, guarded by a mutex.
+struct SharedHits {
+    std::mutex       mutex;
+    std::vector<Hit> hits;
+};
+
+template <size_t I>
+struct LockingSenderSystem : public ecs::System {
+    SharedHits& m_shared;
+    explicit LockingSenderSystem(SharedHits& shared) : m_shared(shared) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        for (size_t t = 0; t < NUM_TASKS; ++t) {
+            subflow.emplace([this]() {
+                for (size_t i = 0; i < NUM_HITS / NUM_TASKS; ++i) {
+                    std::lock_guard<std::mutex> lock(m_shared.mutex);
+                    m_shared.hits.push_back(Hit{ i, 1.f });
+                }
+            });
+        }
+        subflow.join();
+    }
+};
+
+struct LockingReceiverSystem : public ecs::System {
+    SharedHits& m_shared;
+    explicit LockingReceiverSystem(SharedHits& shared) : m_shared(shared) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        std::lock_guard<std::mutex> lock(m_shared.mutex);
+        float sum = 0.f;
+        for (const Hit& hit : m_shared.hits) sum += hit.damage;
+        m_shared.hits.clear();
+        benchmark::DoNotOptimize(sum);
+    }
+};
+
+template <size_t I>
+struct ChannelSenderSystem : public ecs::System {
+    using Sends = ecs::Events<Hit>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        for (size_t t = 0; t < NUM_TASKS; ++t) {
+            subflow.emplace([&access]() {
+                for (size_t i = 0; i < NUM_HITS / NUM_TASKS; ++i) access.Send(Hit{ i, 1.f });
+            });
+        }
+        subflow.join();
+    }
+};
+
+struct ChannelReceiverSystem : public ecs::System {
+    using Receives = ecs::Events<Hit>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        float sum = 0.f;
+        access.Receive<Hit>().ForEachBatch([&sum](const Hit* hits, size_t count) {
+            for (size_t i = 0; i < count; ++i) sum += hits[i].damage;
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+};
+
+template <template <size_t> class SystemT, size_t... Is, typename... Args>
+void RegisterSenders(ecs::Registry& registry, std::index_sequence<Is...>, Args&... args)
+{
+    (registry.RegisterSystem<SystemT<Is>>(args...), ...);
+}
+
+template <template <size_t> class SenderT, typename ReceiverT, size_t... Is>
+void PrecedeReceiver(ecs::Registry& registry, std::index_sequence<Is...>)
+{
+    (registry.Precede<SenderT<Is>, ReceiverT>(), ...);
+}
+
+// NUM_SENDERS systems send events to a receiver through a mutex-protected vector on state.range(0) worker threads.
+// The receiver has to be ordered after the senders explicitly.
+void BM_EventsLocking(benchmark::State& state)
+{
+    ecs::Registry registry(static_cast<size_t>(state.range(0)));
+    SharedHits shared;
+    RegisterSenders<LockingSenderSystem>(registry, std::make_index_sequence<NUM_SENDERS>{}, shared);
+    registry.RegisterSystem<LockingReceiverSystem>(shared);
+    PrecedeReceiver<LockingSenderSystem, LockingReceiverSystem>(registry, std::make_index_sequence<NUM_SENDERS>{});
+    for (auto _ : state) registry.Run();
+    state.SetItemsProcessed(state.iterations() * NUM_SENDERS * NUM_HITS);
+}
+
+// The same exchange through the event channel of the registry, which orders the receiver after the senders.
+void BM_EventsChannel(benchmark::State& state)
+{
+    ecs::Registry registry(static_cast<size_t>(state.range(0)));
+    registry.RegisterEvent<Hit>();
+    RegisterSenders<ChannelSenderSystem>(registry, std::make_index_sequence<NUM_SENDERS>{});
+    registry.RegisterSystem<ChannelReceiverSystem>();
+    for (auto _ : state) registry.Run();
+    state.SetItemsProcessed(state.iterations() * NUM_SENDERS * NUM_HITS);
+}
+
+BENCHMARK(BM_RunOverhead)->RangeMultiplier(4)->Range(1, MAX_SYSTEMS)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RunForOverhead)->RangeMultiplier(4)->Range(1, MAX_SYSTEMS)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SystemFanOut)->ArgsProduct({ { 1, 2, 4, 8 }, { 1, 8, 64 } })->ArgNames({ "threads", "systems" })->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_EventsLocking)->RangeMultiplier(2)->Range(1, 8)->ArgName("threads")->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_EventsChannel)->RangeMultiplier(2)->Range(1, 8)->ArgName("threads")->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,295 @@
+#include "archetype.h"
+
+namespace ecs
+{
+
+static inline size_t AlignUp(size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+
+Archetype::Archetype(std::vector<const ComponentInfo*> components)
+    : m_components(std::move(components)), m_column_offsets(m_components.size())
+{
+    size_t row_bytes = sizeof(Entity);
+    for (const auto* info : m_components) {
+        row_bytes         += info->size;
+        m_chunk_alignment  = std::max(m_chunk_alignment, info->alignment);
+    }
+    // Lay out the entity array followed by one aligned column per component.
+    auto layout = [this](size_t capacity) {
+        size_t offset = capacity * sizeof(Entity);
+        for (size_t i = 0; i < m_components.size(); ++i) {
+            offset              = AlignUp(offset, std::max(COLUMN_ALIGNMENT, m_components[i]->alignment));
+            m_column_offsets[i] = offset;
+            offset             += capacity * m_components[i]->size;
+        }
+        return offset;
+    };
+    // Fit as many rows into a chunk as possible, taking column padding into account.
+    m_chunk_capacity = std::max<size_t>(1, CHUNK_SIZE / row_bytes);
+    while (m_chunk_capacity > 1 && layout(m_chunk_capacity) > CHUNK_SIZE) --m_chunk_capacity;
+    m_chunk_bytes = std::max(CHUNK_SIZE, layout(m_chunk_capacity));
+}
+
+Archetype::~Archetype()
+{
+    for (size_t row = 0; row < m_size; ++row) {
+        for (size_t column = 0; column < m_components.size(); ++column) m_components[column]->destroy(Component(row, column));
+    }
+    for (auto* chunk : m_chunks) ::operator delete(chunk, std::align_val_t(m_chunk_alignment));
+}
+
+int Archetype::Column(ComponentId type) const
+{
+    for (size_t i = 0; i < m_components.size(); ++i) {
+        if (m_components[i]->type == type) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void* Archetype::Component(size_t row, size_t column) const
+{
+    const size_t chunk = row / m_chunk_capacity, offset = row % m_chunk_capacity;
+    return m_chunks[chunk] + m_column_offsets[column] + offset * m_components[column]->size;
+}
+
+void Archetype::MarkChanged(size_t row, size_t column, Tick tick)
+{
+    m_changed_ticks[row / m_chunk_capacity * m_components.size() + column].Raise(tick);
+}
+
+void Archetype::StampRow(size_t row, size_t column, Tick added, Tick changed)
+{
+    const size_t idx = row / m_chunk_capacity * m_components.size() + column;
+    m_added_ticks[idx]   = std::max(m_added_ticks[idx], added);
+    m_changed_ticks[idx].Raise(changed);
+}
+
+size_t Archetype::PushRow(Entity entity)
+{
+    if (m_size == m_chunks.size() * m_chunk_capacity) {
+        m_chunks.push_back(static_cast<std::byte*>(::operator new(m_chunk_bytes, std::align_val_t(m_chunk_alignment))));
+        m_added_ticks.resize(m_chunks.size() * m_components.size());
+        m_changed_ticks.resize(m_chunks.size() * m_components.size());
+    }
+    // A chunk starts over with fresh ticks once it gets its first row.
+    if (m_size % m_chunk_capacity == 0) {
+        const size_t first = m_size / m_chunk_capacity * m_components.size();
+        std::fill_n(m_added_ticks.begin() + first, m_components.size(), Tick(0));
+        for (size_t i = 0; i < m_components.size(); ++i) m_changed_ticks[first + i].Store(0);
+    }
+    const size_t row = m_size++;
+    RowEntity(row) = entity;
+    return row;
+}
+
+Entity Archetype::PopRow(size_t row)
+{
+    const size_t last  = m_size - 1;
+    Entity       moved = INVALID_ENTITY;
+    if (row != last) {
+        for (size_t column = 0; column < m_components.size(); ++column) {
+            m_components[column]->relocate(Component(row, column), Component(last, column));
+            StampRow(row, column, ChunkAddedTick(last / m_chunk_capacity, column), ChunkChangedTick(last / m_chunk_capacity, column));
+        }
+        moved          = RowEntity(last);
+        RowEntity(row) = moved;
+    }
+    --m_size;
+    // Keep one spare chunk around so that entities moving back and forth do not reallocate every time.
+    while (m_chunks.size() > 1 && (m_chunks.size() - 1) * m_chunk_capacity >= m_size + m_chunk_capacity) {
+        ::operator delete(m_chunks.back(), std::align_val_t(m_chunk_alignment));
+        m_chunks.pop_back();
+        m_added_ticks.resize(m_chunks.size() * m_components.size());
+        m_changed_ticks.resize(m_chunks.size() * m_components.size());
+    }
+    return moved;
+}
+
+void ArchetypeWorld::Add(Entity entity, const ComponentInfo* const* components, size_t count)
+{
+    Location& location = GetLocation(entity);
+    Move(entity, location, AddTarget(location.archetype, components, count));
+}
+
+void ArchetypeWorld::Add(const Entity* entities, size_t num_entities, const ComponentInfo* const* components, size_t count)
+{
+    // Entities coming from the same archetype share the target, which is typically the case for new entities.
+    Archetype* source = nullptr;
+    Archetype* target = nullptr;
+    for (size_t i = 0; i < num_entities; ++i) {
+        Location& location = GetLocation(entities[i]);
+        if (!target || location.archetype != source) {
+            source = location.archetype;
+            target = AddTarget(source, components, count);
+        }
+        Move(entities[i], location, target);
+    }
+}
+
+Archetype* ArchetypeWorld::AddTarget(Archetype* source, const ComponentInfo* const* components, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (source && source->Column(components[i]->type) >= 0) throw std::runtime_error("ArchetypeWorld: Entity already contains the specific component");
+    }
+    if (count == 1) {
+        // Single component transitions are cached on the source archetype.
+        auto& edges = source ? source->m_add_edges : m_root_edges;
+        auto  edge  = edges.find(components[0]->type);
+        if (edge == edges.end()) {
+            auto target_components = source ? source->m_components : std::vector<const ComponentInfo*>();
+            target_components.push_back(components[0]);
+            edge = edges.emplace(components[0]->type, FindOrCreate(std::move(target_components))).first;
+        }
+        return edge->second;
+    }
+    auto target_components = source ? source->m_components : std::vector<const ComponentInfo*>();
+    target_components.insert(target_components.end(), components, components + count);
+    return FindOrCreate(std::move(target_components));
+}
+
+void ArchetypeWorld::Remove(Entity entity, const ComponentId* types, size_t count)
+{
+    Location&  location = GetLocation(entity);
+    Archetype* source   = location.archetype;
+    for (size_t i = 0; i < count; ++i) {
+        if (!source || source->Column(types[i]) < 0) throw std::runtime_error("ArchetypeWorld: Entity does not contain the specified component");
+    }
+
+    Archetype* target = nullptr;
+    auto       edge   = count == 1 ? source->m_remove_edges.find(types[0]) : source->m_remove_edges.end();
+    if (edge != source->m_remove_edges.end()) {
+        target = edge->second;
+    }
+    else {
+        auto target_components = source->m_components;
+        target_components.erase(std::remove_if(target_components.begin(), target_components.end(), [types, count](const ComponentInfo* info) {
+            return std::find(types, types + count, info->type) != types + count;
+        }), target_components.end());
+        target = FindOrCreate(std::move(target_components));
+        if (count == 1) source->m_remove_edges.emplace(types[0], target);
+    }
+    Move(entity, location, target);
+}
+
+void ArchetypeWorld::Destroy(Entity entity)
+{
+    if (!Contains(entity)) return;
+    Move(entity, m_locations[GetEntityIndex(entity)], nullptr);
+}
+
+void ArchetypeWorld::Clear()
+{
+    m_locations.clear();
+    m_root_edges.clear();
+    m_archetype_index.clear();
+    m_archetypes.clear();
+}
+
+size_t ArchetypeWorld::Count(ComponentId type) const
+{
+    size_t count = 0;
+    for (const auto& archetype : m_archetypes) {
+        if (archetype->Column(type) >= 0) count += archetype->Size();
+    }
+    return count;
+}
+
+Tick ArchetypeWorld::AddedTick(Entity entity, ComponentId type) const
+{
+    if (!Contains(entity)) return 0;
+    const Location& location = m_locations[GetEntityIndex(entity)];
+    const int column = location.archetype->Column(type);
+    return column < 0 ? 0 : location.archetype->ChunkAddedTick(location.row / location.archetype->ChunkCapacity(), column);
+}
+
+Tick ArchetypeWorld::ChangedTick(Entity entity, ComponentId type) const
+{
+    if (!Contains(entity)) return 0;
+    const Location& location = m_locations[GetEntityIndex(entity)];
+    const int column = location.archetype->Column(type);
+    return column < 0 ? 0 : location.archetype->ChunkChangedTick(location.row / location.archetype->ChunkCapacity(), column);
+}
+
+void ArchetypeWorld::MarkChanged(Entity entity, ComponentId type, Tick tick)
+{
+    if (!Contains(entity)) return;
+    const Location& location = m_locations[GetEntityIndex(entity)];
+    const int column = location.archetype->Column(type);
+    if (column >= 0) location.archetype->MarkChanged(location.row, column, tick);
+}
+
+void* ArchetypeWorld::Find(Entity entity, ComponentId type) const
+{
+    if (!Contains(entity)) return nullptr;
+    const Location& location = m_locations[GetEntityIndex(entity)];
+    const int column = location.archetype->Column(type);
+    return column < 0 ? nullptr : location.archetype->Component(location.row, column);
+}
+
+ArchetypeWorld::Location& ArchetypeWorld::GetLocation(Entity entity)
+{
+    const EntityIndex idx = GetEntityIndex(entity);
+    if (idx >= m_locations.size()) m_locations.resize(size_t(idx) + 1);
+    Location& location = m_locations[idx];
+    if (location.archetype && location.archetype->RowEntity(location.row) != entity) {
+        throw std::runtime_error("ArchetypeWorld: Entity index is in use by another version of the entity");
+    }
+    return location;
+}
+
+bool ArchetypeWorld::Contains(Entity entity) const
+{
+    const EntityIndex idx = GetEntityIndex(entity);
+    if (idx >= m_locations.size()) return false;
+    const Location& location = m_locations[idx];
+    return location.archetype && location.archetype->RowEntity(location.row) == entity;
+}
+
+Archetype* ArchetypeWorld::FindOrCreate(std::vector<const ComponentInfo*> components)
+{
+    if (components.empty()) return nullptr;
+    std::sort(components.begin(), components.end(), [](const ComponentInfo* a, const ComponentInfo* b) { return a->type < b->type; });
+
+    std::vector<ComponentId> key;
+    key.reserve(components.size());
+    for (const auto* info : components) key.push_back(info->type);
+
+    auto archetype = m_archetype_index.find(key);
+    if (archetype != m_archetype_index.end()) return archetype->second;
+    m_archetypes.push_back(std::make_unique<Archetype>(std::move(components)));
+    m_archetype_index.emplace(std::move(key), m_archetypes.back().get());
+    return m_archetypes.back().get();
+}
+
+void ArchetypeWorld::Move(Entity entity, Location& location, Archetype* target)
+{
+    Archetype* source = location.archetype;
+    size_t     row    = 0;
+    if (target) {
+        row = target->PushRow(entity);
+        for (size_t column = 0; column < target->m_components.size(); ++column) {
+            const ComponentInfo* info = target->m_components[column];
+            const int source_column   = source ? source->Column(info->type) : -1;
+            if (source_column >= 0) {
+                info->relocate(target->Component(row, column), source->Component(location.row, source_column));
+                const size_t source_chunk = location.row / source->m_chunk_capacity;
+                target->StampRow(row, column, source->ChunkAddedTick(source_chunk, source_column), source->ChunkChangedTick(source_chunk, source_column));
+            }
+            else {
+                info->construct(target->Component(row, column));
+                target->StampRow(row, column, m_tick, m_tick);
+            }
+        }
+    }
+    if (source) {
+        for (size_t column = 0; column < source->m_components.size(); ++column) {
+            if (!target || target->Column(source->m_components[column]->type) < 0) {
+                source->m_components[column]->destroy(source->Component(location.row, column));
+            }
+        }
+        const Entity moved = source->PopRow(location.row);
+        if (moved != INVALID_ENTITY) m_locations[GetEntityIndex(moved)].row = location.row;
+    }
+    location = Location{ target, row };
+}
+
+} // namespace ecs
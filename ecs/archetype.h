@@ -0,0 +1,359 @@
+#ifndef ARCHETYPE_H
+#define ARCHETYPE_H
+
+#include "ecs/common.h"
+#include "ecs/component.h"
+#include "ecs/view.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+
+// Type-erased description of a component type stored in archetype chunks.
+struct ComponentInfo {
+    ComponentId     type;
+    size_t          size;
+    size_t          alignment;
+    // Value-initialize a component at dst.
+    void (*construct)(void* dst);
+    // Move-construct a component at dst from src and destroy src.
+    void (*relocate)(void* dst, void* src);
+    // Destroy the component at dst.
+    void (*destroy)(void* dst);
+};
+
+// Get the ComponentInfo of a type. The returned reference stays valid for the lifetime of the program.
+template <typename T>
+const ComponentInfo& GetComponentInfo();
+
+// Set of entities sharing exactly the same set of archetype components.
+// Components are stored in fixed-size chunks holding one column per component type (SoA),
+// so iterating over an archetype is a linear sweep without any per-entity lookups.
+class Archetype {
+public:
+    // Target number of bytes per chunk. Chunks only grow beyond this if a single row does not fit.
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    // Minimum alignment of every column within a chunk.
+    static constexpr size_t COLUMN_ALIGNMENT = 64;
+
+    explicit Archetype(std::vector<const ComponentInfo*> components);
+    ~Archetype();
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    // Component types of this archetype sorted by type.
+    const std::vector<const ComponentInfo*>& Components() const { return m_components; }
+    // Column index of a component type, or -1 if the archetype does not contain it.
+    int Column(ComponentId type) const;
+
+    // Number of entities in this archetype.
+    size_t Size() const { return m_size; }
+    // Maximum number of entities per chunk.
+    size_t ChunkCapacity() const { return m_chunk_capacity; }
+    // Number of chunks holding at least one entity.
+    size_t NumChunks() const { return (m_size + m_chunk_capacity - 1) / m_chunk_capacity; }
+    // Number of entities stored in a chunk.
+    size_t ChunkSize(size_t chunk) const { return std::min(m_chunk_capacity, m_size - chunk * m_chunk_capacity); }
+
+    // Entities of a chunk, ChunkSize(chunk) elements.
+    Entity* ChunkEntities(size_t chunk) const { return reinterpret_cast<Entity*>(m_chunks[chunk]); }
+    // Column of a chunk, ChunkSize(chunk) elements of the column's component type.
+    void* ChunkColumn(size_t chunk, size_t column) const { return m_chunks[chunk] + m_column_offsets[column]; }
+    // Component of a row.
+    void* Component(size_t row, size_t column) const;
+    // Entity of a row.
+    Entity& RowEntity(size_t row) const { return ChunkEntities(row / m_chunk_capacity)[row % m_chunk_capacity]; }
+
+    // Latest tick at which a component of the column was added to or changed in the chunk.
+    // Ticks are kept per chunk, so they are an upper bound for every row of the chunk.
+    Tick ChunkAddedTick(size_t chunk, size_t column) const   { return m_added_ticks[chunk * m_components.size() + column]; }
+    Tick ChunkChangedTick(size_t chunk, size_t column) const { return m_changed_ticks[chunk * m_components.size() + column].Load(); }
+    // Stamp the column of the chunk holding row as changed at tick.
+    // Rows share the tick of their chunk, so distinct rows may be stamped concurrently, e.g., within ParallelEach().
+    void MarkChanged(size_t row, size_t column, Tick tick);
+
+private:
+    // Changed tick of a chunk column, raised atomically by concurrent writers. Copyable, so it can be kept in a
+    // vector, which must not be resized while it is being raised.
+    class AtomicTick {
+    public:
+        AtomicTick() noexcept = default;
+        AtomicTick(const AtomicTick& rhs) noexcept : m_tick(rhs.Load()) {}
+        AtomicTick& operator=(const AtomicTick& rhs) noexcept { Store(rhs.Load()); return *this; }
+
+        Tick Load() const noexcept { return m_tick.load(std::memory_order_relaxed); }
+        void Store(Tick tick) noexcept { m_tick.store(tick, std::memory_order_relaxed); }
+        // Raise the tick to at least tick.
+        void Raise(Tick tick) noexcept
+        {
+            Tick current = Load();
+            while (current < tick && !m_tick.compare_exchange_weak(current, tick, std::memory_order_relaxed)) {}
+        }
+    private:
+        std::atomic<Tick> m_tick{ 0 };
+    };
+
+    // Append a row for an entity with its components left unconstructed. Returns the new row.
+    size_t PushRow(Entity entity);
+    // Raise the ticks of the column of the chunk holding row to at least added and changed.
+    void StampRow(size_t row, size_t column, Tick added, Tick changed);
+    // Remove a row whose components were already destroyed or relocated by moving the last row into it.
+    // Returns the entity moved into row, or INVALID_ENTITY if row was the last one.
+    Entity PopRow(size_t row);
+
+    std::vector<const ComponentInfo*> m_components;
+    std::vector<size_t>               m_column_offsets;
+    std::vector<std::byte*>           m_chunks;
+    // Per chunk and column ticks, indexed by chunk * m_components.size() + column.
+    std::vector<Tick>                 m_added_ticks;
+    std::vector<AtomicTick>           m_changed_ticks;
+    size_t m_chunk_alignment = COLUMN_ALIGNMENT;
+    size_t m_chunk_capacity  = 0;
+    size_t m_chunk_bytes     = CHUNK_SIZE;
+    size_t m_size            = 0;
+
+    // Cached transitions for adding or removing a single component type.
+    std::unordered_map<ComponentId, Archetype*> m_add_edges, m_remove_edges;
+
+    friend class ArchetypeWorld;
+};
+
+// Owns all archetypes and keeps track of the archetype and row of every entity.
+// Entities are moved between archetypes whenever their set of archetype components changes.
+// Adding or removing several components at once performs a single move.
+class ArchetypeWorld {
+public:
+    ArchetypeWorld() = default;
+    ArchetypeWorld(const ArchetypeWorld&) = delete;
+    ArchetypeWorld& operator=(const ArchetypeWorld&) = delete;
+
+    // Add components to an entity with a single archetype move.
+    // Throws std::runtime_error if the entity already contains one of the components.
+    void Add(Entity entity, const ComponentInfo* const* components, size_t count);
+    // Add components to several entities, each of them moved once.
+    void Add(const Entity* entities, size_t num_entities, const ComponentInfo* const* components, size_t count);
+    // Remove components from an entity with a single archetype move.
+    // Throws std::runtime_error if the entity does not contain one of the components.
+    void Remove(Entity entity, const ComponentId* types, size_t count);
+    // Remove all archetype components of an entity.
+    void Destroy(Entity entity);
+    // Remove all entities and archetypes.
+    void Clear();
+
+    // True if entity has a component of the given type.
+    bool Has(Entity entity, ComponentId type) const { return Find(entity, type) != nullptr; }
+    // Number of entities having a component of the given type.
+    size_t Count(ComponentId type) const;
+
+    template <typename T>
+    T& Add(Entity entity);
+    template <typename T>
+    void Remove(Entity entity);
+    // Get component of an entity, throws std::runtime_error if the entity does not have it.
+    template <typename T>
+    T& Get(Entity entity) const;
+
+    // Call f(Entity, Ts&...) for every entity having all components Ts.
+    // Matching archetypes are walked chunk by chunk, so no per-entity membership tests are needed.
+    template <typename... Ts, typename F>
+    void Each(F&& f) const;
+    // Call f(size_t count, const Entity* entities, Ts*... columns) for every chunk containing all components Ts.
+    template <typename... Ts, typename F>
+    void EachChunk(F&& f) const;
+
+    // Call f(size_t count, const Entity* entities, Ts*... columns) for every chunk containing all components Ts
+    // whose columns of ChangedTs all changed after since. Chunks are skipped as a whole, so f may see unchanged rows.
+    template <typename... Ts, typename... ChangedTs, typename F>
+    void EachChunk(Changed<ChangedTs...>, Tick since, F&& f) const;
+
+    // Tick at which the chunk holding the component of an entity was added to or changed, 0 if the entity has none.
+    Tick AddedTick(Entity entity, ComponentId type) const;
+    Tick ChangedTick(Entity entity, ComponentId type) const;
+    // Stamp the chunk holding the component of an entity as changed at tick. Does nothing if the entity has none.
+    void MarkChanged(Entity entity, ComponentId type, Tick tick);
+
+    // Tick stamped on components added to or moved between archetypes. Set by the Registry.
+    Tick GetTick() const { return m_tick; }
+    void SetTick(Tick tick) { m_tick = tick; }
+
+    // All archetypes created so far.
+    const std::vector<std::unique_ptr<Archetype>>& Archetypes() const { return m_archetypes; }
+
+private:
+    // Archetype and row of an entity. Entities without archetype components have no archetype.
+    struct Location {
+        Archetype* archetype = nullptr;
+        size_t     row       = 0;
+    };
+
+    // Get component pointer of an entity or nullptr if it does not have the component.
+    void* Find(Entity entity, ComponentId type) const;
+    // Get location of an entity, growing the location table if needed.
+    // Throws std::runtime_error if the index of the entity is used by another version of it.
+    Location& GetLocation(Entity entity);
+    // True if the entity has any archetype components.
+    bool Contains(Entity entity) const;
+    // Get the archetype of entities in source after adding components.
+    // Throws std::runtime_error if source already contains one of the components.
+    Archetype* AddTarget(Archetype* source, const ComponentInfo* const* components, size_t count);
+    // Find the archetype for a set of components, creating it if needed. Returns nullptr for an empty set.
+    Archetype* FindOrCreate(std::vector<const ComponentInfo*> components);
+    // Move an entity into target, relocating shared components and constructing new ones.
+    void Move(Entity entity, Location& location, Archetype* target);
+    // Invoke an EachChunk() callback with the columns of a chunk.
+    template <typename... Ts, typename F, size_t... Is>
+    static void InvokeChunk(F& f, const Archetype& archetype, size_t chunk, size_t count, const int* columns, std::index_sequence<Is...>)
+    {
+        f(count, static_cast<const Entity*>(archetype.ChunkEntities(chunk)), static_cast<Ts*>(archetype.ChunkColumn(chunk, columns[Is]))...);
+    }
+
+    std::vector<std::unique_ptr<Archetype>>            m_archetypes;
+    std::map<std::vector<ComponentId>, Archetype*>     m_archetype_index;
+    // Transitions for entities without any archetype components.
+    std::unordered_map<ComponentId, Archetype*>        m_root_edges;
+    std::vector<Location>                              m_locations;
+    Tick                                               m_tick = 0;
+};
+
+// Component storage placing ComponentT into the archetype chunks owned by the Registry.
+// Register with registry.RegisterComponent<T, ArchetypeComponentStorage<T>>() (or through ComponentStorageTraits) and
+// iterate several archetype components at once through ComponentAccess::Archetypes().Each<A, B>(...).
+template <typename T>
+class ArchetypeComponentStorage : public ComponentStorageInterface {
+public:
+    using ComponentType = T;
+
+    explicit ArchetypeComponentStorage(ArchetypeWorld& world) noexcept : m_world(world) {}
+    ~ArchetypeComponentStorage() override = default;
+
+    ArchetypeComponentStorage(const ArchetypeComponentStorage&) = delete;
+    ArchetypeComponentStorage& operator=(const ArchetypeComponentStorage&) = delete;
+
+    // Get collection size.
+    size_t Size() const override { return m_world.Count(GetComponentId<T>()); }
+
+    // True if entity has a component in this collection.
+    bool HasComponent(Entity entity) const override { return m_world.Has(entity, GetComponentId<T>()); }
+
+    // Remove component from entity. Moves the entity to another archetype.
+    void RemoveComponent(Entity entity) override { m_world.Remove<T>(entity); }
+
+    // Get component for entity, throws std::runtime_error if HasComponent(entity) == false.
+    T&       GetComponent(Entity entity)       { return m_world.Get<T>(entity); }
+    const T& GetComponent(Entity entity) const { return m_world.Get<T>(entity); }
+
+    // Add a component to an entity. Moves the entity to another archetype.
+    T& AddComponent(Entity entity) { return m_world.Add<T>(entity); }
+
+    // Tick at which the chunk holding the component of an entity was added to or changed, 0 if the entity has none.
+    Tick AddedTick(Entity entity) const   { return m_world.AddedTick(entity, GetComponentId<T>()); }
+    Tick ChangedTick(Entity entity) const { return m_world.ChangedTick(entity, GetComponentId<T>()); }
+    // Stamp the chunk holding the component of an entity as changed at tick. Distinct entities may be stamped
+    // concurrently, as long as no entity is added or removed meanwhile.
+    void MarkChanged(Entity entity, Tick tick) { m_world.MarkChanged(entity, GetComponentId<T>(), tick); }
+
+    // Archetypes the components are stored in.
+    ArchetypeWorld& World() const { return m_world; }
+
+private:
+    ArchetypeWorld& m_world;
+};
+
+// True if StorageT places its components into archetype chunks.
+template <typename StorageT>
+struct IsArchetypeStorage : std::false_type {};
+template <typename T>
+struct IsArchetypeStorage<ArchetypeComponentStorage<T>> : std::true_type {};
+
+template <typename T>
+inline const ComponentInfo& GetComponentInfo()
+{
+    static const ComponentInfo info = {
+        GetComponentId<T>(), sizeof(T), alignof(T),
+        [](void* dst) { new (dst) T(); },
+        [](void* dst, void* src) {
+            new (dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+        },
+        [](void* dst) { static_cast<T*>(dst)->~T(); },
+    };
+    return info;
+}
+
+template <typename T>
+inline T& ArchetypeWorld::Add(Entity entity)
+{
+    const ComponentInfo* info = &GetComponentInfo<T>();
+    Add(entity, &info, 1);
+    return *static_cast<T*>(Find(entity, GetComponentId<T>()));
+}
+
+template <typename T>
+inline void ArchetypeWorld::Remove(Entity entity)
+{
+    const ComponentId type = GetComponentId<T>();
+    Remove(entity, &type, 1);
+}
+
+template <typename T>
+inline T& ArchetypeWorld::Get(Entity entity) const
+{
+    void* component = Find(entity, GetComponentId<T>());
+    if (!component) throw std::runtime_error("ArchetypeWorld: Entity does not contain the specific component");
+    return *static_cast<T*>(component);
+}
+
+template <typename... Ts, typename F>
+inline void ArchetypeWorld::EachChunk(F&& f) const
+{
+    static_assert(sizeof...(Ts) > 0, "ArchetypeWorld: at least one component type has to be given");
+    for (const auto& archetype : m_archetypes) {
+        const int columns[] = { archetype->Column(GetComponentId<Ts>())... };
+        if (std::find(std::begin(columns), std::end(columns), -1) != std::end(columns)) continue;
+        for (size_t chunk = 0; chunk < archetype->NumChunks(); ++chunk) {
+            const size_t count = archetype->ChunkSize(chunk);
+            if (count != 0) InvokeChunk<Ts...>(f, *archetype, chunk, count, columns, std::index_sequence_for<Ts...>{});
+        }
+    }
+}
+
+template <typename... Ts, typename... ChangedTs, typename F>
+inline void ArchetypeWorld::EachChunk(Changed<ChangedTs...>, Tick since, F&& f) const
+{
+    static_assert(sizeof...(Ts) > 0, "ArchetypeWorld: at least one component type has to be given");
+    for (const auto& archetype : m_archetypes) {
+        const int columns[] = { archetype->Column(GetComponentId<Ts>())... };
+        if (std::find(std::begin(columns), std::end(columns), -1) != std::end(columns)) continue;
+        const int changed[] = { -2, archetype->Column(GetComponentId<ChangedTs>())... };
+        if (std::find(std::begin(changed), std::end(changed), -1) != std::end(changed)) continue;
+        for (size_t chunk = 0; chunk < archetype->NumChunks(); ++chunk) {
+            const bool skip = std::any_of(std::begin(changed) + 1, std::end(changed), [&](int column) { return archetype->ChunkChangedTick(chunk, column) <= since; });
+            if (!skip) InvokeChunk<Ts...>(f, *archetype, chunk, archetype->ChunkSize(chunk), columns, std::index_sequence_for<Ts...>{});
+        }
+    }
+}
+
+template <typename... Ts, typename F>
+inline void ArchetypeWorld::Each(F&& f) const
+{
+    EachChunk<Ts...>([&f](size_t count, const Entity* entities, Ts*... columns) {
+        for (size_t i = 0; i < count; ++i) f(entities[i], columns[i]...);
+    });
+}
+
+} // namespace ecs
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include "ecs/common.h"
+#include "ecs/memory.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+
+class Registry;
+
+// Records structural changes, i.e., entity creation and destruction and component addition and removal, to be applied later.
+// Systems get the command buffer of their worker thread from ComponentAccess::Commands(), so recording never contends.
+// The Registry plays back all command buffers in a single pass sorted by component type at the end of every Run() step.
+// Playback is lenient: commands for entities that are not alive anymore are dropped, adding an existing component
+// replaces its value and removing a missing component does nothing.
+class CommandBuffer {
+public:
+    CommandBuffer() = default;
+    // A buffer of a Registry, identified by its index among all buffers of the registry.
+    explicit CommandBuffer(EntityVersion index) : m_index(index) {}
+    ~CommandBuffer() { Clear(); }
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+    CommandBuffer(CommandBuffer&&) = default;
+    CommandBuffer& operator=(CommandBuffer&&) = default;
+
+    // Create an entity on playback. The returned placeholder can be used with the commands of every buffer of the
+    // same registry, e.g., from subflow tasks running on other workers, until the commands are played back.
+    Entity CreateEntity() { return MakeEntity(m_num_created++, PENDING_VERSION - m_index); }
+
+    // Destroy an entity along with its components on playback.
+    void DestroyEntity(Entity entity) { m_commands.push_back({ INVALID_COMPONENT_ID, ANY_STORAGE, entity, nullptr, nullptr, nullptr }); }
+
+    // Add a component with the given value to an entity on playback.
+    template <typename ComponentT>
+    void AddComponent(Entity entity, ComponentT value = ComponentT());
+
+    // Remove a component from an entity on playback.
+    template <typename ComponentT>
+    void RemoveComponent(Entity entity);
+
+    // True if no commands were recorded.
+    bool Empty() const { return m_commands.empty() && m_num_created == 0; }
+
+    // Drop all recorded commands. Memory is kept for reuse.
+    void Clear();
+
+private:
+    // Versions marking placeholders of entities that are created on playback, counting down from PENDING_VERSION by
+    // the index of the buffer the placeholder was created with.
+    static constexpr EntityVersion PENDING_VERSION = ~0u;
+    static constexpr EntityVersion MAX_BUFFERS     = 1u << 16;
+    static bool IsPlaceholder(Entity entity) { return GetEntityVersion(entity) > PENDING_VERSION - MAX_BUFFERS; }
+    // Index of the buffer a placeholder was created with.
+    static size_t BufferOf(Entity entity) { return PENDING_VERSION - GetEntityVersion(entity); }
+    // Storage id of commands accepting any storage class.
+    static constexpr std::uint32_t ANY_STORAGE = ~0u;
+    // Size of the blocks command payloads are allocated from.
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+    struct Command {
+        // Component type, or INVALID_COMPONENT_ID for destroying an entity.
+        ComponentId     type;
+        // Id of the storage class the component type has to be registered with, or ANY_STORAGE.
+        std::uint32_t   storage;
+        Entity          entity;
+        void*           payload;
+        // Apply the command to the registry.
+        void (*apply)(Registry& registry, Entity entity, void* payload);
+        // Destroy the payload.
+        void (*destroy)(void* payload);
+    };
+
+    // Index among the buffers of the registry, encoded into placeholders.
+    EntityVersion        m_index = 0;
+    std::vector<Command> m_commands;
+    // Command payloads
+    LinearArena          m_payloads{ BLOCK_SIZE };
+    EntityIndex          m_num_created = 0;
+    // Entities created on playback, indexed by placeholder index.
+    std::vector<Entity>  m_created;
+
+    friend class Registry;
+};
+
+inline void CommandBuffer::Clear()
+{
+    for (auto& command : m_commands) {
+        if (command.destroy) command.destroy(command.payload);
+    }
+    m_commands.clear();
+    m_payloads.Reset();
+    m_created.clear();
+    m_num_created = 0;
+}
+
+} // namespace ecs
+
+#endif
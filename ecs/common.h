@@ -1,8 +1,10 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <atomic>
 #include <cstdint>
 #include <numeric>
+#include <type_traits>
 #include <typeindex>
 #include <typeinfo>
 #include <vector>
@@ -10,15 +12,77 @@
 namespace ecs
 {
 
-using Entity         = std::uint32_t;
+// An entity is a handle made of a 32-bit index into the entity table and a 32-bit version of that slot.
+// The version is incremented every time an index is reused, so handles to destroyed entities never alias new ones.
+using Entity         = std::uint64_t;
+using EntityIndex    = std::uint32_t;
+using EntityVersion  = std::uint32_t;
 using ComponentIndex = std::size_t;
-constexpr Entity         INVALID_ENTITY          = ~0u;
+// Change ticks order component additions and changes. The registry advances its tick for every system run and Run() step.
+// Ticks are 64-bit so that they never wrap in practice, even at a million ticks per second, instead of rebasing all
+// stored ticks periodically.
+using Tick           = std::uint64_t;
+constexpr Entity         INVALID_ENTITY          = ~Entity(0);
+constexpr EntityIndex    INVALID_ENTITY_INDEX    = ~0u;
 constexpr ComponentIndex INVALID_COMPONENT_INDEX = ~0u;
+// Assumed size of a cache line in bytes.
+constexpr std::size_t    CACHE_LINE_SIZE         = 64;
+
+// Compose and decompose entity handles.
+constexpr Entity        MakeEntity(EntityIndex index, EntityVersion version) { return (Entity(version) << 32) | index; }
+constexpr EntityIndex   GetEntityIndex(Entity entity)   { return static_cast<EntityIndex>(entity); }
+constexpr EntityVersion GetEntityVersion(Entity entity) { return static_cast<EntityVersion>(entity >> 32); }
 
 // Compute hasheable index given a type. Returns an std::type_index which can be used in hash maps.
 template <typename T>
 static inline auto TypeIndex() { return std::type_index(typeid(T)); }
 
+// Dense id of a component type. Ids are handed out in order of first use starting at 0 and stay fixed for the
+// lifetime of the program, so they can index flat arrays instead of hashing std::type_index.
+using ComponentId = std::uint32_t;
+constexpr ComponentId INVALID_COMPONENT_ID = ~0u;
+
+namespace detail
+{
+inline ComponentId NextComponentId()
+{
+    static std::atomic<ComponentId> next{ 0 };
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+template <typename T>
+inline ComponentId ComponentIdOf()
+{
+    static const ComponentId id = NextComponentId();
+    return id;
+}
+} // namespace detail
+
+// Get the dense id of a component type. Const and volatile qualifiers are ignored.
+template <typename T>
+inline ComponentId GetComponentId() { return detail::ComponentIdOf<std::remove_cv_t<T>>(); }
+
+// Dense id of an event type, handed out like component ids but counted separately.
+using EventId = std::uint32_t;
+
+namespace detail
+{
+inline EventId NextEventId()
+{
+    static std::atomic<EventId> next{ 0 };
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+template <typename T>
+inline EventId EventIdOf()
+{
+    static const EventId id = NextEventId();
+    return id;
+}
+} // namespace detail
+
+// Get the dense id of an event type. Const and volatile qualifiers are ignored.
+template <typename T>
+inline EventId GetEventId() { return detail::EventIdOf<std::remove_cv_t<T>>(); }
+
 } // namespace ecs
 
 #endif
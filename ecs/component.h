@@ -2,8 +2,16 @@
 #define COMPONENT_H
 
 #include "ecs/common.h"
+#include "ecs/snapshot.h"
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -12,6 +20,34 @@ namespace ecs
 
 class Registry;
 
+template <typename ComponentT>
+struct ComponentStorageTraits;
+
+namespace detail
+{
+// Reads ComponentStorageTraits<T>::TRACK_CHANGES, defaulting to true.
+template <typename T, typename = void>
+struct TrackChanges : std::true_type {};
+template <typename T>
+struct TrackChanges<T, std::void_t<decltype(ComponentStorageTraits<T>::TRACK_CHANGES)>> : std::bool_constant<ComponentStorageTraits<T>::TRACK_CHANGES> {};
+
+// Append count copies of value to a vector, leaving it unchanged if a copy throws.
+template <typename VectorT, typename T>
+inline void AppendCopies(VectorT& vector, size_t count, const T& value)
+{
+    const size_t size = vector.size();
+    try {
+        vector.insert(vector.end(), count, value);
+    } catch (...) {
+        vector.erase(vector.begin() + size, vector.end());
+        throw;
+    }
+}
+} // namespace detail
+
+// Tick reported for components whose changes are not tracked, i.e., they always count as added and changed.
+constexpr Tick UNTRACKED_TICK = ~Tick(0);
+
 class ComponentStorageInterface {
 public:
     virtual ~ComponentStorageInterface() = 0;
@@ -21,21 +57,117 @@ public:
     virtual bool HasComponent(Entity entity) const = 0;
     // Remove component from entity.
     virtual void RemoveComponent(Entity entity) = 0;
+
+    // Write all components to a snapshot, respectively replace all components with those read from one.
+    // Throws std::runtime_error if the storage or its component type does not support snapshots.
+    virtual void Save(SnapshotWriter& writer) const;
+    virtual void Load(SnapshotReader& reader);
+
+    // Raw component access for delta snapshots: the size of a component in bytes, a call of f(entity, component) for
+    // every component added or changed after tick since, and adding or overwriting a component with raw bytes.
+    // Throw std::runtime_error if the storage or its component type does not support this.
+    virtual size_t RawSize() const;
+    virtual void ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const;
+    virtual void SetRaw(Entity entity, const void* data);
+
+    // Tick stamped on components added or replaced through the storage. Set by the Registry.
+    Tick GetTick() const { return m_tick; }
+    void SetTick(Tick tick) { m_tick = tick; }
+
+protected:
+    Tick m_tick = 0;
 };
 
+namespace detail
+{
+// Implementations of the raw access of ComponentStorageInterface for storages of trivially copyable components.
+template <typename StorageT>
+inline void ForEachChangedRaw(const StorageT& storage, Tick since, const std::function<void(Entity, const void*)>& f)
+{
+    using T = typename StorageT::ComponentType;
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be exchanged raw");
+    else {
+        for (Entity entity : storage.Entities()) {
+            if (storage.ChangedTick(entity) <= since) continue;
+            const T component = storage.GetComponent(entity);
+            f(entity, &component);
+        }
+    }
+}
+
+template <typename StorageT>
+inline void SetRaw(StorageT& storage, Entity entity, const void* data)
+{
+    using T = typename StorageT::ComponentType;
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be exchanged raw");
+    else {
+        T value;
+        std::memcpy(static_cast<void*>(&value), data, sizeof(T));
+        if (storage.HasComponent(entity)) {
+            storage.GetComponent(entity) = value;
+            storage.MarkChanged(entity, storage.GetTick());
+        } else {
+            storage.AddComponent(entity) = value;
+        }
+    }
+}
+
+// Sort the first count components of a storage by compare, following the cycles of the sorted permutation with
+// storage.Swap(), so that every component is moved at most once besides the swaps.
+template <typename StorageT, typename CompareT>
+inline void SortDense(StorageT& storage, size_t count, CompareT compare)
+{
+    std::vector<ComponentIndex> order(count);
+    for (ComponentIndex i = 0; i < count; ++i) order[i] = i;
+    const StorageT& components = storage;
+    std::sort(order.begin(), order.end(), [&](ComponentIndex lhs, ComponentIndex rhs) { return compare(components[lhs], components[rhs]); });
+    // order[i] is the index of the component that belongs to i.
+    for (ComponentIndex i = 0; i < count; ++i) {
+        ComponentIndex curr = i;
+        for (ComponentIndex next = order[curr]; next != i; next = order[curr]) {
+            storage.Swap(curr, next);
+            order[curr] = curr;
+            curr = next;
+        }
+        order[curr] = curr;
+    }
+}
+
+// Move the components of all entities of other to the front of a storage, in the order of other.
+template <typename StorageT, typename OtherT>
+inline void SortDenseAs(StorageT& storage, const OtherT& other)
+{
+    ComponentIndex next = 0;
+    for (Entity entity : other.Entities()) {
+        // Entities in front of next came earlier in other, so the component is never in front of next.
+        const ComponentIndex idx = storage.Index(entity);
+        if (idx != INVALID_COMPONENT_INDEX) storage.Swap(idx, next++);
+    }
+}
+} // namespace detail
+
 // Component storage that stores entities in a packed array.
 // Components are stored in a packed array and a hash map is used for entity --> component mapping.
+// The owner of every packed component is kept in a parallel array, which makes removal O(1).
 template <typename T>
 class PackedComponentStorage : public ComponentStorageInterface {
 public:
+    using ComponentType = T;
+
+    // Whether added and changed ticks are kept per component, see ComponentStorageTraits.
+    static constexpr bool TRACK_CHANGES = detail::TrackChanges<T>::value;
+
     PackedComponentStorage() = default;
+    // Allocate all memory of the storage from resource.
+    explicit PackedComponentStorage(std::pmr::memory_resource* resource)
+        : m_component_idx(resource), m_entities(resource), m_components(resource), m_added_ticks(resource), m_changed_ticks(resource) {}
     ~PackedComponentStorage() override = default;
 
     PackedComponentStorage(const PackedComponentStorage&) = delete;
     PackedComponentStorage& operator=(const PackedComponentStorage&) = delete;
 
     PackedComponentStorage(PackedComponentStorage&&);
-    PackedComponentStorage&& operator=(PackedComponentStorage&&);
+    PackedComponentStorage& operator=(PackedComponentStorage&&);
 
     // Get collection size.
     size_t Size() const override { return m_components.size(); }
@@ -46,35 +178,422 @@ public:
     // Remove component from entity.
     void RemoveComponent(Entity entity) override;
 
+    // Write the dense arrays as raw blobs, respectively replace all components with them.
+    // Throws std::runtime_error unless T is trivially copyable.
+    void Save(SnapshotWriter& writer) const override;
+    void Load(SnapshotReader& reader) override;
+    size_t RawSize() const override { return sizeof(T); }
+    void ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const override { detail::ForEachChangedRaw(*this, since, f); }
+    void SetRaw(Entity entity, const void* data) override { detail::SetRaw(*this, entity, data); }
+
     // Get component for entity, throws std::runtime_error if HasComponent(entity) == false.
     T&       GetComponent(Entity entity);
     const T& GetComponent(Entity entity) const;
 
+    // Get component for entity or nullptr if HasComponent(entity) == false.
+    T*       TryGetComponent(Entity entity);
+    const T* TryGetComponent(Entity entity) const;
+
     // Add a component to an entity.
     T& AddComponent(Entity entity);
 
+    // Add copies of value to count distinct entities at once.
+    // Throws std::runtime_error without adding anything if one of the entities already has a component.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+
+    // Reserve memory for at least capacity components.
+    void Reserve(size_t capacity);
+
+    // Get dense index of the entity's component, or INVALID_COMPONENT_INDEX if it has none.
+    ComponentIndex Index(Entity entity) const;
+
+    // Swap the components at two dense indices together with their owners and ticks.
+    void Swap(ComponentIndex lhs, ComponentIndex rhs);
+    // Reorder the components in place by compare(const T&, const T&), e.g., to iterate them in draw order.
+    template <typename CompareT>
+    void Sort(CompareT compare) { detail::SortDense(*this, Size(), compare); }
+    // Reorder the components in place so that the entities of other come first and in the order of other,
+    // which turns lookups of those entities while iterating other into sequential accesses.
+    template <typename StorageT>
+    void SortAs(const StorageT& other) { detail::SortDenseAs(*this, other); }
+
+    // Array of entities owning a component. Entities()[idx] is the owner of (*this)[idx].
+    const std::pmr::vector<Entity>& Entities() const { return m_entities; }
+
+    // Tick at which the component of an entity was added or last changed, 0 if the entity has none.
+    Tick AddedTick(Entity entity) const;
+    Tick ChangedTick(Entity entity) const;
+    // Stamp the component of an entity as changed at tick. Does nothing if the entity has none.
+    void MarkChanged(Entity entity, Tick tick);
+
     // Access component by idx.
     T&       operator[](ComponentIndex idx)       { return m_components[idx]; }
     const T& operator[](ComponentIndex idx) const { return m_components[idx]; }
 
 private:
-    std::unordered_map<Entity, ComponentIndex> m_component_idx;
-    std::vector<T>                             m_components;
+    std::pmr::unordered_map<Entity, ComponentIndex> m_component_idx;
+    std::pmr::vector<Entity>                        m_entities;
+    std::pmr::vector<T>                             m_components;
+    // Ticks parallel to m_components, empty unless TRACK_CHANGES.
+    std::pmr::vector<Tick>                          m_added_ticks;
+    std::pmr::vector<Tick>                          m_changed_ticks;
+};
+
+// Component storage based on a sparse set.
+// Entity indices are mapped to dense indices through a paged sparse array. Pages are allocated on demand, so memory
+// is only spent on entity ranges that actually own a component. The dense entity array is kept next to the
+// packed component array, i.e. Entities()[i] owns (*this)[i], which gives contiguous iteration.
+template <typename T>
+class SparseComponentStorage : public ComponentStorageInterface {
+public:
+    using ComponentType = T;
+
+    // Whether added and changed ticks are kept per component, see ComponentStorageTraits.
+    static constexpr bool TRACK_CHANGES = detail::TrackChanges<T>::value;
+
+    // Number of entity indices covered by a single sparse page.
+    static constexpr size_t PAGE_SIZE = 4096;
+
+    SparseComponentStorage() = default;
+    // Allocate all memory of the storage, including sparse pages, from resource.
+    explicit SparseComponentStorage(std::pmr::memory_resource* resource)
+        : m_sparse(resource), m_entities(resource), m_components(resource), m_added_ticks(resource), m_changed_ticks(resource) {}
+    ~SparseComponentStorage() override = default;
+
+    SparseComponentStorage(const SparseComponentStorage&) = delete;
+    SparseComponentStorage& operator=(const SparseComponentStorage&) = delete;
+
+    SparseComponentStorage(SparseComponentStorage&&) = default;
+    SparseComponentStorage& operator=(SparseComponentStorage&&) = default;
+
+    // Get collection size.
+    size_t Size() const override { return m_components.size(); }
+
+    // True if entity has a component in this collection.
+    bool HasComponent(Entity entity) const override { return Index(entity) != INVALID_COMPONENT_INDEX; }
+
+    // Remove component from entity.
+    void RemoveComponent(Entity entity) override;
+
+    // Write the dense arrays as raw blobs, respectively replace all components with them.
+    // Throws std::runtime_error unless T is trivially copyable.
+    void Save(SnapshotWriter& writer) const override;
+    void Load(SnapshotReader& reader) override;
+    size_t RawSize() const override { return sizeof(T); }
+    void ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const override { detail::ForEachChangedRaw(*this, since, f); }
+    void SetRaw(Entity entity, const void* data) override { detail::SetRaw(*this, entity, data); }
+
+    // Get component for entity, throws std::runtime_error if HasComponent(entity) == false.
+    T&       GetComponent(Entity entity);
+    const T& GetComponent(Entity entity) const;
+
+    // Get component for entity or nullptr if HasComponent(entity) == false.
+    T*       TryGetComponent(Entity entity);
+    const T* TryGetComponent(Entity entity) const;
+
+    // Add a component to an entity.
+    T& AddComponent(Entity entity);
+
+    // Add copies of value to count distinct entities at once, appending them contiguously.
+    // Throws std::runtime_error without adding anything if one of the entities already has a component.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+
+    // Reserve memory for at least capacity components.
+    void Reserve(size_t capacity);
+
+    // Get dense index of the entity's component, or INVALID_COMPONENT_INDEX if it has none.
+    ComponentIndex Index(Entity entity) const;
+
+    // Swap the components at two dense indices together with their owners and ticks.
+    void Swap(ComponentIndex lhs, ComponentIndex rhs);
+    // Reorder the components in place by compare(const T&, const T&), e.g., to iterate them in draw order.
+    template <typename CompareT>
+    void Sort(CompareT compare) { detail::SortDense(*this, Size(), compare); }
+    // Reorder the components in place so that the entities of other come first and in the order of other,
+    // which turns lookups of those entities while iterating other into sequential accesses.
+    template <typename StorageT>
+    void SortAs(const StorageT& other) { detail::SortDenseAs(*this, other); }
+
+    // Dense array of entities owning a component. Entities()[idx] is the owner of (*this)[idx].
+    const std::pmr::vector<Entity>& Entities() const { return m_entities; }
+
+    // Tick at which the component of an entity was added or last changed, 0 if the entity has none.
+    Tick AddedTick(Entity entity) const;
+    Tick ChangedTick(Entity entity) const;
+    // Tick at which the component at idx was added or last changed.
+    Tick AddedTickAt(ComponentIndex idx) const   { return TRACK_CHANGES ? m_added_ticks[idx] : UNTRACKED_TICK; }
+    Tick ChangedTickAt(ComponentIndex idx) const { return TRACK_CHANGES ? m_changed_ticks[idx] : UNTRACKED_TICK; }
+    // Stamp the component of an entity as changed at tick. Does nothing if the entity has none.
+    void MarkChanged(Entity entity, Tick tick);
+
+    // Access component by idx.
+    T&       operator[](ComponentIndex idx)       { return m_components[idx]; }
+    const T& operator[](ComponentIndex idx) const { return m_components[idx]; }
+
+private:
+    // Sparse entries only need to address the dense arrays, so 32 bits keep pages small.
+    using SparseIndex = std::uint32_t;
+    static constexpr SparseIndex INVALID_SPARSE_INDEX = ~0u;
+
+    // Get sparse entry of an entity, allocating its page if needed.
+    SparseIndex& SparseEntry(Entity entity);
+
+    // Pages of sparse entries, empty for pages not allocated yet.
+    std::pmr::vector<std::pmr::vector<SparseIndex>> m_sparse;
+    std::pmr::vector<Entity>                        m_entities;
+    std::pmr::vector<T>                             m_components;
+    // Ticks parallel to m_components, empty unless TRACK_CHANGES.
+    std::pmr::vector<Tick>                          m_added_ticks;
+    std::pmr::vector<Tick>                          m_changed_ticks;
+};
+
+namespace detail
+{
+// Number of components in a page of PagedComponentStorage, about 16 KiB worth of components.
+template <typename T>
+constexpr size_t DefaultComponentsPerPage() { return std::max<size_t>(1, 16 * 1024 / sizeof(T)); }
+} // namespace detail
+
+// Component storage with stable component addresses.
+// Components live in fixed-size pages that are allocated on demand and never relocated, so adding a component never
+// moves existing ones and costs at most one page allocation. References and pointers to a component stay valid until
+// that component is removed. Slots of removed components are reused by later additions.
+// A dense array of component pointers next to the dense entity array gives O(1) indexed access, i.e., Entities()[i]
+// owns (*this)[i]. Removal reorders the dense arrays like SparseComponentStorage, so dense indices are not stable.
+template <typename T, size_t COMPONENTS_PER_PAGE = detail::DefaultComponentsPerPage<T>()>
+class PagedComponentStorage : public ComponentStorageInterface {
+public:
+    using ComponentType = T;
+
+    // Whether added and changed ticks are kept per component, see ComponentStorageTraits.
+    static constexpr bool TRACK_CHANGES = detail::TrackChanges<T>::value;
+
+    // Number of entity indices covered by a single sparse page.
+    static constexpr size_t SPARSE_PAGE_SIZE = 4096;
+
+    PagedComponentStorage() : PagedComponentStorage(std::pmr::get_default_resource()) {}
+    // Allocate all memory of the storage, including component pages, from resource.
+    explicit PagedComponentStorage(std::pmr::memory_resource* resource)
+        : m_resource(resource), m_pages(resource), m_free(resource), m_sparse(resource), m_entities(resource),
+          m_components(resource), m_added_ticks(resource), m_changed_ticks(resource) {}
+    ~PagedComponentStorage() override { Release(); }
+
+    PagedComponentStorage(const PagedComponentStorage&) = delete;
+    PagedComponentStorage& operator=(const PagedComponentStorage&) = delete;
+
+    PagedComponentStorage(PagedComponentStorage&&);
+    PagedComponentStorage& operator=(PagedComponentStorage&&);
+
+    // Get collection size.
+    size_t Size() const override { return m_components.size(); }
+
+    // True if entity has a component in this collection.
+    bool HasComponent(Entity entity) const override { return Index(entity) != INVALID_COMPONENT_INDEX; }
+
+    // Remove component from entity.
+    void RemoveComponent(Entity entity) override;
+
+    // Write the dense arrays as raw blobs, respectively replace all components with them.
+    // Throws std::runtime_error unless T is trivially copyable.
+    void Save(SnapshotWriter& writer) const override;
+    void Load(SnapshotReader& reader) override;
+    size_t RawSize() const override { return sizeof(T); }
+    void ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const override { detail::ForEachChangedRaw(*this, since, f); }
+    void SetRaw(Entity entity, const void* data) override { detail::SetRaw(*this, entity, data); }
+
+    // Get component for entity, throws std::runtime_error if HasComponent(entity) == false.
+    T&       GetComponent(Entity entity);
+    const T& GetComponent(Entity entity) const;
+
+    // Get component for entity or nullptr if HasComponent(entity) == false.
+    T*       TryGetComponent(Entity entity);
+    const T* TryGetComponent(Entity entity) const;
+
+    // Add a component to an entity.
+    T& AddComponent(Entity entity);
+
+    // Add copies of value to count distinct entities at once.
+    // Throws std::runtime_error without adding anything if one of the entities already has a component.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+
+    // Allocate pages for at least capacity components.
+    void Reserve(size_t capacity);
+
+    // Number of components the allocated pages can hold.
+    size_t Capacity() const { return m_pages.size() * COMPONENTS_PER_PAGE; }
+
+    // Get dense index of the entity's component, or INVALID_COMPONENT_INDEX if it has none.
+    ComponentIndex Index(Entity entity) const;
+
+    // Swap the components at two dense indices together with their owners and ticks.
+    void Swap(ComponentIndex lhs, ComponentIndex rhs);
+    // Reorder the components in place by compare(const T&, const T&), e.g., to iterate them in draw order.
+    template <typename CompareT>
+    void Sort(CompareT compare) { detail::SortDense(*this, Size(), compare); }
+    // Reorder the components in place so that the entities of other come first and in the order of other,
+    // which turns lookups of those entities while iterating other into sequential accesses.
+    template <typename StorageT>
+    void SortAs(const StorageT& other) { detail::SortDenseAs(*this, other); }
+
+    // Dense array of entities owning a component. Entities()[idx] is the owner of (*this)[idx].
+    const std::pmr::vector<Entity>& Entities() const { return m_entities; }
+
+    // Tick at which the component of an entity was added or last changed, 0 if the entity has none.
+    Tick AddedTick(Entity entity) const;
+    Tick ChangedTick(Entity entity) const;
+    // Tick at which the component at idx was added or last changed.
+    Tick AddedTickAt(ComponentIndex idx) const   { return TRACK_CHANGES ? m_added_ticks[idx] : UNTRACKED_TICK; }
+    Tick ChangedTickAt(ComponentIndex idx) const { return TRACK_CHANGES ? m_changed_ticks[idx] : UNTRACKED_TICK; }
+    // Stamp the component of an entity as changed at tick. Does nothing if the entity has none.
+    void MarkChanged(Entity entity, Tick tick);
+
+    // Access component by idx.
+    T&       operator[](ComponentIndex idx)       { return *m_components[idx]; }
+    const T& operator[](ComponentIndex idx) const { return *m_components[idx]; }
+
+private:
+    using SparseIndex = std::uint32_t;
+    static constexpr SparseIndex INVALID_SPARSE_INDEX = ~0u;
+
+    // Get sparse entry of an entity, allocating its page if needed.
+    SparseIndex& SparseEntry(Entity entity);
+    // Allocate a page and push its slots onto the free list.
+    void AllocatePage();
+    // Take an unused slot, allocating a page if there is none.
+    T* AcquireSlot();
+    // Destroy all components and return all pages to the resource.
+    void Release();
+
+    std::pmr::memory_resource* m_resource;
+    // Component pages and the unused slots within them, lowest address last.
+    std::pmr::vector<T*> m_pages;
+    std::pmr::vector<T*> m_free;
+    // Pages of sparse entries, empty for pages not allocated yet.
+    std::pmr::vector<std::pmr::vector<SparseIndex>> m_sparse;
+    std::pmr::vector<Entity>                        m_entities;
+    // Dense array of pointers into the pages.
+    std::pmr::vector<T*>                            m_components;
+    // Ticks parallel to m_components, empty unless TRACK_CHANGES.
+    std::pmr::vector<Tick>                          m_added_ticks;
+    std::pmr::vector<Tick>                          m_changed_ticks;
 };
 
+// Storage of empty tag components, the default storage of empty types.
+// Tags carry no data, so an entity's tag is nothing but the bit of the tag type in the component signature the
+// Registry keeps per entity. Tagging costs no memory beyond that bit, and EntityQuery::Match() finds tagged entities
+// by scanning signatures. Tags cannot be the iterated components of views, but can be used in their filters.
+// Changes of tags are not tracked. Only constructible by a Registry.
+template <typename T>
+class TagStorage : public ComponentStorageInterface {
+    static_assert(std::is_empty_v<T>, "TagStorage: tags have to be empty types");
+public:
+    using ComponentType = T;
+
+    static constexpr bool TRACK_CHANGES = false;
+
+    explicit TagStorage(Registry& registry) noexcept : m_registry(registry) {}
+    ~TagStorage() override = default;
+
+    TagStorage(const TagStorage&) = delete;
+    TagStorage& operator=(const TagStorage&) = delete;
+
+    // Number of tagged entities.
+    size_t Size() const override { return m_size; }
+
+    // True if entity is alive and tagged.
+    bool HasComponent(Entity entity) const override;
+
+    // Remove the tag from an entity.
+    void RemoveComponent(Entity entity) override;
+
+    // Write the tagged entities, respectively tag the entities read from a snapshot.
+    void Save(SnapshotWriter& writer) const override;
+    void Load(SnapshotReader& reader) override;
+    // Tags have no bytes to exchange. Entities count as changed if their tick is newer than since.
+    size_t RawSize() const override { return 0; }
+    void ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const override;
+    void SetRaw(Entity entity, const void*) override { if (!HasComponent(entity)) AddComponent(entity); }
+
+    // All tags of a type are the same object, so getting one only checks that the entity is tagged.
+    T&       GetComponent(Entity entity);
+    const T& GetComponent(Entity entity) const;
+    T*       TryGetComponent(Entity entity)       { return HasComponent(entity) ? &m_tag : nullptr; }
+    const T* TryGetComponent(Entity entity) const { return HasComponent(entity) ? &m_tag : nullptr; }
+
+    // Tag an alive entity. Throws std::runtime_error if the entity is dead or already tagged.
+    T& AddComponent(Entity entity);
+    // Tag count distinct entities at once.
+    // Throws std::runtime_error without tagging anything if one of the entities is dead or already tagged.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+
+    Tick AddedTick(Entity entity) const   { return HasComponent(entity) ? UNTRACKED_TICK : 0; }
+    Tick ChangedTick(Entity entity) const { return HasComponent(entity) ? UNTRACKED_TICK : 0; }
+    void MarkChanged(Entity, Tick) {}
+
+private:
+    Registry& m_registry;
+    size_t    m_size = 0;
+    T         m_tag;
+};
+
+// Storage used for ComponentT whenever no StorageT is given explicitly to the Registry:
+// TagStorage for empty types and SparseComponentStorage for all others. Specialize this struct to change the default storage of a specific component type.
+// A specialization may also set TRACK_CHANGES to false to drop the per-component change ticks,
+// in which case Changed<ComponentT> and Added<ComponentT> filters match every component.
+template <typename ComponentT>
+struct ComponentStorageTraits {
+    using StorageType = std::conditional_t<std::is_empty_v<ComponentT>, TagStorage<ComponentT>, SparseComponentStorage<ComponentT>>;
+    static constexpr bool TRACK_CHANGES = true;
+};
+
+template <typename ComponentT>
+using DefaultStorage = typename ComponentStorageTraits<ComponentT>::StorageType;
+
 inline ComponentStorageInterface::~ComponentStorageInterface() {}
 
+inline void ComponentStorageInterface::Save(SnapshotWriter&) const
+{
+    throw std::runtime_error("ComponentCollection: the storage does not support snapshots");
+}
+
+inline void ComponentStorageInterface::Load(SnapshotReader&)
+{
+    throw std::runtime_error("ComponentCollection: the storage does not support snapshots");
+}
+
+inline size_t ComponentStorageInterface::RawSize() const
+{
+    throw std::runtime_error("ComponentCollection: the storage does not support raw access");
+}
+
+inline void ComponentStorageInterface::ForEachChanged(Tick, const std::function<void(Entity, const void*)>&) const
+{
+    throw std::runtime_error("ComponentCollection: the storage does not support raw access");
+}
+
+inline void ComponentStorageInterface::SetRaw(Entity, const void*)
+{
+    throw std::runtime_error("ComponentCollection: the storage does not support raw access");
+}
+
 template <typename T>
 inline PackedComponentStorage<T>::PackedComponentStorage(PackedComponentStorage&& rhs)
-    : m_component_idx(std::move(rhs.m_component_idx)), m_components(std::move(rhs.m_components))
+    : m_component_idx(std::move(rhs.m_component_idx)), m_entities(std::move(rhs.m_entities)), m_components(std::move(rhs.m_components)),
+      m_added_ticks(std::move(rhs.m_added_ticks)), m_changed_ticks(std::move(rhs.m_changed_ticks))
 {
+    m_tick = rhs.m_tick;
 }
 
 template <typename T>
-inline PackedComponentStorage<T>&& PackedComponentStorage<T>::operator=(PackedComponentStorage&& rhs)
+inline PackedComponentStorage<T>& PackedComponentStorage<T>::operator=(PackedComponentStorage&& rhs)
 {
     m_component_idx = std::move(rhs.m_component_idx);
-    m_components      = std::move(rhs.m_components);
+    m_entities      = std::move(rhs.m_entities);
+    m_components    = std::move(rhs.m_components);
+    m_added_ticks   = std::move(rhs.m_added_ticks);
+    m_changed_ticks = std::move(rhs.m_changed_ticks);
+    m_tick          = rhs.m_tick;
+    return *this;
 }
 
 template <typename T>
@@ -88,10 +607,44 @@ inline T& PackedComponentStorage<T>::AddComponent(Entity entity)
 {
     if (HasComponent(entity)) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
     m_component_idx[entity] = m_components.size();
+    m_entities.push_back(entity);
     m_components.emplace_back();
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.push_back(m_tick);
+        m_changed_ticks.push_back(m_tick);
+    }
     return m_components.back();
 }
 
+template <typename T>
+inline void PackedComponentStorage<T>::AddComponents(const Entity* entities, size_t count, const T& value)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (HasComponent(entities[i])) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+    }
+    Reserve(m_components.size() + count);
+    // Copy the components first, as copying may throw, and index them once nothing else can fail.
+    detail::AppendCopies(m_components, count, value);
+    for (size_t i = 0; i < count; ++i) m_component_idx.emplace(entities[i], m_entities.size() + i);
+    m_entities.insert(m_entities.end(), entities, entities + count);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.insert(m_added_ticks.end(), count, m_tick);
+        m_changed_ticks.insert(m_changed_ticks.end(), count, m_tick);
+    }
+}
+
+template <typename T>
+inline void PackedComponentStorage<T>::Reserve(size_t capacity)
+{
+    m_component_idx.reserve(capacity);
+    m_entities.reserve(capacity);
+    m_components.reserve(capacity);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.reserve(capacity);
+        m_changed_ticks.reserve(capacity);
+    }
+}
+
 template <typename T>
 inline const T& PackedComponentStorage<T>::GetComponent(Entity entity) const
 {
@@ -108,27 +661,595 @@ inline T& PackedComponentStorage<T>::GetComponent(Entity entity)
     return m_components[idx];
 }
 
+template <typename T>
+inline const T* PackedComponentStorage<T>::TryGetComponent(Entity entity) const
+{
+    auto it = m_component_idx.find(entity);
+    return it == m_component_idx.cend() ? nullptr : &m_components[it->second];
+}
+
+template <typename T>
+inline T* PackedComponentStorage<T>::TryGetComponent(Entity entity)
+{
+    auto it = m_component_idx.find(entity);
+    return it == m_component_idx.end() ? nullptr : &m_components[it->second];
+}
+
+template <typename T>
+inline ComponentIndex PackedComponentStorage<T>::Index(Entity entity) const
+{
+    auto it = m_component_idx.find(entity);
+    return it == m_component_idx.cend() ? INVALID_COMPONENT_INDEX : it->second;
+}
+
+template <typename T>
+inline void PackedComponentStorage<T>::Swap(ComponentIndex lhs, ComponentIndex rhs)
+{
+    if (lhs == rhs) return;
+    using std::swap;
+    swap(m_components[lhs], m_components[rhs]);
+    swap(m_entities[lhs], m_entities[rhs]);
+    m_component_idx[m_entities[lhs]] = lhs;
+    m_component_idx[m_entities[rhs]] = rhs;
+    if constexpr (TRACK_CHANGES) {
+        swap(m_added_ticks[lhs], m_added_ticks[rhs]);
+        swap(m_changed_ticks[lhs], m_changed_ticks[rhs]);
+    }
+}
+
 template <typename T>
 inline void PackedComponentStorage<T>::RemoveComponent(Entity entity)
 {
-    if (!HasComponent(entity)) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    auto it = m_component_idx.find(entity);
+    if (it == m_component_idx.end()) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
     // Swap index and component of the last item 
     // with the index and component of the entity to be deleted
-    if (m_components.size() > 1) {
-        const ComponentIndex last_idx = m_components.size() - 1;
-        const ComponentIndex free_idx = m_component_idx[entity];
+    const ComponentIndex last_idx = m_components.size() - 1;
+    const ComponentIndex free_idx = it->second;
+    if (free_idx != last_idx) {
         std::swap(m_components[free_idx], m_components[last_idx]);
+        m_entities[free_idx] = m_entities[last_idx];
+        m_component_idx[m_entities[free_idx]] = free_idx;
+        if constexpr (TRACK_CHANGES) {
+            m_added_ticks[free_idx]   = m_added_ticks[last_idx];
+            m_changed_ticks[free_idx] = m_changed_ticks[last_idx];
+        }
+    }
+    // Perform deletion of the entity
+    m_component_idx.erase(it);
+    m_entities.pop_back();
+    m_components.pop_back();
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.pop_back();
+        m_changed_ticks.pop_back();
+    }
+}
+
+template <typename T>
+inline Tick PackedComponentStorage<T>::AddedTick(Entity entity) const
+{
+    auto it = m_component_idx.find(entity);
+    if (it == m_component_idx.cend()) return 0;
+    return TRACK_CHANGES ? m_added_ticks[it->second] : UNTRACKED_TICK;
+}
+
+template <typename T>
+inline Tick PackedComponentStorage<T>::ChangedTick(Entity entity) const
+{
+    auto it = m_component_idx.find(entity);
+    if (it == m_component_idx.cend()) return 0;
+    return TRACK_CHANGES ? m_changed_ticks[it->second] : UNTRACKED_TICK;
+}
+
+template <typename T>
+inline void PackedComponentStorage<T>::MarkChanged(Entity entity, Tick tick)
+{
+    if constexpr (TRACK_CHANGES) {
+        auto it = m_component_idx.find(entity);
+        if (it != m_component_idx.end()) m_changed_ticks[it->second] = tick;
+    }
+}
+
+template <typename T>
+inline void PackedComponentStorage<T>::Save(SnapshotWriter& writer) const
+{
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be saved to snapshots");
+    else {
+        writer.WriteArray(m_entities);
+        writer.WriteArray(m_components);
+        writer.WriteArray(m_added_ticks);
+        writer.WriteArray(m_changed_ticks);
+    }
+}
+
+template <typename T>
+inline void PackedComponentStorage<T>::Load(SnapshotReader& reader)
+{
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be saved to snapshots");
+    else {
+        reader.ReadArray(m_entities);
+        reader.ReadArray(m_components);
+        if (m_components.size() != m_entities.size()) throw std::runtime_error("Snapshot: component and entity counts do not match");
+        detail::ReadTicks<TRACK_CHANGES>(reader, m_added_ticks, m_changed_ticks, m_components.size(), m_tick);
+        m_component_idx.clear();
+        m_component_idx.reserve(m_entities.size());
+        for (ComponentIndex i = 0; i < m_entities.size(); ++i) m_component_idx.emplace(m_entities[i], i);
+    }
+}
+
+template <typename T>
+inline ComponentIndex SparseComponentStorage<T>::Index(Entity entity) const
+{
+    const size_t page = GetEntityIndex(entity) / PAGE_SIZE;
+    if (page >= m_sparse.size() || m_sparse[page].empty()) return INVALID_COMPONENT_INDEX;
+    const SparseIndex idx = m_sparse[page][GetEntityIndex(entity) % PAGE_SIZE];
+    // Comparing the owner rejects stale handles whose index got reused.
+    return idx == INVALID_SPARSE_INDEX || m_entities[idx] != entity ? INVALID_COMPONENT_INDEX : idx;
+}
+
+template <typename T>
+inline typename SparseComponentStorage<T>::SparseIndex& SparseComponentStorage<T>::SparseEntry(Entity entity)
+{
+    const size_t page = GetEntityIndex(entity) / PAGE_SIZE;
+    if (page >= m_sparse.size()) m_sparse.resize(page + 1);
+    if (m_sparse[page].empty()) m_sparse[page].resize(PAGE_SIZE, INVALID_SPARSE_INDEX);
+    return m_sparse[page][GetEntityIndex(entity) % PAGE_SIZE];
+}
+
+template <typename T>
+inline T& SparseComponentStorage<T>::AddComponent(Entity entity)
+{
+    SparseIndex& idx = SparseEntry(entity);
+    if (idx != INVALID_SPARSE_INDEX) {
+        if (m_entities[idx] == entity) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+        throw std::runtime_error("ComponentCollection: Entity index is in use by another version of the entity");
+    }
+    idx = static_cast<SparseIndex>(m_components.size());
+    m_entities.push_back(entity);
+    m_components.emplace_back();
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.push_back(m_tick);
+        m_changed_ticks.push_back(m_tick);
+    }
+    return m_components.back();
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::AddComponents(const Entity* entities, size_t count, const T& value)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const size_t page = GetEntityIndex(entities[i]) / PAGE_SIZE;
+        if (page < m_sparse.size() && !m_sparse[page].empty() && m_sparse[page][GetEntityIndex(entities[i]) % PAGE_SIZE] != INVALID_SPARSE_INDEX) {
+            throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+        }
+    }
+    Reserve(m_components.size() + count);
+    // Copy the components first, as copying may throw, and index them once nothing else can fail.
+    detail::AppendCopies(m_components, count, value);
+    for (size_t i = 0; i < count; ++i) SparseEntry(entities[i]) = static_cast<SparseIndex>(m_entities.size() + i);
+    m_entities.insert(m_entities.end(), entities, entities + count);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.insert(m_added_ticks.end(), count, m_tick);
+        m_changed_ticks.insert(m_changed_ticks.end(), count, m_tick);
+    }
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::Reserve(size_t capacity)
+{
+    m_entities.reserve(capacity);
+    m_components.reserve(capacity);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.reserve(capacity);
+        m_changed_ticks.reserve(capacity);
+    }
+}
+
+template <typename T>
+inline const T& SparseComponentStorage<T>::GetComponent(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return m_components[idx];
+}
+
+template <typename T>
+inline T& SparseComponentStorage<T>::GetComponent(Entity entity)
+{
+    const ComponentIndex idx = Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return m_components[idx];
+}
+
+template <typename T>
+inline const T* SparseComponentStorage<T>::TryGetComponent(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? nullptr : &m_components[idx];
+}
+
+template <typename T>
+inline T* SparseComponentStorage<T>::TryGetComponent(Entity entity)
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? nullptr : &m_components[idx];
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::Swap(ComponentIndex lhs, ComponentIndex rhs)
+{
+    if (lhs == rhs) return;
+    using std::swap;
+    swap(m_components[lhs], m_components[rhs]);
+    swap(m_entities[lhs], m_entities[rhs]);
+    SparseEntry(m_entities[lhs]) = static_cast<SparseIndex>(lhs);
+    SparseEntry(m_entities[rhs]) = static_cast<SparseIndex>(rhs);
+    if constexpr (TRACK_CHANGES) {
+        swap(m_added_ticks[lhs], m_added_ticks[rhs]);
+        swap(m_changed_ticks[lhs], m_changed_ticks[rhs]);
+    }
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::RemoveComponent(Entity entity)
+{
+    const ComponentIndex free_idx = Index(entity);
+    if (free_idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    // Move the last component into the freed slot and redirect its owner.
+    const ComponentIndex last_idx = m_components.size() - 1;
+    if (free_idx != last_idx) {
+        m_components[free_idx] = std::move(m_components[last_idx]);
+        m_entities[free_idx]   = m_entities[last_idx];
+        SparseEntry(m_entities[free_idx]) = static_cast<SparseIndex>(free_idx);
+        if constexpr (TRACK_CHANGES) {
+            m_added_ticks[free_idx]   = m_added_ticks[last_idx];
+            m_changed_ticks[free_idx] = m_changed_ticks[last_idx];
+        }
+    }
+    SparseEntry(entity) = INVALID_SPARSE_INDEX;
+    m_entities.pop_back();
+    m_components.pop_back();
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.pop_back();
+        m_changed_ticks.pop_back();
+    }
+}
+
+template <typename T>
+inline Tick SparseComponentStorage<T>::AddedTick(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? 0 : AddedTickAt(idx);
+}
+
+template <typename T>
+inline Tick SparseComponentStorage<T>::ChangedTick(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? 0 : ChangedTickAt(idx);
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::MarkChanged(Entity entity, Tick tick)
+{
+    if constexpr (TRACK_CHANGES) {
+        const ComponentIndex idx = Index(entity);
+        if (idx != INVALID_COMPONENT_INDEX) m_changed_ticks[idx] = tick;
+    }
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::Save(SnapshotWriter& writer) const
+{
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be saved to snapshots");
+    else {
+        writer.WriteArray(m_entities);
+        writer.WriteArray(m_components);
+        writer.WriteArray(m_added_ticks);
+        writer.WriteArray(m_changed_ticks);
+    }
+}
+
+template <typename T>
+inline void SparseComponentStorage<T>::Load(SnapshotReader& reader)
+{
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be saved to snapshots");
+    else {
+        reader.ReadArray(m_entities);
+        reader.ReadArray(m_components);
+        if (m_components.size() != m_entities.size()) throw std::runtime_error("Snapshot: component and entity counts do not match");
+        detail::ReadTicks<TRACK_CHANGES>(reader, m_added_ticks, m_changed_ticks, m_components.size(), m_tick);
+        m_sparse.clear();
+        for (ComponentIndex i = 0; i < m_entities.size(); ++i) SparseEntry(m_entities[i]) = static_cast<SparseIndex>(i);
+    }
+}
+
+template <typename T, size_t N>
+inline PagedComponentStorage<T, N>::PagedComponentStorage(PagedComponentStorage&& rhs)
+    : m_resource(rhs.m_resource), m_pages(std::move(rhs.m_pages)), m_free(std::move(rhs.m_free)), m_sparse(std::move(rhs.m_sparse)),
+      m_entities(std::move(rhs.m_entities)), m_components(std::move(rhs.m_components)),
+      m_added_ticks(std::move(rhs.m_added_ticks)), m_changed_ticks(std::move(rhs.m_changed_ticks))
+{
+    m_tick = rhs.m_tick;
+    // The pages belong to this storage now, rhs must not release them.
+    rhs.m_pages.clear();
+    rhs.m_free.clear();
+    rhs.m_components.clear();
+}
+
+template <typename T, size_t N>
+inline PagedComponentStorage<T, N>& PagedComponentStorage<T, N>::operator=(PagedComponentStorage&& rhs)
+{
+    if (this == &rhs) return *this;
+    Release();
+    // Pages are returned to the resource they came from.
+    m_resource      = rhs.m_resource;
+    m_pages         = std::move(rhs.m_pages);
+    m_free          = std::move(rhs.m_free);
+    m_sparse        = std::move(rhs.m_sparse);
+    m_entities      = std::move(rhs.m_entities);
+    m_components    = std::move(rhs.m_components);
+    m_added_ticks   = std::move(rhs.m_added_ticks);
+    m_changed_ticks = std::move(rhs.m_changed_ticks);
+    m_tick          = rhs.m_tick;
+    rhs.m_pages.clear();
+    rhs.m_free.clear();
+    rhs.m_sparse.clear();
+    rhs.m_entities.clear();
+    rhs.m_components.clear();
+    rhs.m_added_ticks.clear();
+    rhs.m_changed_ticks.clear();
+    return *this;
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::Save(SnapshotWriter& writer) const
+{
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be saved to snapshots");
+    else {
+        writer.WriteArray(m_entities);
+        // Gather the components from their pages into one contiguous array.
+        writer.BeginArray<T>(m_components.size());
+        for (const T* component : m_components) writer.WriteBytes(component, sizeof(T));
+        writer.WriteArray(m_added_ticks);
+        writer.WriteArray(m_changed_ticks);
+    }
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::Load(SnapshotReader& reader)
+{
+    if constexpr (!std::is_trivially_copyable_v<T>) throw std::runtime_error("ComponentCollection: only trivially copyable components can be saved to snapshots");
+    else {
+        Release();
+        m_sparse.clear();
+        reader.ReadArray(m_entities);
+        size_t count = 0;
+        const std::byte* data = reader.BeginArray<T>(count);
+        if (count != m_entities.size()) throw std::runtime_error("Snapshot: component and entity counts do not match");
+        Reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            T* component = AcquireSlot();
+            std::memcpy(static_cast<void*>(component), data + i * sizeof(T), sizeof(T));
+            m_components.push_back(component);
+            SparseEntry(m_entities[i]) = static_cast<SparseIndex>(i);
+        }
+        detail::ReadTicks<TRACK_CHANGES>(reader, m_added_ticks, m_changed_ticks, count, m_tick);
+    }
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::Release()
+{
+    for (T* component : m_components) component->~T();
+    for (T* page : m_pages) m_resource->deallocate(page, N * sizeof(T), alignof(T));
+    m_pages.clear();
+    m_free.clear();
+    m_components.clear();
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::AllocatePage()
+{
+    m_free.reserve(m_free.size() + N);
+    T* page = static_cast<T*>(m_resource->allocate(N * sizeof(T), alignof(T)));
+    m_pages.push_back(page);
+    for (size_t i = N; i-- > 0;) m_free.push_back(page + i);
+}
+
+template <typename T, size_t N>
+inline T* PagedComponentStorage<T, N>::AcquireSlot()
+{
+    if (m_free.empty()) AllocatePage();
+    T* slot = m_free.back();
+    m_free.pop_back();
+    return slot;
+}
+
+template <typename T, size_t N>
+inline ComponentIndex PagedComponentStorage<T, N>::Index(Entity entity) const
+{
+    const size_t page = GetEntityIndex(entity) / SPARSE_PAGE_SIZE;
+    if (page >= m_sparse.size() || m_sparse[page].empty()) return INVALID_COMPONENT_INDEX;
+    const SparseIndex idx = m_sparse[page][GetEntityIndex(entity) % SPARSE_PAGE_SIZE];
+    // Comparing the owner rejects stale handles whose index got reused.
+    return idx == INVALID_SPARSE_INDEX || m_entities[idx] != entity ? INVALID_COMPONENT_INDEX : idx;
+}
+
+template <typename T, size_t N>
+inline typename PagedComponentStorage<T, N>::SparseIndex& PagedComponentStorage<T, N>::SparseEntry(Entity entity)
+{
+    const size_t page = GetEntityIndex(entity) / SPARSE_PAGE_SIZE;
+    if (page >= m_sparse.size()) m_sparse.resize(page + 1);
+    if (m_sparse[page].empty()) m_sparse[page].resize(SPARSE_PAGE_SIZE, INVALID_SPARSE_INDEX);
+    return m_sparse[page][GetEntityIndex(entity) % SPARSE_PAGE_SIZE];
+}
 
-        for (auto& entity_idx : m_component_idx) {
-            if (entity_idx.second == last_idx) {
-                entity_idx.second = free_idx;
-                break;
+template <typename T, size_t N>
+inline T& PagedComponentStorage<T, N>::AddComponent(Entity entity)
+{
+    SparseIndex& idx = SparseEntry(entity);
+    if (idx != INVALID_SPARSE_INDEX) {
+        if (m_entities[idx] == entity) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+        throw std::runtime_error("ComponentCollection: Entity index is in use by another version of the entity");
+    }
+    T* component = AcquireSlot();
+    try {
+        new (component) T();
+    } catch (...) {
+        m_free.push_back(component);
+        throw;
+    }
+    m_entities.push_back(entity);
+    m_components.push_back(component);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.push_back(m_tick);
+        m_changed_ticks.push_back(m_tick);
+    }
+    idx = static_cast<SparseIndex>(m_components.size() - 1);
+    return *component;
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::AddComponents(const Entity* entities, size_t count, const T& value)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const size_t page = GetEntityIndex(entities[i]) / SPARSE_PAGE_SIZE;
+        if (page < m_sparse.size() && !m_sparse[page].empty() && m_sparse[page][GetEntityIndex(entities[i]) % SPARSE_PAGE_SIZE] != INVALID_SPARSE_INDEX) {
+            throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+        }
+    }
+    Reserve(m_components.size() + count);
+    // Construct the components first, as constructing may throw, and publish the sparse entries once nothing can fail.
+    const size_t size = m_components.size();
+    for (size_t i = 0; i < count; ++i) {
+        T* component = AcquireSlot();
+        try {
+            new (component) T(value);
+        } catch (...) {
+            // Return the slots in reverse, so the free list keeps its order.
+            m_free.push_back(component);
+            for (; m_components.size() > size; m_components.pop_back()) {
+                m_components.back()->~T();
+                m_free.push_back(m_components.back());
             }
+            throw;
         }
+        m_components.push_back(component);
     }
-    // Perform deletion of the entity
-    m_component_idx.erase(entity);
+    m_entities.insert(m_entities.end(), entities, entities + count);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.insert(m_added_ticks.end(), count, m_tick);
+        m_changed_ticks.insert(m_changed_ticks.end(), count, m_tick);
+    }
+    for (size_t i = 0; i < count; ++i) SparseEntry(entities[i]) = static_cast<SparseIndex>(size + i);
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::Reserve(size_t capacity)
+{
+    while (Capacity() < capacity) AllocatePage();
+    m_entities.reserve(capacity);
+    m_components.reserve(capacity);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.reserve(capacity);
+        m_changed_ticks.reserve(capacity);
+    }
+}
+
+template <typename T, size_t N>
+inline const T& PagedComponentStorage<T, N>::GetComponent(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return *m_components[idx];
+}
+
+template <typename T, size_t N>
+inline T& PagedComponentStorage<T, N>::GetComponent(Entity entity)
+{
+    const ComponentIndex idx = Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return *m_components[idx];
+}
+
+template <typename T, size_t N>
+inline const T* PagedComponentStorage<T, N>::TryGetComponent(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? nullptr : m_components[idx];
+}
+
+template <typename T, size_t N>
+inline T* PagedComponentStorage<T, N>::TryGetComponent(Entity entity)
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? nullptr : m_components[idx];
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::Swap(ComponentIndex lhs, ComponentIndex rhs)
+{
+    if (lhs == rhs) return;
+    // Only the dense pointers move, components keep their addresses.
+    std::swap(m_components[lhs], m_components[rhs]);
+    std::swap(m_entities[lhs], m_entities[rhs]);
+    SparseEntry(m_entities[lhs]) = static_cast<SparseIndex>(lhs);
+    SparseEntry(m_entities[rhs]) = static_cast<SparseIndex>(rhs);
+    if constexpr (TRACK_CHANGES) {
+        std::swap(m_added_ticks[lhs], m_added_ticks[rhs]);
+        std::swap(m_changed_ticks[lhs], m_changed_ticks[rhs]);
+    }
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::RemoveComponent(Entity entity)
+{
+    const ComponentIndex free_idx = Index(entity);
+    if (free_idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    // Destroy the component in place; only the dense pointer of the last component moves into the freed index.
+    m_components[free_idx]->~T();
+    m_free.push_back(m_components[free_idx]);
+    const ComponentIndex last_idx = m_components.size() - 1;
+    if (free_idx != last_idx) {
+        m_components[free_idx] = m_components[last_idx];
+        m_entities[free_idx]   = m_entities[last_idx];
+        SparseEntry(m_entities[free_idx]) = static_cast<SparseIndex>(free_idx);
+        if constexpr (TRACK_CHANGES) {
+            m_added_ticks[free_idx]   = m_added_ticks[last_idx];
+            m_changed_ticks[free_idx] = m_changed_ticks[last_idx];
+        }
+    }
+    SparseEntry(entity) = INVALID_SPARSE_INDEX;
+    m_entities.pop_back();
     m_components.pop_back();
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.pop_back();
+        m_changed_ticks.pop_back();
+    }
+}
+
+template <typename T, size_t N>
+inline Tick PagedComponentStorage<T, N>::AddedTick(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? 0 : AddedTickAt(idx);
+}
+
+template <typename T, size_t N>
+inline Tick PagedComponentStorage<T, N>::ChangedTick(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? 0 : ChangedTickAt(idx);
+}
+
+template <typename T, size_t N>
+inline void PagedComponentStorage<T, N>::MarkChanged(Entity entity, Tick tick)
+{
+    if constexpr (TRACK_CHANGES) {
+        const ComponentIndex idx = Index(entity);
+        if (idx != INVALID_COMPONENT_INDEX) m_changed_ticks[idx] = tick;
+    }
 }
 
 } // namespace ecs
@@ -2,7 +2,11 @@
 #define ECS_H
 
 #include "ecs/common.h"
+#include "ecs/event.h"
+#include "ecs/hierarchy.h"
+#include "ecs/parallel.h"
 #include "ecs/system.h"
 #include "ecs/registry.h"
+#include "ecs/spatial.h"
 
 #endif
@@ -7,9 +7,11 @@ namespace ecs
 
 EntityManager EntityQuery::operator()() const
 {
-    std::vector<Entity> entities;
-    for (uint32_t i = 0; i < m_registry.m_entities.size(); ++i)
-        if (m_registry.m_entities[i]) entities.push_back(i);
+    std::pmr::vector<Entity> entities(m_resource ? m_resource : &m_registry.FrameResource());
+    entities.reserve(m_registry.m_entities.size());
+    for (EntityIndex i = 0; i < m_registry.m_entities.size(); ++i)
+        if (GetEntityIndex(m_registry.m_entities[i]) == i) entities.push_back(m_registry.m_entities[i]);
+    m_num_queried += entities.size();
     return EntityManager(std::move(entities));
 }
 
@@ -2,13 +2,17 @@
 #define ENTITY_H
 
 #include "ecs/common.h"
+#include "ecs/view.h"
 
 #include <algorithm>
+#include <memory_resource>
+#include <vector>
 
 namespace ecs
 {
 
 class Registry;
+struct SystemAccess;
 
 // Represents a collection of entities and provides filtering operations.
 // EntityManager is primarily designed to be used as a result of entity queries for
@@ -31,19 +35,22 @@ public:
     EntityManager Filter(F&& f) &&;
 
     // Return entities.
-    const std::vector<Entity>& Entities() const { return m_entities; }
+    const std::pmr::vector<Entity>& Entities() const { return m_entities; }
 
 private:
-    EntityManager(const std::vector<Entity>& entities) : m_entities(entities) {}
-    EntityManager(std::vector<Entity>&& entities) : m_entities(std::move(entities)) {}
+    EntityManager(std::pmr::vector<Entity>&& entities) : m_entities(std::move(entities)) {}
 
-    std::vector<Entity> m_entities;
+    std::pmr::vector<Entity> m_entities;
     friend class EntityQuery;
 };
 
 class EntityQuery {
 public:
-    explicit EntityQuery(Registry& registry) noexcept : m_registry(registry) {}
+    // EntityManagers are allocated from resource. A null resource selects the frame arena of the calling thread,
+    // which is what queries handed to systems use, so their EntityManagers are only valid for the current Run() step.
+    explicit EntityQuery(Registry& registry, const SystemAccess* access = nullptr, Tick since = 0,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : m_registry(registry), m_access(access), m_since(since), m_resource(resource) {}
     // Do not allow copies.
     EntityQuery(const EntityQuery&) = delete;
     EntityQuery operator=(const EntityQuery&) = delete;
@@ -51,8 +58,36 @@ public:
     // Get the EntityManager containing all entities in the registry.
     // The EntityManagers further provide filtering functionality on its entities.
     EntityManager operator()() const;
+
+    // Get a lazy view over all entities having every component in ComponentTs, filtered by any number of Without,
+    // Changed and Added filters. Changed and Added refer to changes since the system using the query last ran.
+    // Const component types give read-only access. The view allocates nothing and yields components directly, e.g.,
+    // for (auto [entity, pos, vel] : entity_query.View<Position, const Velocity>(Without<Dead>{}, Changed<Velocity>{})) { ... }
+    template <typename... ComponentTs, typename... FilterTs>
+    ComponentView<MakeViewFilter<FilterTs...>, ComponentTs...> View(FilterTs... filters) const;
+
+    // Get the EntityManager containing all entities having every component in ComponentTs and none in ExcludeTs.
+    // Evaluated by scanning the component signatures of all entities as bit masks, without touching any storage,
+    // which makes it the way to filter by tags, e.g., entity_query.Match<Enemy, Visible>(Without<Dead>{}).
+    template <typename... ComponentTs, typename... ExcludeTs>
+    EntityManager Match(Without<ExcludeTs...> = {}) const;
+
+    // Components changed or added at or before this tick are filtered out by Changed and Added.
+    Tick Since() const { return m_since; }
+    // Number of entities returned by all EntityManagers of this query so far.
+    std::uint64_t NumQueried() const { return m_num_queried; }
 private:
+    // Construct a view from its merged filter.
+    template <typename... ComponentTs, typename... ExcludeTs, typename... ChangedTs, typename... AddedTs>
+    ComponentView<ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>, ComponentTs...>
+    MakeView(ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>) const;
+
     Registry& m_registry;
+    // Declared access of the system using this query, if any. Views are checked against it.
+    const SystemAccess* m_access;
+    Tick m_since;
+    std::pmr::memory_resource* m_resource;
+    mutable std::uint64_t m_num_queried = 0;
 };
 
 template <typename F>
@@ -75,7 +110,7 @@ template <typename F>
 inline EntityManager EntityManager::Filter(F&& f) const&
 {
     auto new_end = std::partition(m_entities.begin(), m_entities.end(), std::forward<F>(f));
-    return EntityManager(std::vector<Entity>(m_entities.begin(), new_end));
+    return EntityManager(std::pmr::vector<Entity>(m_entities.begin(), new_end, m_entities.get_allocator()));
 }
 
 } // namespace ecs
@@ -0,0 +1,162 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include "ecs/common.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+
+// Interface of event channels, through which the Registry advances the channels of all event types between steps.
+class EventChannelInterface {
+public:
+    virtual ~EventChannelInterface() = default;
+
+    // Drop the events of the previous step and keep those of the step that just ended as the previous ones.
+    virtual void Swap() = 0;
+    // Drop all events and reset the cursors of all receivers.
+    virtual void Clear() = 0;
+    // Add a receiver, identified by an arbitrary address, which starts with all events kept by the channel unread.
+    virtual void AddReceiver(const void* receiver) = 0;
+};
+
+// Channel for events of type T, owned by the Registry and created with Registry::RegisterEvent().
+// Every worker appends to a segment of its own and all other threads share one more segment, so parallel systems
+// and their subflow tasks send without locks or false sharing. Every segment is double-buffered: one buffer collects
+// the events of the running step, the other one keeps those of the previous step. Every receiver has a cursor into
+// both buffers, so it reads every event exactly once, whether it was sent earlier in the same step or after the
+// receiver ran in the previous step, as long as it runs at least every other step. Older events are dropped.
+// Reading must not overlap with sending, which the Registry ensures by only letting declared senders send and
+// running them before the receivers.
+template <typename T>
+class EventChannel final : public EventChannelInterface {
+public:
+    using EventType = T;
+
+    explicit EventChannel(size_t num_segments) : m_segments(num_segments) {}
+    ~EventChannel() override = default;
+
+    // Append an event to a segment. A segment must not be used by several threads concurrently.
+    void Send(size_t segment, const T& event) { m_segments[segment].events[m_current].push_back(event); }
+    void Send(size_t segment, T&& event)      { m_segments[segment].events[m_current].push_back(std::move(event)); }
+
+    void AddReceiver(const void* receiver) override
+    {
+        if (FindReceiver(receiver) != m_receivers.size()) return;
+        m_receivers.push_back(receiver);
+        m_cursors.emplace_back(2 * m_segments.size(), 0);
+    }
+
+    // Call f(const T* events, size_t count) with the unread events of a receiver in batches, the events of the
+    // previous step first, and mark them as read. Batches stay valid until the next event is sent.
+    template <typename F>
+    void Receive(const void* receiver, F&& f)
+    {
+        auto& cursor = m_cursors[FindReceiver(receiver)];
+        for (size_t buffer : { m_current ^ 1u, m_current }) {
+            for (size_t s = 0; s < m_segments.size(); ++s) {
+                const auto& events = m_segments[s].events[buffer];
+                size_t& read = cursor[2 * s + buffer];
+                if (read < events.size()) f(events.data() + read, events.size() - read);
+                read = events.size();
+            }
+        }
+    }
+    // Number of events a receiver has not read yet.
+    size_t NumUnread(const void* receiver) const
+    {
+        const auto& cursor = m_cursors[FindReceiver(receiver)];
+        size_t count = 0;
+        for (size_t s = 0; s < m_segments.size(); ++s) {
+            for (size_t buffer = 0; buffer < 2; ++buffer) count += m_segments[s].events[buffer].size() - cursor[2 * s + buffer];
+        }
+        return count;
+    }
+
+    // Call f(const T* events, size_t count) with the events of the previous step in batches, regardless of cursors.
+    template <typename F>
+    void ForEachPrevious(F&& f) const
+    {
+        for (const auto& segment : m_segments) {
+            const auto& events = segment.events[m_current ^ 1u];
+            if (!events.empty()) f(events.data(), events.size());
+        }
+    }
+    // Number of events of the previous step.
+    size_t NumPrevious() const
+    {
+        size_t count = 0;
+        for (const auto& segment : m_segments) count += segment.events[m_current ^ 1u].size();
+        return count;
+    }
+
+    void Swap() override
+    {
+        // The buffer of the previous step is reused for the next one, keeping its capacity.
+        m_current ^= 1u;
+        for (auto& segment : m_segments) segment.events[m_current].clear();
+        for (auto& cursor : m_cursors) {
+            for (size_t s = 0; s < m_segments.size(); ++s) cursor[2 * s + m_current] = 0;
+        }
+    }
+    void Clear() override
+    {
+        for (auto& segment : m_segments) {
+            segment.events[0].clear();
+            segment.events[1].clear();
+        }
+        for (auto& cursor : m_cursors) std::fill(cursor.begin(), cursor.end(), 0);
+    }
+
+private:
+    size_t FindReceiver(const void* receiver) const
+    {
+        return static_cast<size_t>(std::find(m_receivers.cbegin(), m_receivers.cend(), receiver) - m_receivers.cbegin());
+    }
+
+    // Aligned to cache lines, so workers appending to neighbouring segments do not share lines.
+    struct alignas(CACHE_LINE_SIZE) Segment {
+        std::vector<T> events[2];
+    };
+
+    std::vector<Segment> m_segments;
+    // Buffer collecting the events of the running step, the other one holds the previous step.
+    size_t m_current = 0;
+    // Receivers and their number of read events, per segment and buffer.
+    std::vector<const void*>         m_receivers;
+    std::vector<std::vector<size_t>> m_cursors;
+};
+
+// Events of type T received by a system, see ComponentAccess::Receive().
+template <typename T>
+class EventReader {
+public:
+    EventReader(EventChannel<T>& channel, const void* receiver) noexcept : m_channel(channel), m_receiver(receiver) {}
+
+    // Call f(const T* events, size_t count) with the unread events in batches, oldest first, and mark them as read.
+    // Batches stay valid until the system returns, e.g., to process them in subflow tasks.
+    template <typename F>
+    void ForEachBatch(F&& f) { m_channel.Receive(m_receiver, std::forward<F>(f)); }
+    // Call f(const T& event) for every unread event, oldest first, and mark them as read.
+    template <typename F>
+    void ForEach(F&& f)
+    {
+        m_channel.Receive(m_receiver, [&f](const T* events, size_t count) {
+            for (size_t i = 0; i < count; ++i) f(events[i]);
+        });
+    }
+    // Number of unread events.
+    size_t Size() const { return m_channel.NumUnread(m_receiver); }
+    bool Empty() const { return Size() == 0; }
+private:
+    EventChannel<T>& m_channel;
+    const void*      m_receiver;
+};
+
+} // namespace ecs
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include "ecs/common.h"
+#include "ecs/component.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+
+// Interface the Registry keeps its owning groups by.
+class GroupInterface {
+public:
+    virtual ~GroupInterface() = default;
+
+    // Move an entity into the group if it has all owned components. Does nothing if it already is part of the group.
+    virtual void Refresh(Entity entity) = 0;
+    // Move an entity out of the group. Has to be called before one of its owned components is removed.
+    virtual void Leave(Entity entity) = 0;
+    // Pack all entities having every owned component from scratch, e.g., after the storages were loaded.
+    virtual void Rebuild() = 0;
+};
+
+// Owning group over the storages of ComponentTs.
+// The entities having all of ComponentTs are kept packed at the front of every owned storage, in identical order,
+// so iterating a group walks parallel arrays without any lookups: the i-th component of every storage belongs to
+// Entities()[i]. Groups are created with registry.CreateGroup<Position, Velocity>() and stay owned by the Registry,
+// which keeps them up to date on every structural change made through it, like CachedQuery. A storage can be owned
+// by a single group, and must not be sorted by other means while owned.
+template <typename... ComponentTs>
+class Group : public GroupInterface {
+    static_assert(sizeof...(ComponentTs) > 0, "Group: at least one component type has to be given");
+public:
+    using Storages = std::tuple<DefaultStorage<ComponentTs>*...>;
+
+    explicit Group(const Storages& storages) : m_storages(storages) { Rebuild(); }
+
+    Group(const Group&) = delete;
+    Group& operator=(const Group&) = delete;
+
+    // Number of entities having all of ComponentTs.
+    size_t Size() const { return m_size; }
+    bool Contains(Entity entity) const { return std::get<0>(m_storages)->Index(entity) < m_size; }
+
+    // Entities of the group. Entities()[i] owns the i-th component of every owned storage.
+    const Entity* Entities() const { return std::get<0>(m_storages)->Entities().data(); }
+
+    // Call f(Entity, ComponentTs&...) for every entity in the group.
+    template <typename F>
+    void Each(F&& f) { Each(0, m_size, std::forward<F>(f)); }
+    // Call f(Entity, ComponentTs&...) for the entities in [first, last) of the group, e.g., to split it among tasks.
+    template <typename F>
+    void Each(size_t first, size_t last, F&& f);
+
+    // Reorder the group by compare(const ComponentT&, const ComponentT&) on one of the owned component types.
+    // All owned storages follow the new order.
+    template <typename ComponentT, typename CompareT>
+    void Sort(CompareT compare);
+
+    void Refresh(Entity entity) override;
+    void Leave(Entity entity) override;
+    void Rebuild() override;
+
+private:
+    // Bring the group prefix of every storage into the order of the prefix of lead.
+    template <typename LeadT>
+    void Align(const LeadT& lead);
+
+    Storages m_storages;
+    size_t   m_size = 0;
+};
+
+template <typename... ComponentTs>
+template <typename F>
+inline void Group<ComponentTs...>::Each(size_t first, size_t last, F&& f)
+{
+    last = std::min(last, m_size);
+    const Entity* entities = Entities();
+    for (size_t i = first; i < last; ++i) std::apply([&](auto*... storages) { f(entities[i], (*storages)[i]...); }, m_storages);
+}
+
+template <typename... ComponentTs>
+template <typename ComponentT, typename CompareT>
+inline void Group<ComponentTs...>::Sort(CompareT compare)
+{
+    auto& lead = *std::get<DefaultStorage<ComponentT>*>(m_storages);
+    detail::SortDense(lead, m_size, compare);
+    Align(lead);
+}
+
+template <typename... ComponentTs>
+template <typename LeadT>
+inline void Group<ComponentTs...>::Align(const LeadT& lead)
+{
+    std::apply([&](auto*... storages) {
+        auto align = [&](auto& storage) {
+            if (static_cast<const void*>(&storage) == static_cast<const void*>(&lead)) return;
+            // Both prefixes hold the same entities, those before i are in place already.
+            for (ComponentIndex i = 0; i < m_size; ++i) storage.Swap(storage.Index(lead.Entities()[i]), i);
+        };
+        (align(*storages), ...);
+    }, m_storages);
+}
+
+template <typename... ComponentTs>
+inline void Group<ComponentTs...>::Refresh(Entity entity)
+{
+    if (Contains(entity)) return;
+    const bool owns_all = std::apply([entity](const auto*... storages) { return (... && storages->HasComponent(entity)); }, m_storages);
+    if (!owns_all) return;
+    std::apply([this, entity](auto*... storages) { (storages->Swap(storages->Index(entity), m_size), ...); }, m_storages);
+    ++m_size;
+}
+
+template <typename... ComponentTs>
+inline void Group<ComponentTs...>::Leave(Entity entity)
+{
+    if (!Contains(entity)) return;
+    --m_size;
+    std::apply([this, entity](auto*... storages) { (storages->Swap(storages->Index(entity), m_size), ...); }, m_storages);
+}
+
+template <typename... ComponentTs>
+inline void Group<ComponentTs...>::Rebuild()
+{
+    m_size = 0;
+    // Walk the smallest storage. Refresh() only swaps already visited entities into its position.
+    std::apply([this](auto*... storages) {
+        const size_t smallest = std::min({ storages->Size()... });
+        bool done = false;
+        auto rebuild = [&](auto& storage) {
+            if (done || storage.Size() != smallest) return;
+            done = true;
+            for (ComponentIndex i = 0; i < storage.Size(); ++i) Refresh(storage.Entities()[i]);
+        };
+        (rebuild(*storages), ...);
+    }, m_storages);
+}
+
+} // namespace ecs
+
+#endif
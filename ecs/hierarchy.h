@@ -0,0 +1,365 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include "ecs/common.h"
+#include "ecs/component.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <vector>
+
+namespace ecs
+{
+
+// Component storage arranging the components of a forest in breadth-first order.
+// Every entity with a component is a node, a root unless SetParent() gave it a parent within the same storage.
+// Layout() moves the components so that all roots come first, followed by their children, the grandchildren and
+// so on, the children of a node being contiguous and in the order they were attached. Parents thereby precede their
+// children, so propagating state down the trees, e.g., world transforms, is a single linear sweep with Propagate()
+// or a parallel sweep level by level with ParallelPropagate(). Reparenting and removals only re-lay out the levels
+// from the shallowest one affected, once per batch of changes at the next Layout().
+//
+// Select it like any other storage, e.g.,
+//   template <> struct ecs::ComponentStorageTraits<Transform> { using StorageType = HierarchyStorage<Transform>; };
+// Removing a node makes its children roots. The components cannot be sorted or owned by a group, as that would
+// break their order. Snapshots keep the hierarchy, delta snapshots only replicate the components.
+template <typename T>
+class HierarchyStorage : public SparseComponentStorage<T> {
+    using Base = SparseComponentStorage<T>;
+public:
+    using ComponentType = T;
+
+    HierarchyStorage() = default;
+    // Allocate all memory of the storage from resource.
+    explicit HierarchyStorage(std::pmr::memory_resource* resource) : Base(resource), m_links(resource), m_parent_idx(resource) {}
+    ~HierarchyStorage() override = default;
+
+    // Remove the component of an entity. Its children become roots.
+    void RemoveComponent(Entity entity) override;
+
+    // Write the components followed by the parent of every child, respectively replace all nodes with those read.
+    void Save(SnapshotWriter& writer) const override;
+    void Load(SnapshotReader& reader) override;
+    // Components set raw for the first time are added as roots.
+    void SetRaw(Entity entity, const void* data) override { detail::SetRaw(*this, entity, data); }
+
+    // Add a component to an entity as a new root.
+    T& AddComponent(Entity entity);
+    // Add copies of value to count distinct entities at once, all of them roots.
+    // Throws std::runtime_error without adding anything if one of the entities already has a component.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+
+    // Attach an entity as the last child of parent, or make it a root if parent is INVALID_ENTITY.
+    // Throws std::runtime_error if either has no component or parent is the entity itself or one of its descendants.
+    void SetParent(Entity entity, Entity parent);
+    // Parent of an entity, INVALID_ENTITY for roots.
+    Entity GetParent(Entity entity) const;
+    // Call f(Entity) for every child of an entity, in order.
+    template <typename F>
+    void EachChild(Entity entity, F&& f) const;
+
+    // Move the components into breadth-first order. Does nothing if the order is up to date.
+    // Moves components, invalidating references to them and views over the storage.
+    void Layout();
+
+    // Breadth-first levels as of the last Layout(). Level 0 holds the roots in [LevelBegin(0), LevelEnd(0)),
+    // level 1 their children and so on.
+    size_t         NumLevels() const { return m_levels.size() - 1; }
+    ComponentIndex LevelBegin(size_t level) const { return m_levels[level]; }
+    ComponentIndex LevelEnd(size_t level) const { return m_levels[level + 1]; }
+    // Component of the parent of the component at idx, nullptr for roots. Valid after Layout().
+    const T* ParentAt(ComponentIndex idx) const
+    {
+        return m_parent_idx[idx] == INVALID_COMPONENT_INDEX ? nullptr : &(*this)[m_parent_idx[idx]];
+    }
+
+    // Lay out the storage and call f(T& node, const T* parent) for every node, parents before their children.
+    // parent is nullptr for roots.
+    template <typename F>
+    void Propagate(F&& f);
+
+private:
+    // Links of a node by entity, so that moving nodes does not invalidate them.
+    // The prev_sibling of the first child refers to the last child, making appending O(1).
+    struct Links {
+        Entity parent       = INVALID_ENTITY;
+        Entity first_child  = INVALID_ENTITY;
+        Entity next_sibling = INVALID_ENTITY;
+        Entity prev_sibling = INVALID_ENTITY;
+    };
+
+    static constexpr size_t CLEAN = std::numeric_limits<size_t>::max();
+
+    // Moving components is reserved to Layout().
+    using Base::Swap;
+    using Base::Sort;
+    using Base::SortAs;
+
+    // Unlink the node at idx from its parent and siblings.
+    void Detach(ComponentIndex idx);
+    // Link the node at idx as the last child of parent.
+    void Attach(ComponentIndex idx, Entity parent);
+    // Level of the node at idx if it lies within the levels that are still laid out, else the first outdated level.
+    size_t LevelOf(ComponentIndex idx) const;
+    // Mark the levels from level on as outdated.
+    void Invalidate(size_t level) { m_dirty_level = std::min(m_dirty_level, level); }
+    // Append the nodes of the levels from level on to order, as dense indices in breadth-first order, and the dense
+    // index at which every following level starts to levels.
+    void BreadthFirst(size_t level, std::vector<ComponentIndex>& order, std::vector<ComponentIndex>& levels) const;
+
+    // Links of every node, parallel to the dense component array.
+    std::pmr::vector<Links>          m_links;
+    // Dense index of the parent of every node as of the last Layout().
+    std::pmr::vector<ComponentIndex> m_parent_idx;
+    // Start of every level as of the last Layout(), followed by the end of the last one.
+    std::vector<ComponentIndex>      m_levels{ 0 };
+    // First level whose order is outdated, CLEAN if none.
+    size_t                           m_dirty_level = CLEAN;
+};
+
+template <typename T>
+inline T& HierarchyStorage<T>::AddComponent(Entity entity)
+{
+    T& component = Base::AddComponent(entity);
+    m_links.emplace_back();
+    // A forest of roots only stays laid out, new roots are appended to the single level.
+    if (m_dirty_level == CLEAN && NumLevels() <= 1) {
+        m_levels = { 0, static_cast<ComponentIndex>(Base::Size()) };
+        m_parent_idx.push_back(INVALID_COMPONENT_INDEX);
+    } else {
+        Invalidate(0);
+    }
+    return component;
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::AddComponents(const Entity* entities, size_t count, const T& value)
+{
+    Base::AddComponents(entities, count, value);
+    m_links.resize(Base::Size());
+    if (m_dirty_level == CLEAN && NumLevels() <= 1) {
+        m_levels = { 0, static_cast<ComponentIndex>(Base::Size()) };
+        m_parent_idx.resize(Base::Size(), INVALID_COMPONENT_INDEX);
+    } else {
+        Invalidate(0);
+    }
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::RemoveComponent(Entity entity)
+{
+    const ComponentIndex idx = Base::Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    Invalidate(LevelOf(idx));
+    if (m_links[idx].first_child != INVALID_ENTITY) {
+        for (Entity child = m_links[idx].first_child; child != INVALID_ENTITY;) {
+            Links& links = m_links[Base::Index(child)];
+            child = links.next_sibling;
+            links.parent = links.next_sibling = links.prev_sibling = INVALID_ENTITY;
+        }
+        Invalidate(0);
+    }
+    Detach(idx);
+    // The storage moves the last component into the freed slot.
+    Base::RemoveComponent(entity);
+    m_links[idx] = m_links.back();
+    m_links.pop_back();
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::SetParent(Entity entity, Entity parent)
+{
+    const ComponentIndex idx = Base::Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    if (m_links[idx].parent == parent) return;
+    size_t level = 0;
+    if (parent != INVALID_ENTITY) {
+        const ComponentIndex parent_idx = Base::Index(parent);
+        if (parent_idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: the parent does not contain the specific component");
+        for (Entity ancestor = parent; ancestor != INVALID_ENTITY; ancestor = m_links[Base::Index(ancestor)].parent) {
+            if (ancestor == entity) throw std::runtime_error("ComponentCollection: an entity cannot become a descendant of itself");
+        }
+        level = LevelOf(parent_idx) + 1;
+    }
+    // Both the level the node leaves and the one it joins change.
+    Invalidate(std::min(LevelOf(idx), level));
+    Detach(idx);
+    if (parent != INVALID_ENTITY) Attach(idx, parent);
+}
+
+template <typename T>
+inline Entity HierarchyStorage<T>::GetParent(Entity entity) const
+{
+    const ComponentIndex idx = Base::Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return m_links[idx].parent;
+}
+
+template <typename T>
+template <typename F>
+inline void HierarchyStorage<T>::EachChild(Entity entity, F&& f) const
+{
+    const ComponentIndex idx = Base::Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    for (Entity child = m_links[idx].first_child; child != INVALID_ENTITY; child = m_links[Base::Index(child)].next_sibling) f(child);
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::Detach(ComponentIndex idx)
+{
+    Links& links = m_links[idx];
+    if (links.parent == INVALID_ENTITY) return;
+    Links& parent = m_links[Base::Index(links.parent)];
+    const Entity entity = Base::Entities()[idx];
+    if (parent.first_child == entity) {
+        parent.first_child = links.next_sibling;
+        if (links.next_sibling != INVALID_ENTITY) m_links[Base::Index(links.next_sibling)].prev_sibling = links.prev_sibling;
+    } else {
+        m_links[Base::Index(links.prev_sibling)].next_sibling = links.next_sibling;
+        // The first child refers to the last one.
+        const Entity next = links.next_sibling != INVALID_ENTITY ? links.next_sibling : parent.first_child;
+        m_links[Base::Index(next)].prev_sibling = links.prev_sibling;
+    }
+    links.parent = links.next_sibling = links.prev_sibling = INVALID_ENTITY;
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::Attach(ComponentIndex idx, Entity parent)
+{
+    const Entity entity = Base::Entities()[idx];
+    Links& links = m_links[idx];
+    Links& parent_links = m_links[Base::Index(parent)];
+    links.parent = parent;
+    links.next_sibling = INVALID_ENTITY;
+    if (parent_links.first_child == INVALID_ENTITY) {
+        parent_links.first_child = entity;
+        links.prev_sibling = entity;
+    } else {
+        Links& first = m_links[Base::Index(parent_links.first_child)];
+        m_links[Base::Index(first.prev_sibling)].next_sibling = entity;
+        links.prev_sibling = first.prev_sibling;
+        first.prev_sibling = entity;
+    }
+}
+
+template <typename T>
+inline size_t HierarchyStorage<T>::LevelOf(ComponentIndex idx) const
+{
+    const size_t clean = std::min(m_dirty_level, NumLevels());
+    if (idx >= m_levels[clean]) return clean;
+    return static_cast<size_t>(std::upper_bound(m_levels.begin(), m_levels.begin() + clean + 1, idx) - m_levels.begin()) - 1;
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::BreadthFirst(size_t level, std::vector<ComponentIndex>& order, std::vector<ComponentIndex>& levels) const
+{
+    const size_t base = order.size();
+    const ComponentIndex start = m_levels[level];
+    auto append_children = [&](ComponentIndex idx) {
+        for (Entity child = m_links[idx].first_child; child != INVALID_ENTITY; child = m_links[order.back()].next_sibling) {
+            order.push_back(Base::Index(child));
+        }
+    };
+    if (level == 0) {
+        for (ComponentIndex i = 0; i < Base::Size(); ++i) {
+            if (m_links[i].parent == INVALID_ENTITY) order.push_back(i);
+        }
+    } else {
+        // Levels in front of level are laid out, the nodes of level are the children of the previous one.
+        for (ComponentIndex i = m_levels[level - 1]; i < start; ++i) append_children(i);
+    }
+    // Every pass appends the next level.
+    for (size_t first = base, last = order.size(); first < last; first = last, last = order.size()) {
+        levels.push_back(static_cast<ComponentIndex>(start + (first - base)));
+        for (size_t i = first; i < last; ++i) append_children(order[i]);
+    }
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::Layout()
+{
+    if (m_dirty_level == CLEAN) return;
+    const size_t level = std::min(m_dirty_level, NumLevels());
+    const ComponentIndex start = m_levels[level];
+    // order[i] is the dense index of the node that belongs to start + i.
+    std::vector<ComponentIndex> order;
+    order.reserve(Base::Size() - start);
+    std::vector<ComponentIndex> levels;
+    BreadthFirst(level, order, levels);
+    if (start + order.size() != Base::Size()) throw std::runtime_error("HierarchyStorage: the hierarchy contains a cycle");
+    m_levels.resize(level);
+    m_levels.insert(m_levels.end(), levels.begin(), levels.end());
+    m_levels.push_back(static_cast<ComponentIndex>(Base::Size()));
+
+    // Follow the cycles of the permutation like detail::SortDense(), moving every node at most once.
+    auto swap = [this](ComponentIndex lhs, ComponentIndex rhs) {
+        Base::Swap(lhs, rhs);
+        std::swap(m_links[lhs], m_links[rhs]);
+    };
+    for (ComponentIndex i = 0; i < order.size(); ++i) {
+        ComponentIndex curr = i;
+        for (ComponentIndex next = order[curr] - start; next != i; next = order[curr] - start) {
+            swap(start + curr, start + next);
+            order[curr] = start + curr;
+            curr = next;
+        }
+        order[curr] = start + curr;
+    }
+    m_parent_idx.resize(Base::Size());
+    for (ComponentIndex i = start; i < Base::Size(); ++i) {
+        m_parent_idx[i] = m_links[i].parent == INVALID_ENTITY ? INVALID_COMPONENT_INDEX : Base::Index(m_links[i].parent);
+    }
+    m_dirty_level = CLEAN;
+}
+
+template <typename T>
+template <typename F>
+inline void HierarchyStorage<T>::Propagate(F&& f)
+{
+    Layout();
+    for (ComponentIndex i = 0; i < Base::Size(); ++i) f((*this)[i], ParentAt(i));
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::Save(SnapshotWriter& writer) const
+{
+    Base::Save(writer);
+    // Children and their parents in breadth-first order, attaching them in this order restores the sibling order.
+    std::vector<ComponentIndex> order, levels;
+    order.reserve(Base::Size());
+    BreadthFirst(0, order, levels);
+    std::vector<Entity> links;
+    for (ComponentIndex idx : order) {
+        if (m_links[idx].parent == INVALID_ENTITY) continue;
+        links.push_back(Base::Entities()[idx]);
+        links.push_back(m_links[idx].parent);
+    }
+    writer.WriteArray(links);
+}
+
+template <typename T>
+inline void HierarchyStorage<T>::Load(SnapshotReader& reader)
+{
+    Base::Load(reader);
+    std::vector<Entity> links;
+    reader.ReadArray(links);
+    if (links.size() % 2 != 0) throw std::runtime_error("Snapshot: malformed hierarchy");
+    m_links.assign(Base::Size(), Links{});
+    m_parent_idx.clear();
+    m_levels = { 0 };
+    m_dirty_level = 0;
+    for (size_t i = 0; i < links.size(); i += 2) {
+        const ComponentIndex idx = Base::Index(links[i]);
+        if (idx == INVALID_COMPONENT_INDEX || !Base::HasComponent(links[i + 1]) || m_links[idx].parent != INVALID_ENTITY) {
+            throw std::runtime_error("Snapshot: malformed hierarchy");
+        }
+        Attach(idx, links[i + 1]);
+    }
+}
+
+} // namespace ecs
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace ecs
+{
+
+// Linear allocator handing out memory from a list of blocks obtained from an upstream resource.
+// Deallocation does nothing. Reset() rewinds to the first block and keeps all blocks for reuse, so once the arena
+// reached its high-water mark, allocating from it never touches the upstream resource again. Not thread-safe.
+class LinearArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit LinearArena(size_t block_size = DEFAULT_BLOCK_SIZE, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+        : m_block_size(block_size), m_upstream(upstream) {}
+    ~LinearArena() override { Release(); }
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+    LinearArena(LinearArena&& rhs) noexcept
+        : m_blocks(std::move(rhs.m_blocks)), m_block(rhs.m_block), m_offset(rhs.m_offset), m_block_size(rhs.m_block_size), m_upstream(rhs.m_upstream)
+    {
+        rhs.m_blocks.clear();
+        rhs.m_block = rhs.m_offset = 0;
+    }
+    LinearArena& operator=(LinearArena&& rhs) noexcept
+    {
+        if (this == &rhs) return *this;
+        Release();
+        m_blocks     = std::move(rhs.m_blocks);
+        m_block      = rhs.m_block;
+        m_offset     = rhs.m_offset;
+        m_block_size = rhs.m_block_size;
+        m_upstream   = rhs.m_upstream;
+        rhs.m_blocks.clear();
+        rhs.m_block = rhs.m_offset = 0;
+        return *this;
+    }
+
+    // Make all memory available again. Everything allocated from the arena so far becomes invalid.
+    void Reset() noexcept { m_block = m_offset = 0; }
+    // Return all blocks to the upstream resource.
+    void Release() noexcept;
+
+    // Total size of the blocks owned by the arena.
+    size_t Capacity() const noexcept;
+
+private:
+    struct Block {
+        std::byte* data;
+        size_t     size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void  do_deallocate(void*, size_t, size_t) override {}
+    bool  do_is_equal(const std::pmr::memory_resource& rhs) const noexcept override { return this == &rhs; }
+
+    std::vector<Block>         m_blocks;
+    size_t                     m_block  = 0;
+    size_t                     m_offset = 0;
+    size_t                     m_block_size;
+    std::pmr::memory_resource* m_upstream;
+};
+
+inline void* LinearArena::do_allocate(size_t bytes, size_t alignment)
+{
+    // Try the current block, then the following ones. Blocks too small for the request are skipped.
+    for (; m_block < m_blocks.size(); ++m_block, m_offset = 0) {
+        const Block& block   = m_blocks[m_block];
+        const auto   base    = reinterpret_cast<std::uintptr_t>(block.data);
+        const auto   aligned = (base + m_offset + alignment - 1) / alignment * alignment;
+        if (aligned + bytes <= base + block.size) {
+            m_offset = aligned + bytes - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+    // Requests larger than a block get a block of their own, which is kept like any other block.
+    const size_t size = std::max(m_block_size, bytes + alignment);
+    m_blocks.push_back({ static_cast<std::byte*>(m_upstream->allocate(size, alignof(std::max_align_t))), size });
+    m_block = m_blocks.size() - 1;
+    m_offset = 0;
+    return do_allocate(bytes, alignment);
+}
+
+inline void LinearArena::Release() noexcept
+{
+    for (const Block& block : m_blocks) m_upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+    m_blocks.clear();
+    m_block = m_offset = 0;
+}
+
+inline size_t LinearArena::Capacity() const noexcept
+{
+    size_t capacity = 0;
+    for (const Block& block : m_blocks) capacity += block.size;
+    return capacity;
+}
+
+} // namespace ecs
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "ecs/common.h"
+#include "ecs/view.h"
+
+#include <thirdparty/taskflow/taskflow/taskflow.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+namespace ecs
+{
+
+// Default minimum number of elements processed by a single task.
+constexpr size_t DEFAULT_GRAIN_SIZE = 1024;
+
+// All tasks of a loop share one copy of f and call it concurrently through a const reference, so f has to be
+// callable as const. Mutable lambdas are rejected, their state would be written by several tasks at once.
+
+// Split [0, count) into ranges of about grain elements and call f(first, last) for each of them from parallel tasks.
+// base points to the array of element_size-sized elements being processed (or is nullptr); range boundaries are placed
+// on cache line boundaries of that array, so no two tasks write to the same cache line.
+// Returns the task spawning the ranges within subflow. Ranges are stolen by idle workers of the executor,
+// and all of them have finished once the returned task has, which can be used to order several loops with precede().
+template <typename F>
+tf::Task ParallelFor(tf::Subflow& subflow, const void* base, size_t element_size, size_t count, size_t grain, F f);
+
+// Call f(Entity, T&) for every component of a storage from parallel tasks, grain components per task.
+// The storage has to provide dense Entities() and operator[] like SparseComponentStorage.
+template <typename StorageT, typename F>
+tf::Task ParallelEach(tf::Subflow& subflow, StorageT& storage, F f, size_t grain = DEFAULT_GRAIN_SIZE);
+
+// Call f(Entity, ComponentTs&...) for every entity of a view from parallel tasks, grain candidate entities per task.
+template <typename FilterT, typename... ComponentTs, typename F>
+tf::Task ParallelView(tf::Subflow& subflow, const ComponentView<FilterT, ComponentTs...>& view, F f, size_t grain = DEFAULT_GRAIN_SIZE);
+
+// Lay out a HierarchyStorage and call f(T& node, const T* parent) for every node from parallel tasks, level by level,
+// so that the parents of a level are done before any of their children. parent is nullptr for roots.
+template <typename StorageT, typename F>
+tf::Task ParallelPropagate(tf::Subflow& subflow, StorageT& storage, F f, size_t grain = DEFAULT_GRAIN_SIZE);
+
+// Call f(Entity, Entity) for every pair of entities of a SpatialHashStorage within radius of each other from parallel
+// tasks, grain cells per task. f is called concurrently and has to synchronize its side effects, e.g., by appending
+// to per-worker buffers.
+template <typename StorageT, typename F>
+tf::Task ParallelPairs(tf::Subflow& subflow, const StorageT& storage, float radius, F f, size_t grain = 64);
+
+namespace detail
+{
+
+// Emit one task per range of [0, count) into subflow, see ParallelFor(). f has to outlive the subflow.
+template <typename F>
+inline void EmitRanges(tf::Subflow& subflow, const void* base, size_t element_size, size_t count, size_t grain, const F& f)
+{
+    // Round grain up to a whole number of cache lines worth of elements.
+    const size_t line_elements = std::lcm(element_size, CACHE_LINE_SIZE) / element_size;
+    grain = (std::max<size_t>(grain, 1) + line_elements - 1) / line_elements * line_elements;
+    if (count <= grain) {
+        if (count > 0) f(size_t(0), count);
+        return;
+    }
+    // Find the first element starting a cache line, all following boundaries are then cache line aligned as well.
+    size_t first = 0;
+    if (base) {
+        const auto address = reinterpret_cast<std::uintptr_t>(base);
+        while (first < line_elements && (address + first * element_size) % CACHE_LINE_SIZE != 0) ++first;
+        if (first == line_elements) first = 0;
+    }
+    size_t begin = 0;
+    for (size_t end = first > 0 ? first : grain; begin < count; end = begin + grain) {
+        end = std::min(end, count);
+        subflow.emplace([&f, begin, end]() { f(begin, end); });
+        begin = end;
+    }
+}
+
+} // namespace detail
+
+template <typename F>
+inline tf::Task ParallelFor(tf::Subflow& subflow, const void* base, size_t element_size, size_t count, size_t grain, F f)
+{
+    static_assert(std::is_invocable_v<const F&, size_t, size_t>, "ParallelFor: f has to be callable as const, e.g., not a mutable lambda");
+    return subflow.emplace([base, element_size, count, grain, f = std::move(f)](tf::Subflow& ranges) {
+        detail::EmitRanges(ranges, base, element_size, count, grain, f);
+        ranges.join();
+    });
+}
+
+template <typename StorageT, typename F>
+inline tf::Task ParallelEach(tf::Subflow& subflow, StorageT& storage, F f, size_t grain)
+{
+    static_assert(std::is_invocable_v<const F&, Entity, decltype(std::declval<StorageT&>()[0])>, "ParallelEach: f has to be callable as const, e.g., not a mutable lambda");
+    // The storage is only inspected once the task runs, i.e., after all preceding tasks are done with it.
+    return subflow.emplace([&storage, grain, f = std::move(f)](tf::Subflow& ranges) {
+        const size_t count = storage.Size();
+        if (count == 0) return;
+        auto range = [&storage, &f](size_t first, size_t last) {
+            const auto& entities = storage.Entities();
+            for (size_t i = first; i < last; ++i) f(entities[i], storage[i]);
+        };
+        detail::EmitRanges(ranges, &storage[0], sizeof(storage[0]), count, grain, range);
+        ranges.join();
+    });
+}
+
+template <typename FilterT, typename... ComponentTs, typename F>
+inline tf::Task ParallelView(tf::Subflow& subflow, const ComponentView<FilterT, ComponentTs...>& view, F f, size_t grain)
+{
+    static_assert(std::is_invocable_v<const F&, Entity, ComponentTs&...>, "ParallelView: f has to be callable as const, e.g., not a mutable lambda");
+    return subflow.emplace([view, grain, f = std::move(f)](tf::Subflow& ranges) {
+        auto range = [&view, &f](size_t first, size_t last) { view.Each(first, last, f); };
+        detail::EmitRanges(ranges, nullptr, sizeof(Entity), view.SizeHint(), grain, range);
+        ranges.join();
+    });
+}
+
+template <typename StorageT, typename F>
+inline tf::Task ParallelPropagate(tf::Subflow& subflow, StorageT& storage, F f, size_t grain)
+{
+    static_assert(std::is_invocable_v<const F&, typename StorageT::ComponentType&, const typename StorageT::ComponentType*>, "ParallelPropagate: f has to be callable as const, e.g., not a mutable lambda");
+    return subflow.emplace([&storage, grain, f = std::move(f)](tf::Subflow& levels) {
+        storage.Layout();
+        tf::Task previous;
+        for (size_t level = 0; level < storage.NumLevels(); ++level) {
+            tf::Task task = levels.emplace([&storage, &f, grain, level](tf::Subflow& ranges) {
+                const ComponentIndex begin = storage.LevelBegin(level);
+                auto range = [&storage, &f, begin](size_t first, size_t last) {
+                    for (ComponentIndex i = begin + first; i < begin + last; ++i) f(storage[i], storage.ParentAt(i));
+                };
+                detail::EmitRanges(ranges, &storage[begin], sizeof(storage[begin]), storage.LevelEnd(level) - begin, grain, range);
+                ranges.join();
+            });
+            if (!previous.empty()) previous.precede(task);
+            previous = task;
+        }
+        levels.join();
+    });
+}
+
+template <typename StorageT, typename F>
+inline tf::Task ParallelPairs(tf::Subflow& subflow, const StorageT& storage, float radius, F f, size_t grain)
+{
+    static_assert(std::is_invocable_v<const F&, Entity, Entity>, "ParallelPairs: f has to be callable as const, e.g., not a mutable lambda");
+    return subflow.emplace([&storage, radius, grain, f = std::move(f)](tf::Subflow& ranges) {
+        auto range = [&storage, radius, &f](size_t first, size_t last) { storage.ForEachPair(first, last, radius, f); };
+        detail::EmitRanges(ranges, nullptr, sizeof(Entity), storage.NumCells(), grain, range);
+        ranges.join();
+    });
+}
+
+} // namespace ecs
+
+#endif
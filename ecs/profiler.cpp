@@ -0,0 +1,165 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+namespace ecs
+{
+
+Profiler::Profiler(size_t num_workers, size_t capacity) : m_events(capacity), m_num_workers(num_workers)
+{
+    if (capacity == 0) throw std::runtime_error("Profiler: capacity must not be 0");
+}
+
+void Profiler::BeginFrame()
+{
+    ++m_frame;
+    m_frame_start = Now();
+}
+
+void Profiler::EndFrame()
+{
+    Record("Frame", ProfileEvent::Kind::FRAME, m_frame_start, Now(), -1);
+    m_completed_frame = m_frame;
+}
+
+void Profiler::Record(const char* name, ProfileEvent::Kind kind, std::uint64_t start_ns, std::uint64_t end_ns, int worker, std::uint64_t entities)
+{
+    const auto index = m_next.fetch_add(1, std::memory_order_relaxed);
+    ProfileEvent& event = m_events[index % m_events.size()];
+    event.name     = name;
+    event.kind     = kind;
+    event.frame    = m_frame;
+    event.start_ns = start_ns;
+    event.end_ns   = end_ns;
+    event.wait_ns  = start_ns > m_frame_start ? start_ns - m_frame_start : 0;
+    event.worker   = worker;
+    event.entities = entities;
+}
+
+std::vector<ProfileEvent> Profiler::Events() const
+{
+    const auto next  = m_next.load(std::memory_order_relaxed);
+    const auto count = std::min<std::uint64_t>(next, m_events.size());
+    std::vector<ProfileEvent> events;
+    events.reserve(static_cast<size_t>(count));
+    for (auto i = next - count; i < next; ++i) events.push_back(m_events[i % m_events.size()]);
+    return events;
+}
+
+FrameProfile Profiler::Frame(std::uint64_t frame) const
+{
+    FrameProfile profile;
+    profile.frame = frame;
+    profile.worker_busy_ns.resize(m_num_workers);
+
+    std::uint64_t begin = UINT64_MAX, end = 0;
+    // Start (+1) and end (-1) of every system run, swept in time order to find the parallel sections.
+    std::vector<std::pair<std::uint64_t, int>> edges;
+    for (const ProfileEvent& event : Events()) {
+        if (event.frame != frame) continue;
+        const auto duration = event.end_ns - event.start_ns;
+        switch (event.kind) {
+        case ProfileEvent::Kind::FRAME:
+            profile.duration_ns = duration;
+            begin = event.start_ns;
+            end   = event.end_ns;
+            break;
+        case ProfileEvent::Kind::COMMANDS:
+            profile.commands_ns += duration;
+            break;
+        case ProfileEvent::Kind::SYSTEM:
+            profile.systems_ns += duration;
+            if (event.worker >= 0 && static_cast<size_t>(event.worker) < m_num_workers) profile.worker_busy_ns[event.worker] += duration;
+            edges.emplace_back(event.start_ns, 1);
+            edges.emplace_back(event.end_ns, -1);
+            break;
+        }
+    }
+    if (begin > end) return profile;
+
+    std::sort(edges.begin(), edges.end());
+    std::uint64_t parallel_ns = 0, last = 0;
+    int running = 0;
+    for (const auto& [time, delta] : edges) {
+        if (running >= 2) parallel_ns += time - last;
+        running += delta;
+        last = time;
+    }
+    profile.serialized_ns = profile.duration_ns - std::min(parallel_ns, profile.duration_ns);
+    return profile;
+}
+
+namespace
+{
+void WriteJsonString(std::ostream& out, const char* value)
+{
+    out << '"';
+    for (; value && *value; ++value) {
+        const char c = *value;
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (static_cast<unsigned char>(c) >= 0x20) out << c;
+    }
+    out << '"';
+}
+
+const char* CategoryName(ProfileEvent::Kind kind)
+{
+    switch (kind) {
+    case ProfileEvent::Kind::SYSTEM:   return "system";
+    case ProfileEvent::Kind::COMMANDS: return "commands";
+    case ProfileEvent::Kind::FRAME:    return "frame";
+    }
+    return "";
+}
+} // namespace
+
+void Profiler::WriteChromeTrace(std::ostream& out) const
+{
+    // Trace timestamps are in microseconds.
+    auto micros = [](std::uint64_t ns) { return static_cast<double>(ns) / 1000.; };
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const ProfileEvent& event : Events()) {
+        if (!first) out << ',';
+        first = false;
+        out << "{\"name\":";
+        WriteJsonString(out, event.name);
+        out << ",\"cat\":\"" << CategoryName(event.kind) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.worker + 1
+            << ",\"ts\":" << micros(event.start_ns) << ",\"dur\":" << micros(event.end_ns - event.start_ns)
+            << ",\"args\":{\"frame\":" << event.frame;
+        if (event.kind == ProfileEvent::Kind::SYSTEM) out << ",\"wait_us\":" << micros(event.wait_ns) << ",\"entities\":" << event.entities;
+        out << "}}";
+    }
+    out << "],\"displayTimeUnit\":\"ns\"}";
+}
+
+void Profiler::Clear()
+{
+    m_next = 0;
+    m_frame = m_frame_start = m_completed_frame = 0;
+}
+
+std::string detail::TypeName(const char* mangled)
+{
+#if defined(__GNUG__)
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    if (status == 0 && demangled) {
+        std::string name(demangled);
+        std::free(demangled);
+        return name;
+    }
+    std::free(demangled);
+#endif
+    return mangled;
+}
+
+} // namespace ecs
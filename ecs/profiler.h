@@ -0,0 +1,132 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Registry records profiling events only if built with ECS_PROFILING=1, e.g., with the ENABLE_PROFILING CMake option.
+// Otherwise the instrumentation is compiled out and the Profiler of a registry stays empty.
+#ifndef ECS_PROFILING
+#define ECS_PROFILING 0
+#endif
+
+namespace ecs
+{
+
+// A timed span recorded by the Profiler.
+struct ProfileEvent {
+    enum class Kind : std::uint8_t {
+        // A single System::Run() call
+        SYSTEM,
+        // Playback of the command buffers at the end of a Registry::Run() step
+        COMMANDS,
+        // A whole Registry::Run() step
+        FRAME,
+    };
+
+    // Static name of the span, e.g., the type name of a system.
+    const char*   name = nullptr;
+    Kind          kind = Kind::SYSTEM;
+    // Number of the Registry::Run() step the span belongs to, starting at 1.
+    std::uint64_t frame = 0;
+    // Nanoseconds since the creation of the profiler.
+    std::uint64_t start_ns = 0;
+    std::uint64_t end_ns = 0;
+    // Time from the start of the frame to the start of the span, i.e., waiting on preceding systems and free workers.
+    std::uint64_t wait_ns = 0;
+    // Worker the span ran on, -1 for threads outside of the executor.
+    int           worker = -1;
+    // Entities returned by the queries of a system.
+    std::uint64_t entities = 0;
+};
+
+// Summary of a single Registry::Run() step.
+struct FrameProfile {
+    std::uint64_t frame = 0;
+    std::uint64_t duration_ns = 0;
+    // Sum of the wall time of all system runs.
+    std::uint64_t systems_ns = 0;
+    // Time spent playing back commands.
+    std::uint64_t commands_ns = 0;
+    // Time during which at most one system was running, i.e., the frame did not make use of parallelism.
+    std::uint64_t serialized_ns = 0;
+    // Time every worker spent running systems, indexed by worker id.
+    std::vector<std::uint64_t> worker_busy_ns;
+
+    // Fraction of the frame a worker spent running systems.
+    double Utilization(size_t worker) const
+    {
+        return duration_ns > 0 ? static_cast<double>(worker_busy_ns[worker]) / static_cast<double>(duration_ns) : 0.;
+    }
+};
+
+// Fixed-size ring buffer of profiling events. Once full, the oldest events are overwritten.
+// Record() is lock-free and may be called from any thread. All other methods must not run concurrently with it,
+// e.g., Registry::Run() has to have returned before inspecting the events of a registry's profiler.
+class Profiler {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    explicit Profiler(size_t num_workers, size_t capacity = DEFAULT_CAPACITY);
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Nanoseconds since the creation of the profiler.
+    std::uint64_t Now() const
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_epoch).count());
+    }
+
+    // Start a new frame. Events recorded from now on belong to it.
+    void BeginFrame();
+    // Record the span of the current frame, from BeginFrame() until now.
+    void EndFrame();
+    // Record a span within the current frame.
+    void Record(const char* name, ProfileEvent::Kind kind, std::uint64_t start_ns, std::uint64_t end_ns, int worker, std::uint64_t entities = 0);
+
+    // Number of the current frame, 0 before the first BeginFrame().
+    std::uint64_t CurrentFrame() const { return m_frame; }
+    size_t Capacity() const { return m_events.size(); }
+    size_t NumWorkers() const { return m_num_workers; }
+
+    // All events still held by the ring buffer, oldest first.
+    std::vector<ProfileEvent> Events() const;
+    // Summarize a frame from its events. Frames partly overwritten in the ring buffer yield incomplete numbers.
+    FrameProfile Frame(std::uint64_t frame) const;
+    // Summarize the last completed frame.
+    FrameProfile LastFrame() const { return Frame(m_completed_frame); }
+
+    // Write all events in the Chrome trace event format, which chrome://tracing and Perfetto can open.
+    // Every worker shows up as a thread of its own; the frames and commands of the calling thread as thread 0.
+    void WriteChromeTrace(std::ostream& out) const;
+
+    // Drop all events.
+    void Clear();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point          m_epoch = Clock::now();
+    std::vector<ProfileEvent>  m_events;
+    std::atomic<std::uint64_t> m_next{ 0 };
+    size_t                     m_num_workers;
+    std::uint64_t              m_frame = 0;
+    std::uint64_t              m_frame_start = 0;
+    std::uint64_t              m_completed_frame = 0;
+};
+
+namespace detail
+{
+// Human readable name of a type, demangled where the compiler supports it.
+std::string TypeName(const char* mangled);
+} // namespace detail
+
+} // namespace ecs
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "ecs/common.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace ecs
+{
+
+class Registry;
+
+// Persistent query over all entities having every required component and none of the excluded ones.
+// Queries are created with registry.CreateQuery<A, B>().Exclude<C>() and stay owned by the Registry. The Registry
+// updates the matching entities on every structural change made through it, i.e., AddComponent(s), RemoveComponent(s),
+// CreateEntities, DestroyEntity/DestroyEntities and command buffer playback, so iterating costs O(matches).
+// Components added or removed directly on a storage obtained from ComponentAccess::Write() are not seen by queries.
+class CachedQuery {
+public:
+    CachedQuery(const CachedQuery&) = delete;
+    CachedQuery& operator=(const CachedQuery&) = delete;
+
+    // Additionally require entities to have none of ComponentTs. Rebuilds the matching entities.
+    template <typename... ComponentTs>
+    CachedQuery& Exclude();
+
+    // Matching entities in no particular order.
+    const std::pmr::vector<Entity>& Entities() const { return m_entities; }
+    size_t Size() const { return m_entities.size(); }
+    bool Contains(Entity entity) const
+    {
+        const EntityIndex idx = GetEntityIndex(entity);
+        return idx < m_positions.size() && m_positions[idx] != INVALID_POSITION && m_entities[m_positions[idx]] == entity;
+    }
+
+    std::pmr::vector<Entity>::const_iterator begin() const { return m_entities.cbegin(); }
+    std::pmr::vector<Entity>::const_iterator end()   const { return m_entities.cend(); }
+
+    // Call f(Entity, ComponentTs&...) for every matching entity. ComponentTs have to be among the required components.
+    // Accesses are not checked against the declared access of a system.
+    template <typename... ComponentTs, typename F>
+    void Each(F&& f);
+
+    // Component types matching entities must have, respectively must not have.
+    const std::vector<ComponentId>& Required() const { return m_required; }
+    const std::vector<ComponentId>& Excluded() const { return m_excluded; }
+
+private:
+    static constexpr std::uint32_t INVALID_POSITION = ~0u;
+
+    CachedQuery(Registry& registry, std::vector<ComponentId> required, std::pmr::memory_resource* resource)
+        : m_registry(registry), m_required(std::move(required)), m_entities(resource), m_positions(resource) {}
+
+    // Add or remove an entity, both do nothing if the entity already is, respectively is not, part of the query.
+    void Insert(Entity entity);
+    void Erase(Entity entity);
+    void Clear() { m_entities.clear(); m_positions.clear(); }
+
+    Registry&                       m_registry;
+    std::vector<ComponentId>        m_required;
+    std::vector<ComponentId>        m_excluded;
+    std::pmr::vector<Entity>        m_entities;
+    // Position of every entity in m_entities, indexed by entity index.
+    std::pmr::vector<std::uint32_t> m_positions;
+
+    friend class Registry;
+};
+
+inline void CachedQuery::Insert(Entity entity)
+{
+    if (Contains(entity)) return;
+    const EntityIndex idx = GetEntityIndex(entity);
+    if (idx >= m_positions.size()) m_positions.resize(size_t(idx) + 1, INVALID_POSITION);
+    m_positions[idx] = static_cast<std::uint32_t>(m_entities.size());
+    m_entities.push_back(entity);
+}
+
+inline void CachedQuery::Erase(Entity entity)
+{
+    if (!Contains(entity)) return;
+    const std::uint32_t position = m_positions[GetEntityIndex(entity)];
+    m_entities[position] = m_entities.back();
+    m_positions[GetEntityIndex(m_entities[position])] = position;
+    m_positions[GetEntityIndex(entity)] = INVALID_POSITION;
+    m_entities.pop_back();
+}
+
+} // namespace ecs
+
+#endif
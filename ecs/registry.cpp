@@ -1,57 +1,749 @@
 #include "registry.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace ecs
 {
 
 void Registry::Run()
 {
+    BeginStep();
     m_executor.run(m_taskflow);
     m_executor.wait_for_all();
+    EndStep();
+}
+
+void Registry::RunFor(size_t num_steps)
+{
+    RunUntil([num_steps]() mutable { return num_steps-- == 0; });
+}
+
+std::future<void> Registry::RunAsync(size_t num_steps)
+{
+    return RunAsyncUntil([num_steps]() mutable { return num_steps-- == 0; });
+}
+
+void Registry::BeginStep()
+{
+#if ECS_PROFILING
+    m_profiler.BeginFrame();
+#endif
+    for (auto& arena : m_frame_arenas) arena.Reset();
+}
+
+void Registry::EndStep()
+{
+    // Changes made between steps, including the commands played back now, come after all system runs of this step.
+    AdvanceTick();
+    for (auto& channel : m_events) {
+        if (channel) channel->Swap();
+    }
+#if ECS_PROFILING
+    const auto commands_start = m_profiler.Now();
+    FlushCommands();
+    m_profiler.Record("FlushCommands", ProfileEvent::Kind::COMMANDS, commands_start, m_profiler.Now(), m_executor.this_worker_id());
+    m_profiler.EndFrame();
+#else
+    FlushCommands();
+#endif
+}
+
+void Registry::UpdateQueries(const Entity* entities, size_t num_entities, const ComponentId* types, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (types[i] >= m_component_queries.size()) continue;
+        for (CachedQuery* query : m_component_queries[types[i]]) {
+            for (size_t j = 0; j < num_entities; ++j) {
+                if (Matches(*query, entities[j])) query->Insert(entities[j]);
+                else query->Erase(entities[j]);
+            }
+        }
+    }
+}
+
+void Registry::OnStructuralChange(const Entity* entities, size_t num_entities, const ComponentId* types, size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_entity_mtx);
+        const Tick tick = m_tick;
+        for (size_t i = 0; i < num_entities; ++i) {
+            const EntityIndex idx = GetEntityIndex(entities[i]);
+            m_entity_ticks[idx] = tick;
+            for (size_t j = 0; j < count; ++j) SetType(idx, types[j], m_components[types[j]]->HasComponent(entities[i]));
+        }
+    }
+    UpdateQueries(entities, num_entities, types, count);
+    for (size_t i = 0; i < count; ++i) {
+        if (types[i] >= m_component_groups.size() || !m_component_groups[types[i]]) continue;
+        for (size_t j = 0; j < num_entities; ++j) m_component_groups[types[i]]->Refresh(entities[j]);
+    }
+}
+
+void Registry::LeaveGroups(const Entity* entities, size_t num_entities, const ComponentId* types, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (types[i] >= m_component_groups.size() || !m_component_groups[types[i]]) continue;
+        for (size_t j = 0; j < num_entities; ++j) m_component_groups[types[i]]->Leave(entities[j]);
+    }
+}
+
+void Registry::CheckNotGrouped(ComponentId type) const
+{
+    if (type < m_component_groups.size() && m_component_groups[type]) throw std::runtime_error("Registry: the component type is owned by a group");
+}
+
+void Registry::CheckAlive(Entity entity)
+{
+    std::lock_guard<std::mutex> lock(m_entity_mtx);
+    if (!IsAlive(entity)) throw std::runtime_error("Registry: the specified entity is not alive");
+}
+
+void Registry::CheckDistinct(const ComponentId* types, size_t count)
+{
+    for (size_t i = 1; i < count; ++i) {
+        if (std::find(types, types + i, types[i]) != types + i) throw std::runtime_error("Registry: a component type is specified more than once");
+    }
+}
+
+void Registry::ResizeSignatures()
+{
+    const size_t words = std::max<size_t>(1, (m_components.size() + 63) / 64);
+    if (words > m_signature_words) {
+        // Widen every signature in place, back to front so that no signature is overwritten before it was moved.
+        m_signatures.resize(m_entities.size() * words, 0);
+        for (size_t i = m_entities.size(); i-- > 0;) {
+            for (size_t w = words; w-- > 0;) m_signatures[i * words + w] = w < m_signature_words ? m_signatures[i * m_signature_words + w] : 0;
+        }
+        m_signature_words = words;
+    }
+    m_signatures.resize(m_entities.size() * m_signature_words, 0);
+}
+
+void Registry::RebuildSignatures()
+{
+    ResizeSignatures();
+    for (EntityIndex i = 0; i < m_entities.size(); ++i) {
+        if (GetEntityIndex(m_entities[i]) != i) continue;
+        for (ComponentId type = 0; type < m_components.size(); ++type) {
+            if (m_components[type] && m_components[type]->HasComponent(m_entities[i])) SetType(i, type, true);
+        }
+    }
+}
+
+void Registry::MatchSignatures(const ComponentId* include, size_t num_include, const ComponentId* exclude, size_t num_exclude,
+                               std::pmr::vector<Entity>& entities) const
+{
+    const size_t words = m_signature_words;
+    std::vector<std::uint64_t> include_mask(words, 0), exclude_mask(words, 0);
+    auto set = [this](std::vector<std::uint64_t>& mask, ComponentId type) {
+        if (type >= m_components.size() || !m_components[type]) throw std::runtime_error("Registry: the specified component type is not registered");
+        mask[type / 64] |= std::uint64_t(1) << (type % 64);
+    };
+    for (size_t i = 0; i < num_include; ++i) set(include_mask, include[i]);
+    for (size_t i = 0; i < num_exclude; ++i) set(exclude_mask, exclude[i]);
+
+    // Test the signatures of 64 slots at a time into a bit mask of matches. The inner loops are free of branches
+    // so that the compiler vectorizes them, only slots with a set bit are looked at individually.
+    const size_t num_slots = m_entities.size();
+    const std::uint64_t* signatures = m_signatures.data();
+    for (size_t block = 0; block < num_slots; block += 64) {
+        const size_t n = std::min<size_t>(64, num_slots - block);
+        std::uint64_t matches = 0;
+        if (words == 1) {
+            const std::uint64_t inc = include_mask[0], exc = exclude_mask[0];
+            for (size_t i = 0; i < n; ++i) {
+                const std::uint64_t s = signatures[block + i];
+                matches |= std::uint64_t((s & inc) == inc && (s & exc) == 0) << i;
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                const std::uint64_t* s = signatures + (block + i) * words;
+                std::uint64_t mismatch = 0;
+                for (size_t w = 0; w < words; ++w) mismatch |= (~s[w] & include_mask[w]) | (s[w] & exclude_mask[w]);
+                matches |= std::uint64_t(mismatch == 0) << i;
+            }
+        }
+        while (matches) {
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanForward64(&bit, matches);
+#else
+            const int bit = __builtin_ctzll(matches);
+#endif
+            matches &= matches - 1;
+            const EntityIndex idx = static_cast<EntityIndex>(block + bit);
+            // Free slots have empty signatures, which only match if nothing is included.
+            if (GetEntityIndex(m_entities[idx]) == idx) entities.push_back(m_entities[idx]);
+        }
+    }
+}
+
+bool Registry::Matches(const CachedQuery& query, Entity entity) const
+{
+    if (!IsAlive(entity)) return false;
+    const EntityIndex idx = GetEntityIndex(entity);
+    for (ComponentId type : query.m_required) {
+        if (!HasType(idx, type)) return false;
+    }
+    for (ComponentId type : query.m_excluded) {
+        if (HasType(idx, type)) return false;
+    }
+    return true;
+}
+
+void Registry::RebuildQuery(CachedQuery& query)
+{
+    query.Clear();
+    for (EntityIndex i = 0; i < m_entities.size(); ++i) {
+        if (GetEntityIndex(m_entities[i]) == i && Matches(query, m_entities[i])) query.Insert(m_entities[i]);
+    }
+}
+
+void Registry::AdvanceTick()
+{
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    const Tick tick = ++m_tick;
+    for (auto& storage : m_components) {
+        if (storage) storage->SetTick(tick);
+    }
+    m_archetypes.SetTick(tick);
+}
+
+size_t Registry::GetWorkerSlot()
+{
+    const int worker = m_executor.this_worker_id();
+    return worker >= 0 ? static_cast<size_t>(worker) : m_executor.num_workers();
+}
+
+std::pmr::memory_resource& Registry::FrameResource()
+{
+    return m_frame_arenas[GetWorkerSlot()];
+}
+
+CommandBuffer& Registry::Commands()
+{
+    return m_command_buffers[GetWorkerSlot()];
+}
+
+std::vector<CommandBuffer> Registry::MakeCommandBuffers(size_t count)
+{
+    std::vector<CommandBuffer> buffers;
+    buffers.reserve(count);
+    for (size_t i = 0; i < count; ++i) buffers.emplace_back(static_cast<EntityVersion>(i));
+    return buffers;
+}
+
+Entity Registry::ResolvePlaceholder(Entity entity) const
+{
+    if (!CommandBuffer::IsPlaceholder(entity)) return entity;
+    const size_t buffer = CommandBuffer::BufferOf(entity);
+    const EntityIndex idx = GetEntityIndex(entity);
+    if (buffer >= m_command_buffers.size() || idx >= m_command_buffers[buffer].m_created.size()) {
+        throw std::runtime_error("Registry: the command refers to an unknown placeholder entity");
+    }
+    return m_command_buffers[buffer].m_created[idx];
+}
+
+void Registry::FlushCommands()
+{
+    // Create deferred entities first so that all other commands can refer to them.
+    {
+        std::lock_guard<std::mutex> lock(m_entity_mtx);
+        for (auto& buffer : m_command_buffers) {
+            buffer.m_created.resize(buffer.m_num_created);
+            AllocateEntities(buffer.m_created.data(), buffer.m_created.size());
+        }
+    }
+    // Failed playbacks drop all commands, otherwise every later step would replay them and fail again.
+    auto drop = [this]() {
+        m_pending_commands.clear();
+        for (auto& buffer : m_command_buffers) buffer.Clear();
+    };
+    // Gather the component commands of all buffers, resolve placeholders and check storages before applying anything.
+    std::vector<Entity> destroyed;
+    m_pending_commands.clear();
+    try {
+        for (auto& buffer : m_command_buffers) {
+            for (auto& command : buffer.m_commands) {
+                command.entity = ResolvePlaceholder(command.entity);
+                if (!command.apply) {
+                    destroyed.push_back(command.entity);
+                    continue;
+                }
+                if (command.type >= m_components.size() || !m_components[command.type]) throw std::runtime_error("Registry: the specified component type is not registered");
+                if (command.storage != CommandBuffer::ANY_STORAGE && m_storage_ids[command.type] != command.storage) throw std::runtime_error("Registry: the component type is registered with another storage");
+                m_pending_commands.push_back(&command);
+            }
+        }
+    } catch (...) {
+        drop();
+        throw;
+    }
+    // Apply component commands storage by storage. The stable sort keeps the recorded order per buffer.
+    std::stable_sort(m_pending_commands.begin(), m_pending_commands.end(), [](const auto* a, const auto* b) { return a->type < b->type; });
+    try {
+        std::lock_guard<std::mutex> lock(m_component_mtx);
+        for (auto* command : m_pending_commands) {
+            if (!IsAlive(command->entity)) continue;
+            command->apply(*this, command->entity, command->payload);
+            OnStructuralChange(&command->entity, 1, &command->type, 1);
+        }
+    } catch (...) {
+        drop();
+        throw;
+    }
+    m_pending_commands.clear();
+    // Destroy entities in bulk, each of them once.
+    std::sort(destroyed.begin(), destroyed.end());
+    destroyed.erase(std::unique(destroyed.begin(), destroyed.end()), destroyed.end());
+    destroyed.erase(std::remove_if(destroyed.begin(), destroyed.end(), [this](Entity entity) { return !IsAlive(entity); }), destroyed.end());
+    if (!destroyed.empty()) DestroyEntities(destroyed);
+
+    for (auto& buffer : m_command_buffers) buffer.Clear();
 }
 
 void Registry::Reset()
 {
     m_entities.clear();
+    m_entity_ticks.clear();
+    m_signatures.clear();
+    m_signature_words = 1;
+    m_free_entity = INVALID_ENTITY_INDEX;
     m_components.clear();
+    m_storage_names.clear();
+    m_storage_ids.clear();
+    m_queries.clear();
+    m_component_queries.clear();
+    m_groups.clear();
+    m_component_groups.clear();
+    m_archetypes.Clear();
+    // Recorded events point to the names of the systems.
+    m_profiler.Clear();
     m_systems.clear();
+    m_taskflow.clear();
+    for (auto& buffer : m_command_buffers) buffer.Clear();
+    m_events.clear();
 }
 
-Registry::EntityBuilder Registry::CreateEntity()
+namespace
 {
-    // Each time entity space is out, we extend an array by this number of elements.
-    static constexpr uint32_t ENTITY_SIZE_INCREMENT = 128;
+constexpr char          SNAPSHOT_MAGIC[8] = { 'E', 'C', 'S', 'S', 'N', 'A', 'P', '\0' };
+// Written in native byte order, rejects snapshots of machines with a different one.
+constexpr std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+constexpr char          DELTA_MAGIC[8] = { 'E', 'C', 'S', 'D', 'E', 'L', 'T', 'A' };
 
-    std::lock_guard<std::mutex> lock(m_entity_mtx);
+// FNV-1a hash of a storage name, identifying storages within deltas with fewer bytes than the name.
+std::uint64_t NameHash(const char* name)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (; *name; ++name) hash = (hash ^ static_cast<unsigned char>(*name)) * 1099511628211ull;
+    return hash;
+}
+} // namespace
+
+void Registry::SaveSnapshot(std::ostream& out)
+{
+    std::lock_guard<std::mutex> clock(m_component_mtx), elock(m_entity_mtx);
+    SnapshotWriter writer(out);
+    writer.WriteBytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writer.Write(SNAPSHOT_VERSION);
+    writer.Write(SNAPSHOT_BYTE_ORDER);
+    writer.Write<Tick>(m_tick);
+    writer.Write(m_free_entity);
+    writer.WriteArray(m_entities);
+    // List all storages up front, so loading can validate them before touching anything.
+    std::vector<ComponentId> ids;
+    for (ComponentId id = 0; id < m_components.size(); ++id) {
+        if (m_components[id]) ids.push_back(id);
+    }
+    writer.Write(static_cast<std::uint32_t>(ids.size()));
+    for (ComponentId id : ids) writer.WriteString(m_storage_names[id]);
+    for (ComponentId id : ids) m_components[id]->Save(writer);
+}
+
+void Registry::SaveSnapshot(const std::string& path)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Registry: cannot open " + path + " for writing");
+    SaveSnapshot(out);
+    out.close();
+    if (!out) throw std::runtime_error("Registry: failed to write " + path);
+}
+
+void Registry::LoadSnapshot(const std::string& path)
+{
+    MappedFile file(path);
+    LoadSnapshot(file.Data(), file.Size());
+}
+
+void Registry::LoadSnapshot(const void* data, size_t size)
+{
+    std::lock_guard<std::mutex> clock(m_component_mtx), elock(m_entity_mtx);
+    SnapshotReader reader(data, size);
+    if (std::memcmp(reader.ReadBytes(sizeof(SNAPSHOT_MAGIC)), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("Registry: not a snapshot");
+    }
+    if (reader.Read<std::uint32_t>() != SNAPSHOT_VERSION) throw std::runtime_error("Registry: unsupported snapshot version");
+    if (reader.Read<std::uint32_t>() != SNAPSHOT_BYTE_ORDER) throw std::runtime_error("Registry: snapshot byte order does not match");
+    const auto tick        = reader.Read<Tick>();
+    const auto free_entity = reader.Read<EntityIndex>();
+    size_t num_entities = 0;
+    const std::byte* entities = reader.BeginArray<Entity>(num_entities);
+
+    // Match the storages of the snapshot with the registered ones.
+    const auto num_storages = reader.Read<std::uint32_t>();
+    std::vector<ComponentId> ids;
+    std::vector<bool> matched(m_components.size(), false);
+    for (std::uint32_t i = 0; i < num_storages; ++i) {
+        const std::string name = reader.ReadString();
+        ComponentId id = 0;
+        while (id < m_components.size() && !(m_components[id] && name == m_storage_names[id])) ++id;
+        if (id == m_components.size() || matched[id]) throw std::runtime_error("Registry: snapshot storage " + name + " is not registered");
+        matched[id] = true;
+        ids.push_back(id);
+    }
+    for (ComponentId id = 0; id < m_components.size(); ++id) {
+        if (m_components[id] && !matched[id]) throw std::runtime_error("Registry: snapshot misses registered storage " + std::string(m_storage_names[id]));
+    }
+
+    m_entities.resize(num_entities);
+    if (num_entities > 0) std::memcpy(m_entities.data(), entities, num_entities * sizeof(Entity));
+    m_entity_ticks.assign(num_entities, tick);
+    // Tag storages set their bits while loading, the bits of all other storages are set once they are loaded.
+    m_signatures.assign(num_entities * m_signature_words, 0);
+    m_free_entity = free_entity;
+    m_tick        = tick;
+    m_archetypes.SetTick(tick);
+    for (ComponentId id : ids) {
+        m_components[id]->SetTick(tick);
+        m_components[id]->Load(reader);
+    }
+    // Ticks of the systems refer to the previous world, let them see everything as changed.
+    RebuildSignatures();
+    for (auto& system : m_systems) system.second.last_run = 0;
+    for (auto& buffer : m_command_buffers) buffer.Clear();
+    for (auto& query : m_queries) RebuildQuery(*query);
+    for (auto& group : m_groups) group->Rebuild();
+}
+
+Tick Registry::SaveDelta(std::ostream& out, Tick since)
+{
+    Tick tick = 0;
+    {
+        std::lock_guard<std::mutex> clock(m_component_mtx), elock(m_entity_mtx);
+        tick = m_tick;
+        SnapshotWriter writer(out);
+        writer.WriteBytes(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+        writer.Write(SNAPSHOT_VERSION);
+        writer.Write(SNAPSHOT_BYTE_ORDER);
+        // Ticks are small next to their 64 bits, varints keep near-empty deltas small.
+        writer.WriteVarint(since);
+        writer.WriteVarint(tick);
+        // Storages are referred to by their position in this table.
+        std::vector<ComponentId> ids;
+        for (ComponentId id = 0; id < m_components.size(); ++id) {
+            if (m_components[id]) ids.push_back(id);
+        }
+        writer.WriteVarint(ids.size());
+        for (ComponentId id : ids) writer.Write(NameHash(m_storage_names[id]));
+
+        // Changed slots in runs of consecutive indices. Alive entities carry a bitmask of the storages they are in.
+        writer.WriteVarint(m_entities.size());
+        writer.Write(m_free_entity);
+        std::vector<std::pair<EntityIndex, EntityIndex>> runs;
+        for (EntityIndex i = 0; i < m_entities.size(); ++i) {
+            if (m_entity_ticks[i] <= since) continue;
+            if (!runs.empty() && runs.back().second == i) ++runs.back().second;
+            else runs.emplace_back(i, i + 1);
+        }
+        std::vector<std::uint8_t> mask((ids.size() + 7) / 8);
+        writer.WriteVarint(runs.size());
+        for (const auto& run : runs) {
+            writer.WriteVarint(run.first);
+            writer.WriteVarint(run.second - run.first);
+            for (EntityIndex i = run.first; i < run.second; ++i) {
+                const Entity entity = m_entities[i];
+                writer.WriteVarint(GetEntityIndex(entity));
+                writer.WriteVarint(GetEntityVersion(entity));
+                if (GetEntityIndex(entity) != i) continue;
+                std::fill(mask.begin(), mask.end(), 0);
+                for (size_t k = 0; k < ids.size(); ++k) {
+                    if (m_components[ids[k]]->HasComponent(entity)) mask[k / 8] |= std::uint8_t(1u << (k % 8));
+                }
+                writer.WriteBytes(mask.data(), mask.size());
+            }
+        }
+
+        // Changed components of every storage, ordered by entity index so that the indices delta-encode well.
+        std::vector<std::pair<EntityIndex, size_t>> changed;
+        std::vector<std::byte> components, payload;
+        for (ComponentId id : ids) {
+            const ComponentStorageInterface& storage = *m_components[id];
+            const size_t size = storage.RawSize();
+            changed.clear();
+            components.clear();
+            storage.ForEachChanged(since, [&](Entity entity, const void* data) {
+                changed.emplace_back(GetEntityIndex(entity), components.size());
+                components.insert(components.end(), static_cast<const std::byte*>(data), static_cast<const std::byte*>(data) + size);
+            });
+            std::sort(changed.begin(), changed.end());
+            payload.resize(components.size());
+            writer.WriteVarint(changed.size());
+            EntityIndex previous = 0;
+            for (size_t j = 0; j < changed.size(); ++j) {
+                writer.WriteVarint(changed[j].first - previous);
+                previous = changed[j].first;
+                std::memcpy(payload.data() + j * size, components.data() + changed[j].second, size);
+            }
+            detail::WriteXorRle(writer, payload.data(), changed.size(), size);
+        }
+    }
+    // Everything changed from now on is newer than the returned tick.
+    AdvanceTick();
+    return tick;
+}
+
+void Registry::ApplyDelta(const void* data, size_t size)
+{
+    std::lock_guard<std::mutex> clock(m_component_mtx), elock(m_entity_mtx);
+    SnapshotReader reader(data, size);
+    if (std::memcmp(reader.ReadBytes(sizeof(DELTA_MAGIC)), DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0) {
+        throw std::runtime_error("Registry: not a delta");
+    }
+    if (reader.Read<std::uint32_t>() != SNAPSHOT_VERSION) throw std::runtime_error("Registry: unsupported delta version");
+    if (reader.Read<std::uint32_t>() != SNAPSHOT_BYTE_ORDER) throw std::runtime_error("Registry: delta byte order does not match");
+    reader.ReadVarint();
+    reader.ReadVarint();
+    std::vector<ComponentId> ids(static_cast<size_t>(reader.ReadVarint()));
+    for (ComponentId& id : ids) {
+        const auto hash = reader.Read<std::uint64_t>();
+        id = 0;
+        while (id < m_components.size() && !(m_components[id] && NameHash(m_storage_names[id]) == hash)) ++id;
+        if (id == m_components.size()) throw std::runtime_error("Registry: delta refers to an unregistered storage");
+    }
+
+    const auto num_slots = reader.ReadVarint();
+    if (num_slots < m_entities.size()) throw std::runtime_error("Registry: delta does not match the entity table of the replica");
+    const size_t old_size = m_entities.size();
+    m_entities.resize(static_cast<size_t>(num_slots), INVALID_ENTITY);
+    m_entity_ticks.resize(m_entities.size(), m_tick);
+    m_signatures.resize(m_entities.size() * m_signature_words, 0);
+    m_free_entity = reader.Read<EntityIndex>();
+
+    // Entities whose components are added, removed or set, the cached queries are updated for them at the end.
+    std::vector<Entity> touched;
+    const size_t mask_size = (ids.size() + 7) / 8;
+    const auto num_runs = reader.ReadVarint();
+    for (std::uint64_t run = 0; run < num_runs; ++run) {
+        const auto first = reader.ReadVarint();
+        const auto count = reader.ReadVarint();
+        if (first > m_entities.size() || count > m_entities.size() - first) throw std::runtime_error("Registry: malformed delta");
+        for (auto i = static_cast<EntityIndex>(first); i < first + count; ++i) {
+            const auto index   = static_cast<EntityIndex>(reader.ReadVarint());
+            const auto version = static_cast<EntityVersion>(reader.ReadVarint());
+            const Entity entity = MakeEntity(index, version);
+            // An entity replaced by another one, or a free slot, has been destroyed.
+            const Entity old = m_entities[i];
+            if (i < old_size && GetEntityIndex(old) == i && old != entity) {
+                m_archetypes.Destroy(old);
+                for (auto& query : m_queries) query->Erase(old);
+                for (auto& group : m_groups) group->Leave(old);
+                for (auto& storage : m_components) {
+                    if (storage && storage->HasComponent(old)) storage->RemoveComponent(old);
+                }
+                std::fill_n(Signature(i), m_signature_words, 0);
+            }
+            m_entities[i]     = entity;
+            m_entity_ticks[i] = m_tick;
+            if (index != i) continue;
+            const std::byte* mask = reader.ReadBytes(mask_size);
+            for (size_t k = 0; k < ids.size(); ++k) {
+                const bool has = (std::to_integer<unsigned>(mask[k / 8]) >> (k % 8)) & 1u;
+                if (has || !m_components[ids[k]]->HasComponent(entity)) continue;
+                LeaveGroups(&entity, 1, &ids[k], 1);
+                m_components[ids[k]]->RemoveComponent(entity);
+            }
+            touched.push_back(entity);
+        }
+    }
+
+    std::vector<std::byte> payload;
+    std::vector<Entity> entities;
+    for (ComponentId id : ids) {
+        ComponentStorageInterface& storage = *m_components[id];
+        const size_t component_size = storage.RawSize();
+        const auto count = reader.ReadVarint();
+        if (count > m_entities.size()) throw std::runtime_error("Registry: malformed delta");
+        entities.resize(static_cast<size_t>(count));
+        std::uint64_t index = 0;
+        for (Entity& entity : entities) {
+            index += reader.ReadVarint();
+            if (index >= m_entities.size() || GetEntityIndex(m_entities[index]) != index) throw std::runtime_error("Registry: delta refers to a dead entity");
+            entity = m_entities[index];
+        }
+        payload.resize(entities.size() * component_size);
+        detail::ReadXorRle(reader, payload.data(), entities.size(), component_size);
+        for (size_t j = 0; j < entities.size(); ++j) storage.SetRaw(entities[j], payload.data() + j * component_size);
+        touched.insert(touched.end(), entities.begin(), entities.end());
+    }
 
-    auto id = INVALID_ENTITY;
-    // Look for free entity in an existing array.
-    for (size_t i = 0; i < m_entities.size(); ++i) {
-        if (!m_entities[i]) {
-            id = static_cast<Entity>(i);
-            break;
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (Entity entity : touched) {
+        for (ComponentId id : ids) SetType(GetEntityIndex(entity), id, m_components[id]->HasComponent(entity));
+    }
+    for (auto& query : m_queries) {
+        for (Entity entity : touched) {
+            if (Matches(*query, entity)) query->Insert(entity);
+            else query->Erase(entity);
         }
     }
-    // If entity array is full, resize and add new entities.
-    if (id == INVALID_ENTITY) {
-        // Add the new entity at the old end position.
-        const auto prev_size = m_entities.size();
-        id = static_cast<Entity>(prev_size);
-        // Set added elements to false. I.e., these spots are free.
-        m_entities.resize(prev_size + ENTITY_SIZE_INCREMENT);
-        std::fill(m_entities.begin() + prev_size, m_entities.end(), false);
+    for (auto& group : m_groups) {
+        for (Entity entity : touched) group->Refresh(entity);
     }
-    // Mark entity as existing.
-    m_entities[id] = true;
-    return Registry::EntityBuilder(id, *this);
+}
+
+Registry::EntityBuilder Registry::CreateEntity()
+{
+    std::lock_guard<std::mutex> lock(m_entity_mtx);
+    Entity entity = INVALID_ENTITY;
+    AllocateEntities(&entity, 1);
+    return Registry::EntityBuilder(entity, *this);
+}
+
+void Registry::AllocateEntities(Entity* entities, size_t count)
+{
+    size_t i = 0;
+    // Reuse the most recently freed slots first. Their entries hold the next free index and the version to hand out.
+    for (; i < count && m_free_entity != INVALID_ENTITY_INDEX; ++i) {
+        const EntityIndex idx = m_free_entity;
+        m_free_entity   = GetEntityIndex(m_entities[idx]);
+        entities[i]     = MakeEntity(idx, GetEntityVersion(m_entities[idx]));
+        m_entities[idx] = entities[i];
+        m_entity_ticks[idx] = m_tick;
+    }
+    m_entities.reserve(m_entities.size() + (count - i));
+    m_entity_ticks.resize(m_entities.size() + (count - i), m_tick);
+    for (; i < count; ++i) {
+        entities[i] = MakeEntity(static_cast<EntityIndex>(m_entities.size()), 0);
+        m_entities.push_back(entities[i]);
+    }
+    m_signatures.resize(m_entities.size() * m_signature_words, 0);
 }
 
 void Registry::DestroyEntity(Entity entity)
+{
+    DestroyEntities(&entity, 1);
+}
+
+void Registry::DestroyEntities(const Entity* entities, size_t count)
 {
     std::lock_guard<std::mutex> clock(m_component_mtx), elock(m_entity_mtx);
-    for (auto& c : m_components) {
-        if (c.second->HasComponent(entity)) c.second->RemoveComponent(entity);
+    for (size_t i = 0; i < count; ++i) {
+        if (!IsAlive(entities[i])) throw std::runtime_error("Registry: the specified entity is not alive");
+    }
+    // A slot pushed onto the free list twice would be handed out twice.
+    if (count > 1) {
+        std::vector<Entity> sorted(entities, entities + count);
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.cbegin(), sorted.cend()) != sorted.cend()) throw std::runtime_error("Registry: an entity is specified more than once");
+    }
+    // Drop all archetype components of an entity at once instead of moving it once per component.
+    for (size_t i = 0; i < count; ++i) m_archetypes.Destroy(entities[i]);
+    for (auto& query : m_queries) {
+        for (size_t i = 0; i < count; ++i) query->Erase(entities[i]);
+    }
+    for (auto& group : m_groups) {
+        for (size_t i = 0; i < count; ++i) group->Leave(entities[i]);
+    }
+    for (auto& storage : m_components) {
+        if (!storage) continue;
+        for (size_t i = 0; i < count; ++i) {
+            if (storage->HasComponent(entities[i])) storage->RemoveComponent(entities[i]);
+        }
+    }
+    // Push the slots onto the free list and bump their versions so that existing handles become stale.
+    for (size_t i = 0; i < count; ++i) {
+        const EntityIndex idx = GetEntityIndex(entities[i]);
+        m_entities[idx]     = MakeEntity(m_free_entity, GetEntityVersion(entities[i]) + 1);
+        m_entity_ticks[idx] = m_tick;
+        m_free_entity       = idx;
+        std::fill_n(Signature(idx), m_signature_words, 0);
+    }
+}
+
+void Registry::ScheduleSystem(SystemInvocation& invocation)
+{
+    if (!invocation.access.declared) return;
+    // Visit the other systems in registration order, so the schedule does not depend on hashing.
+    std::vector<SystemInvocation*> others;
+    for (auto& system : m_systems) {
+        if (&system.second != &invocation) others.push_back(&system.second);
+    }
+    std::sort(others.begin(), others.end(), [](const SystemInvocation* a, const SystemInvocation* b) { return a->order < b->order; });
+
+    // Conflicting systems have to be ordered, so their edges go in before any edge between senders and receivers.
+    // All of them touch the system, so a cycle would lead back to it.
+    std::vector<std::pair<SystemInvocation*, SystemInvocation*>> edges;
+    for (SystemInvocation* other : others) {
+        const bool sends = invocation.access.SendsTo(other->access), receives = other->access.SendsTo(invocation.access);
+        if (!invocation.access.ConflictsWith(other->access) && !(sends && receives)) continue;
+        if (other->order < invocation.order) edges.emplace_back(other, &invocation);
+        else edges.emplace_back(&invocation, other);
+    }
+    for (const auto& edge : edges) edge.first->successors.push_back(edge.second);
+    if (IsOrderedAfter(invocation, invocation)) {
+        for (const auto& edge : edges) edge.first->successors.pop_back();
+        throw std::runtime_error("Registry: the access of the system conflicts with the order of its systems");
+    }
+    for (const auto& edge : edges) edge.first->task.precede(edge.second->task);
+
+    for (SystemInvocation* other : others) {
+        const bool sends = invocation.access.SendsTo(other->access), receives = other->access.SendsTo(invocation.access);
+        if (sends == receives) continue;
+        // Receivers must not run concurrently with senders. If the receiver already runs first, it reads the
+        // events in the next step instead.
+        auto& sender   = sends ? invocation : *other;
+        auto& receiver = sends ? *other : invocation;
+        if (!IsOrderedAfter(sender, receiver)) Order(sender, receiver);
+    }
+    for (EventId type : invocation.access.receives) m_events[type]->AddReceiver(&invocation.access);
+}
+
+void Registry::Order(SystemInvocation& before, SystemInvocation& after)
+{
+    before.task.precede(after.task);
+    before.successors.push_back(&after);
+}
+
+bool Registry::IsOrderedAfter(const SystemInvocation& after, const SystemInvocation& before)
+{
+    std::vector<const SystemInvocation*> pending(before.successors.cbegin(), before.successors.cend());
+    std::vector<const SystemInvocation*> visited;
+    while (!pending.empty()) {
+        const SystemInvocation* system = pending.back();
+        pending.pop_back();
+        if (system == &after) return true;
+        if (std::find(visited.cbegin(), visited.cend(), system) != visited.cend()) continue;
+        visited.push_back(system);
+        pending.insert(pending.end(), system->successors.cbegin(), system->successors.cend());
+    }
+    return false;
+}
+
+void Registry::CheckEvents(const SystemAccess& access) const
+{
+    for (const auto* types : { &access.sends, &access.receives }) {
+        for (EventId type : *types) {
+            if (type >= m_events.size() || !m_events[type]) throw std::runtime_error("Registry: the specified event type is not registered");
+        }
     }
-    m_entities[entity] = false;
 }
 
 } // namespace ecs
@@ -1,22 +1,63 @@
 #ifndef REGISTRY_H
 #define REGISTRY_H
 
+#include "ecs/archetype.h"
+#include "ecs/command_buffer.h"
 #include "ecs/common.h"
 #include "ecs/component.h"
 #include "ecs/entity.h"
+#include "ecs/event.h"
+#include "ecs/group.h"
+#include "ecs/memory.h"
+#include "ecs/profiler.h"
+#include "ecs/query.h"
+#include "ecs/soa.h"
 #include "ecs/system.h"
 
 #include <thirdparty/taskflow/taskflow/taskflow.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iosfwd>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <string>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <typeindex>
+#include <typeinfo>
 
 namespace ecs
 {
 
+namespace detail
+{
+
+// True if StorageT can add a component to many entities at once.
+template <typename StorageT, typename = void>
+struct HasBulkAdd : std::false_type {};
+template <typename StorageT>
+struct HasBulkAdd<StorageT, std::void_t<decltype(std::declval<StorageT&>().AddComponents(nullptr, 0, std::declval<const typename StorageT::ComponentType&>()))>> : std::true_type {};
+
+// Dense id of a storage type, identifying the storage class a component type was registered with.
+inline std::uint32_t NextStorageId()
+{
+    static std::atomic<std::uint32_t> next{ 0 };
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+template <typename StorageT>
+inline std::uint32_t StorageIdOf()
+{
+    static const std::uint32_t id = NextStorageId();
+    return id;
+}
+
+} // namespace detail
+
 // Provides primary ECS interface for the user.
 // Registry hosts all ECS data and provides an interface to all clients.
 class Registry {
@@ -30,10 +71,18 @@ private:
         EntityBuilder& operator=(EntityBuilder&) = delete;
 
         // Add component of a given type.
-        template <typename ComponentT>
+        template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
         EntityBuilder& AddComponent()
         {
-            m_registry.AddComponent<ComponentT>(m_entity);
+            m_registry.AddComponent<ComponentT, StorageT>(m_entity);
+            return *this;
+        }
+
+        // Add components of the given types. Archetype components are added with a single archetype move.
+        template <typename... ComponentTs>
+        EntityBuilder& AddComponents()
+        {
+            m_registry.AddComponents<ComponentTs...>(m_entity);
             return *this;
         }
 
@@ -51,6 +100,11 @@ private:
     };
 public:
     Registry()  = default;
+    // Run systems on num_workers worker threads instead of one per hardware thread.
+    explicit Registry(size_t num_workers) : m_executor(num_workers) {}
+    // Allocate entity tables, component storages and cached queries from a pool on top of upstream.
+    explicit Registry(std::pmr::memory_resource* upstream, size_t num_workers = std::thread::hardware_concurrency())
+        : m_storage_resource(upstream), m_executor(num_workers) {}
     ~Registry() = default;
 
     // Create an empty entity and returns a builder instance which can be used to add components.
@@ -58,43 +112,204 @@ public:
     EntityBuilder CreateEntity();
 
     // Destroys an entity along with its components.
+    // Throws std::runtime_error if the entity is not alive.
     void DestroyEntity(Entity entity);
 
+    // Create count entities, each with a copy of every value in values, and return them.
+    // Components are placed in the default storage of their types.
+    // Locks are taken once, storage capacity is reserved up front and components are appended contiguously.
+    // Throws std::runtime_error if a type is not registered or given more than once. No entities are left behind if
+    // adding the components throws. E.g., registry.CreateEntities(1000, Position{}, Velocity{ 0.f, 1.f, 0.f }).
+    template <typename... ComponentTs>
+    std::vector<Entity> CreateEntities(size_t count, const ComponentTs&... values);
+
+    // Destroy several distinct entities along with their components, taking locks once.
+    // Throws std::runtime_error without destroying anything if one of the entities is not alive or given twice.
+    void DestroyEntities(const Entity* entities, size_t count);
+    void DestroyEntities(const std::vector<Entity>& entities) { DestroyEntities(entities.data(), entities.size()); }
+
+    // True if entity was created by this registry and has not been destroyed since.
+    // Handles to destroyed entities stay invalid even if their index is reused by a new entity.
+    bool IsAlive(Entity entity) const
+    {
+        const EntityIndex idx = GetEntityIndex(entity);
+        return idx < m_entities.size() && m_entities[idx] == entity;
+    }
+
     // Register component type.
-    template <typename ComponentT, typename StorageT = PackedComponentStorage<ComponentT>>
+    // Views, queries, CreateEntities(), AddComponents() and commands access the storage as DefaultStorage<ComponentT>
+    // and throw std::runtime_error for types registered with another StorageT; select the storage through
+    // ComponentStorageTraits to use those.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
     void RegisterComponent();
 
     // Add a component to an entity.
-    // A type should be registered in the Registry, otherwise std::runtime_error is thrown.
+    // A type should be registered in the Registry and the entity alive, otherwise std::runtime_error is thrown.
+    // StorageT has to match the storage the component type was registered with.
+    // Returns what StorageT::AddComponent returns, i.e., ComponentT& or a proxy for SoAComponentStorage.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
+    decltype(auto) AddComponent(Entity entity);
+
+    // Add components of several types to an entity, using the default storage of every type.
+    // All components placed in archetypes are added with a single archetype move.
+    template <typename... ComponentTs>
+    void AddComponents(Entity entity);
+
+    // Remove a component from an entity.
+    // A type should be registered in the Registry and an entity should have ComponentT component, otherwise std::runtime_error is thrown.
     template <typename ComponentT>
-    ComponentT& AddComponent(Entity entity);
+    void RemoveComponent(Entity entity) { RemoveComponents<ComponentT>(entity); }
+
+    // Remove components of several types from an entity.
+    // All components placed in archetypes are removed with a single archetype move.
+    template <typename... ComponentTs>
+    void RemoveComponents(Entity entity);
 
     // Get a reference to a component for an entity. A type should be registered in the Registry and
     // an entity should have ComponentT component, otherwise std::runtime_error is thrown.
-    template <typename ComponentT>
-    ComponentT& GetComponent(Entity entity) { return GetComponentStorage<ComponentT>().GetComponent(entity); }
+    // Returns ComponentT& or, for SoAComponentStorage, a proxy.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
+    decltype(auto) GetComponent(Entity entity) { return GetComponentStorage<ComponentT, StorageT>().GetComponent(entity); }
 
     // Check if an entity has a component of a given type.
     // A type must be registered in the Registry, otherwise std::runtime_error is thrown.
     template <typename ComponentT>
-    bool HasComponent(Entity entity) {  return GetComponentStorage<ComponentT>().HasComponent(entity); }
+    bool HasComponent(Entity entity) {  return GetComponentStorage<ComponentT, ComponentStorageInterface>().HasComponent(entity); }
+
+    // Create a persistent query over all entities having every component in ComponentTs, which is kept up to date
+    // incrementally. The query is owned by the registry and lives until Reset(). Exclusions can be added with
+    // CachedQuery::Exclude(), e.g., registry.CreateQuery<Position, Velocity>().Exclude<Dead>().
+    // Component types have to be registered, otherwise std::runtime_error is thrown.
+    template <typename... ComponentTs>
+    CachedQuery& CreateQuery();
+
+    // Create an owning group over ComponentTs, which keeps the entities having all of them packed at the front of
+    // every owned storage in identical order, see Group. The group is owned by the registry and lives until Reset().
+    // Throws std::runtime_error if a type is not registered or its storage is already owned by another group.
+    template <typename... ComponentTs>
+    Group<ComponentTs...>& CreateGroup();
+
+    // Reorder the components of ComponentT in place by compare(const ComponentT&, const ComponentT&).
+    // Throws std::runtime_error if the type is not registered or its storage is owned by a group.
+    template <typename ComponentT, typename CompareT>
+    void SortComponents(CompareT compare);
+    // Reorder the components of ComponentT in place so that entities having OtherT come first, in the order of the
+    // OtherT storage. Afterwards, looking up ComponentT while iterating OtherT accesses memory sequentially.
+    template <typename ComponentT, typename OtherT>
+    void SortComponentsAs();
+
+    // Attach an entity as the last child of parent within the HierarchyStorage of ComponentT, or make it a root if
+    // parent is INVALID_ENTITY. Throws std::runtime_error if either has no ComponentT or the parent is a descendant.
+    template <typename ComponentT>
+    void SetParent(Entity entity, Entity parent)
+    {
+        std::lock_guard<std::mutex> lock(m_component_mtx);
+        GetComponentStorage<ComponentT>().SetParent(entity, parent);
+    }
+    // Get the parent of an entity within the HierarchyStorage of ComponentT, INVALID_ENTITY for roots.
+    template <typename ComponentT>
+    Entity GetParent(Entity entity) { return GetComponentStorage<ComponentT>().GetParent(entity); }
+
+    // Register an event type, creating the channel systems exchange events of EventT through, see EventChannel.
+    // Systems sending or receiving EventT, declared by their Sends and Receives member aliases, can only be
+    // registered afterwards. Throws std::runtime_error if the type is already registered.
+    template <typename EventT>
+    void RegisterEvent();
+    // Send an event from outside of systems, which they receive during the next step. Must not be used by several
+    // threads concurrently, nor while steps are running, e.g., after RunAsync(), as receivers may be reading.
+    // Throws std::runtime_error if the type is not registered.
+    template <typename EventT>
+    void SendEvent(EventT event) { GetEventChannel<EventT>().Send(GetWorkerSlot(), std::move(event)); }
+    // Call f(const EventT& event) for every event sent during the last step, including those sent before it from
+    // outside of systems. Must not be called while systems are running.
+    template <typename EventT, typename F>
+    void ForEachEvent(F&& f);
+    // Get the number of events of EventT sent during the last step.
+    template <typename EventT>
+    size_t GetNumEvents() { return GetEventChannel<EventT>().NumPrevious(); }
 
     // Get total number of components of a given ComponentT.
     // A type should be registered in the Registry and otherwise std::runtime_error is being thrown.
     template <typename ComponentT>
-    size_t GetNumComponents() { return GetComponentStorage<ComponentT>().Size(); }
+    size_t GetNumComponents() { return GetComponentStorage<ComponentT, ComponentStorageInterface>().Size(); }
 
     // Run one step of an execution.
     // During one step of an execution each registered system is called exactly
     // once respecting, the execution order constratints specified by the user.
+    // Commands recorded by the systems are played back once all of them finished.
     void Run();
+    // Run num_steps steps within a single submission to the executor, without a submit and join per step.
+    void RunFor(size_t num_steps);
+    // Run steps until pred returns true. pred is called before every step, including the first one.
+    template <typename PredicateT>
+    void RunUntil(PredicateT&& pred);
+    // Start running num_steps steps in the background and return immediately. Commands are played back between
+    // steps on an executor thread. The registry must not be used by any other thread until the future is ready.
+    std::future<void> RunAsync(size_t num_steps = 1);
+    // Start running steps in the background until pred returns true, see RunUntil() and RunAsync().
+    // Without systems, the steps run on a thread of their own, whose future blocks in its destructor until they end.
+    template <typename PredicateT>
+    std::future<void> RunAsyncUntil(PredicateT&& pred);
+
+    // Get the frame arena of the calling thread, a linear allocator that is reset at the beginning of every Run() step.
+    // Worker threads each have their own arena, all other threads share a single one.
+    // E.g., std::pmr::vector<Entity> scratch(&registry.FrameResource()).
+    std::pmr::memory_resource& FrameResource();
+
+    // Get the pool component storages and entity tables allocate from. Storages constructible from a
+    // std::pmr::memory_resource* are handed this resource on registration.
+    std::pmr::memory_resource* GetStorageResource() { return &m_storage_resource; }
+
+    // Get the timings of recent Run() steps and their systems. Stays empty unless built with ECS_PROFILING.
+    // Must not be inspected while Run() is in progress.
+    const Profiler& GetProfiler() const { return m_profiler; }
+
+    // Get the command buffer of the calling thread. Worker threads of the registry each have their own buffer,
+    // all other threads share a single one, i.e., it must not be used by several of them concurrently.
+    CommandBuffer& Commands();
+
+    // Play back and clear the commands recorded in all command buffers.
+    // Entities are created first, then components are added and removed storage by storage and
+    // finally entities are destroyed in bulk. Must not be called while systems are running.
+    // Throws std::runtime_error, dropping all commands, if a command refers to a placeholder no buffer handed out or
+    // to a component type that is not registered with its default storage. Both are checked before anything is
+    // applied. Should applying a command throw anyway, the commands applied so far are kept and all others dropped.
+    void FlushCommands();
 
     // Wipe out all the component and systems. 
     // Registry to its initial state as if nothing has been registered and executed.
     void Reset();
 
+    // Write the entity table, including free slots, and the components of every registered storage to a versioned
+    // binary snapshot. Throws std::runtime_error if a storage does not support snapshots, e.g., archetype storages,
+    // or holds components that are not trivially copyable. Must not be called while systems are running.
+    void SaveSnapshot(std::ostream& out);
+    void SaveSnapshot(const std::string& path);
+    // Replace all entities and components with those of a snapshot. Every component type has to be registered with
+    // the same storage as when the snapshot was saved. The file is memory-mapped and every array is restored with a
+    // single memcpy. Cached queries are rebuilt, pending commands are dropped and all components count as changed.
+    // Throws std::runtime_error on mismatching or malformed snapshots; the registry then has to be Reset().
+    void LoadSnapshot(const std::string& path);
+    void LoadSnapshot(const void* data, size_t size);
+
+    // Write all changes made after tick since as a compact delta: entity slots that were created, destroyed or
+    // structurally changed together with the component types their entities have, and all components added or
+    // changed, XOR-encoded against their predecessor with runs of zero bytes collapsed. Components are exchanged as
+    // raw bytes, so the restrictions of SaveSnapshot() apply. Returns the tick to pass as since for the next delta.
+    // SaveDelta(out, 0) captures the whole registry, e.g., to initialize a replica.
+    // Structural changes made directly on storages obtained from ComponentAccess::Write() are not seen.
+    Tick SaveDelta(std::ostream& out, Tick since);
+    // Apply a delta to a replica that registered the same component types with the same storages and matches the
+    // source registry as of the since tick of the delta. Entities and components of the replica must not be changed
+    // by other means in between. Throws std::runtime_error on mismatching or malformed deltas.
+    void ApplyDelta(const void* data, size_t size);
+
     // Register a system.
     // It is not possible to have two systems of the same type in Registry as they are indexed by their type.
+    // If the system declares Reads/Writes, it is ordered after all previously registered systems it conflicts with.
+    // If it declares Sends/Receives, it runs before all receivers of the event types it sends and after all senders
+    // of the types it receives, unless that contradicts the order of the systems so far. Receivers then read those
+    // events in the next step. Throws std::runtime_error if one of the event types is not registered.
     template <typename SystemT, typename... Args>
     void RegisterSystem(Args&&... args);
 
@@ -105,27 +320,148 @@ public:
     // Make one system SystemT0 run before another system SystemT1.
     // By default, systems can execute in arbitrary orders -- or even in parallel!
     // Precede() sets an order of the system execution.
+    // Throws std::runtime_error if SystemT1 already runs before SystemT0, which would form a cycle.
     template <typename SystemT0, typename SystemT1>
     void Precede();
 
+    // Declare the component types a registered system reads and writes, as an alternative to the Reads and Writes
+    // member aliases of System. Systems with conflicting declarations are run in registration order, all others
+    // may run in parallel. Throws std::runtime_error if the system is not found, already declared its access or
+    // already runs in the opposite order of a system it conflicts with, e.g., through Precede().
+    // E.g., registry.DeclareAccess<Movement>(Components<Velocity>{}, Components<Position>{}).
+    template <typename SystemT, typename... ReadTs, typename... WriteTs>
+    void DeclareAccess(Components<ReadTs...> reads, Components<WriteTs...> writes);
+
 private:
     // Get reference to a component storage of a specified type.
-    // If type is not registered, throws std::runtime_error.
-    template <typename ComponentT, typename StorageT = PackedComponentStorage<ComponentT>>
+    // If type is not registered or registered with a storage other than StorageT, throws std::runtime_error.
+    // Any storage can be accessed as ComponentStorageInterface.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
     StorageT& GetComponentStorage();
+    // Get the channel of an event type. If the type is not registered, throws std::runtime_error.
+    template <typename EventT>
+    EventChannel<EventT>& GetEventChannel();
+    // Index of the command buffer, frame arena and event segment of the calling thread.
+    size_t GetWorkerSlot();
+
+    // Helper to pass component types as values.
+    template <typename T>
+    struct TypeTag { using Type = T; };
 
     // Data associated with a system.
     struct SystemInvocation {
         tf::Task                task;
         std::unique_ptr<System> system;
+        // Registration index, conflicting systems run in this order.
+        size_t                  order = 0;
+        SystemAccess            access;
+        // Tick of the previous run, 0 if the system never ran.
+        Tick                    last_run = 0;
+        // Readable type name of the system, shown by the profiler.
+        std::string             name;
+        // Systems ordered directly after this one.
+        std::vector<const SystemInvocation*> successors;
     };
 
-    // Entity array: true if entity exists
-    std::mutex        m_entity_mtx;
-    std::vector<bool> m_entities;
+    // Re-evaluate the cached queries depending on any of the given component types for several entities.
+    // Expects m_component_mtx to be held.
+    void UpdateQueries(const Entity* entities, size_t num_entities, const ComponentId* types, size_t count);
+    // Stamp the entities' slots as changed for deltas and update the cached queries and groups.
+    // Expects m_component_mtx to be held and all entities to be alive, i.e., to have a slot.
+    void OnStructuralChange(const Entity* entities, size_t num_entities, const ComponentId* types, size_t count);
+    // Move entities out of the groups owning any of the given component types, ahead of removing those components.
+    // Expects m_component_mtx to be held.
+    void LeaveGroups(const Entity* entities, size_t num_entities, const ComponentId* types, size_t count);
+    // Throw std::runtime_error if the storage of a component type is owned by a group.
+    void CheckNotGrouped(ComponentId type) const;
+    // Throw std::runtime_error if an entity is not alive, e.g., a stale handle to a reused slot.
+    void CheckAlive(Entity entity);
+    // Throw std::runtime_error if a component type is given more than once.
+    static void CheckDistinct(const ComponentId* types, size_t count);
+
+    // Component signature of an entity slot: bit t of word t / 64 is set if the entity has a component of type t.
+    const std::uint64_t* Signature(EntityIndex idx) const { return m_signatures.data() + size_t(idx) * m_signature_words; }
+    std::uint64_t*       Signature(EntityIndex idx)       { return m_signatures.data() + size_t(idx) * m_signature_words; }
+    bool HasType(EntityIndex idx, ComponentId type) const
+    {
+        return idx < m_entities.size() && (Signature(idx)[type / 64] >> (type % 64)) & 1u;
+    }
+    void SetType(EntityIndex idx, ComponentId type, bool has)
+    {
+        const std::uint64_t bit = std::uint64_t(1) << (type % 64);
+        Signature(idx)[type / 64] = has ? Signature(idx)[type / 64] | bit : Signature(idx)[type / 64] & ~bit;
+    }
+    // Widen the signatures to cover all registered component types. Expects m_entity_mtx to be held.
+    void ResizeSignatures();
+    // Recompute the signatures of all entities from the storages, keeping tags. Expects both mutexes to be held.
+    void RebuildSignatures();
+    // Append all alive entities having every type in include and none in exclude to entities.
+    // Throws std::runtime_error if a type is not registered.
+    void MatchSignatures(const ComponentId* include, size_t num_include, const ComponentId* exclude, size_t num_exclude,
+                         std::pmr::vector<Entity>& entities) const;
+    // True if an entity matches a cached query. Expects m_component_mtx to be held.
+    bool Matches(const CachedQuery& query, Entity entity) const;
+    // Rebuild the entities of a cached query from scratch. Expects m_component_mtx to be held.
+    void RebuildQuery(CachedQuery& query);
+
+    // Advance the tick and stamp it on all storages. Must not be called while systems are running.
+    void AdvanceTick();
+    // Prepare a Run() step before its systems start, and finish it once all of them completed.
+    void BeginStep();
+    void EndStep();
+
+    // Create count command buffers, each knowing its index.
+    static std::vector<CommandBuffer> MakeCommandBuffers(size_t count);
+    // Resolve a placeholder of any command buffer to the entity created for it on playback.
+    // Throws std::runtime_error for placeholders no buffer has handed out.
+    Entity ResolvePlaceholder(Entity entity) const;
+
+    // Allocate count entities. Expects m_entity_mtx to be held.
+    void AllocateEntities(Entity* entities, size_t count);
+
+    // Order a system after all previously registered systems it conflicts with
+    // and before all later registered systems that conflict with it.
+    // Senders of an event type are ordered before its receivers, unless a receiver already runs before the sender.
+    // Throws std::runtime_error, leaving the order untouched, if conflicting systems are already ordered the other
+    // way round, e.g., through Precede().
+    void ScheduleSystem(SystemInvocation& invocation);
+    // Make one system run before another one.
+    static void Order(SystemInvocation& before, SystemInvocation& after);
+    // True if a system is ordered after another one, directly or indirectly.
+    static bool IsOrderedAfter(const SystemInvocation& after, const SystemInvocation& before);
+    // Throw std::runtime_error if a declared access mentions an event type that is not registered.
+    void CheckEvents(const SystemAccess& access) const;
+
+    // Long-lived allocations of the registry. Declared first, so it outlives everything allocating from it.
+    std::pmr::synchronized_pool_resource m_storage_resource;
+    // Entity table: alive slots hold their entity, free slots form an implicit free list,
+    // holding the index of the next free slot together with the version the slot is reused with.
+    std::mutex          m_entity_mtx;
+    std::pmr::vector<Entity> m_entities{ &m_storage_resource };
+    // Tick of the last creation, destruction or structural change of every slot, read by SaveDelta()
+    std::pmr::vector<Tick>   m_entity_ticks{ &m_storage_resource };
+    // Component signatures of all slots, m_signature_words words each, zero for free slots
+    std::pmr::vector<std::uint64_t> m_signatures{ &m_storage_resource };
+    size_t                          m_signature_words = 1;
+    EntityIndex              m_free_entity = INVALID_ENTITY_INDEX;
     // Component arrays
     std::mutex    m_component_mtx;
-    std::unordered_map<std::type_index, std::unique_ptr<ComponentStorageInterface>> m_components;
+    // Storages indexed by component id, null for unregistered types.
+    std::vector<std::unique_ptr<ComponentStorageInterface>> m_components;
+    // Name of the storage type of every registered component, identifying storages within snapshots.
+    std::vector<const char*> m_storage_names;
+    // Storage type id of every registered component, checked whenever a storage is accessed as its concrete type.
+    std::vector<std::uint32_t> m_storage_ids;
+    // Cached queries and, indexed by component id, the queries requiring or excluding that type
+    std::vector<std::unique_ptr<CachedQuery>> m_queries;
+    std::vector<std::vector<CachedQuery*>>    m_component_queries;
+    // Owning groups and, indexed by component id, the group owning that type, if any
+    std::vector<std::unique_ptr<GroupInterface>> m_groups;
+    std::vector<GroupInterface*>                 m_component_groups;
+    // Chunks of all components registered with an ArchetypeComponentStorage
+    ArchetypeWorld m_archetypes;
+    // Current change tick, advanced for every system run and after every Run() step
+    std::atomic<Tick> m_tick{ 1 };
     // Systems
     std::mutex m_system_mtx;
     std::unordered_map<std::type_index, SystemInvocation> m_systems;
@@ -133,49 +469,465 @@ private:
     tf::Taskflow m_taskflow;
     tf::Executor m_executor;
 
+    // One command buffer per worker and a shared one for all other threads
+    std::vector<CommandBuffer> m_command_buffers = MakeCommandBuffers(m_executor.num_workers() + 1);
+    // One frame arena per worker and a shared one for all other threads
+    std::vector<LinearArena> m_frame_arenas = std::vector<LinearArena>(m_executor.num_workers() + 1);
+    // Commands gathered from all buffers during playback
+    std::vector<CommandBuffer::Command*> m_pending_commands;
+    // Per-system and per-frame timings, recorded only if built with ECS_PROFILING
+    Profiler m_profiler{ m_executor.num_workers() };
+    // Event channels indexed by event id, null for unregistered types
+    std::vector<std::unique_ptr<EventChannelInterface>> m_events;
+
     friend class EntityQuery;
     friend class ComponentAccess;
+    friend class CommandBuffer;
+    friend class CachedQuery;
+    template <typename T>
+    friend class TagStorage;
 };
 
 // An interface providing access to components for System subclasses, guarding the Registry from unattended access.
 class ComponentAccess {
 public:
     // Request component storage for write access.
-    template <typename ComponentT, typename StorageT = PackedComponentStorage<ComponentT>>
-    StorageT& Write() { return m_registry.GetComponentStorage<ComponentT>(); }
+    // Throws std::runtime_error if the system declared its access without writing ComponentT.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
+    StorageT& Write()
+    {
+        if (m_access && !m_access->CanWrite(GetComponentId<ComponentT>())) throw std::runtime_error("ComponentAccess: the component type is not declared as written by the system");
+        return m_registry.GetComponentStorage<ComponentT, StorageT>();
+    }
     // Request component storage for read access.
-    template <typename ComponentT, typename StorageT = PackedComponentStorage<ComponentT>>
-    const StorageT& Read() const { return m_registry.GetComponentStorage<ComponentT>(); }
+    // Throws std::runtime_error if the system declared its access without reading or writing ComponentT.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
+    const StorageT& Read() const
+    {
+        if (m_access && !m_access->CanRead(GetComponentId<ComponentT>())) throw std::runtime_error("ComponentAccess: the component type is not declared as read by the system");
+        return m_registry.GetComponentStorage<ComponentT, StorageT>();
+    }
+    // Request a component of an entity for write access and stamp it as changed by the system.
+    // Throws std::runtime_error if the system declared its access without writing ComponentT or the entity has no ComponentT.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
+    decltype(auto) Write(Entity entity)
+    {
+        auto& storage = Write<ComponentT, StorageT>();
+        storage.MarkChanged(entity, m_tick);
+        return storage.GetComponent(entity);
+    }
+    // Request a column of a component kept in a SoAComponentStorage, e.g., WriteColumn<&Position::x>().
+    // Access is checked like Write<ComponentT>(), respectively Read<ComponentT>(). Writes through a column are not
+    // stamped as changes, use MarkChanged() for that.
+    template <auto Member>
+    auto WriteColumn()
+    {
+        using ComponentT = typename detail::MemberTraits<decltype(Member)>::Class;
+        return Write<ComponentT, SoAComponentStorage<ComponentT>>().template Column<Member>();
+    }
+    template <auto Member>
+    auto ReadColumn() const
+    {
+        using ComponentT = typename detail::MemberTraits<decltype(Member)>::Class;
+        return Read<ComponentT, SoAComponentStorage<ComponentT>>().template Column<Member>();
+    }
+    // Stamp a component of an entity as changed by the system, e.g., after writing it through a view.
+    template <typename ComponentT, typename StorageT = DefaultStorage<ComponentT>>
+    void MarkChanged(Entity entity) { Write<ComponentT, StorageT>().MarkChanged(entity, m_tick); }
+    // Tick the changes of the system are stamped with.
+    Tick GetTick() const { return m_tick; }
+    // Get the command buffer of the worker running the system, used to defer structural changes.
+    CommandBuffer& Commands() { return m_registry.Commands(); }
+    // Get the frame arena of the worker running the system for scratch memory valid until the end of the Run() step.
+    std::pmr::memory_resource& FrameResource() { return m_registry.FrameResource(); }
+    // Send an event from the system or one of its subflow tasks, appended to the segment of the calling worker.
+    // Throws std::runtime_error unless the system declared to send EventT.
+    template <typename EventT>
+    void Send(EventT event)
+    {
+        if (m_access && !m_access->CanSend(GetEventId<EventT>())) throw std::runtime_error("ComponentAccess: the event type is not declared as sent by the system");
+        m_registry.GetEventChannel<EventT>().Send(m_registry.GetWorkerSlot(), std::move(event));
+    }
+    // Get the events of EventT the system has not read yet.
+    // Throws std::runtime_error unless the system declared to receive EventT.
+    template <typename EventT>
+    EventReader<EventT> Receive()
+    {
+        if (!m_access || !m_access->CanReceive(GetEventId<EventT>())) throw std::runtime_error("ComponentAccess: the event type is not declared as received by the system");
+        return EventReader<EventT>(m_registry.GetEventChannel<EventT>(), m_access);
+    }
+    // Request the archetype chunks for iterating over several archetype components at once.
+    // Accesses through the archetypes are not checked against the declared access of the system.
+    ArchetypeWorld& Archetypes() { return m_registry.m_archetypes; }
 private:
     // Only registry can create these objects.
-    explicit ComponentAccess(Registry& registry) noexcept : m_registry(registry) {}
+    explicit ComponentAccess(Registry& registry, const SystemAccess* access = nullptr, Tick tick = 0) noexcept
+        : m_registry(registry), m_access(access), m_tick(tick) {}
     Registry& m_registry;
+    // Declared access of the system using this object, if any.
+    const SystemAccess* m_access;
+    Tick m_tick;
     friend class Registry;
 };
 
+template <typename... ComponentTs, typename... FilterTs>
+inline ComponentView<MakeViewFilter<FilterTs...>, ComponentTs...> EntityQuery::View(FilterTs...) const
+{
+    return MakeView<ComponentTs...>(MakeViewFilter<FilterTs...>{});
+}
+
+template <typename... ComponentTs, typename... ExcludeTs, typename... ChangedTs, typename... AddedTs>
+inline ComponentView<ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>, ComponentTs...>
+EntityQuery::MakeView(ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>) const
+{
+    if (m_access) {
+        const bool allowed = (... && (std::is_const_v<ComponentTs> ? m_access->CanRead(GetComponentId<ComponentTs>())
+                                                                   : m_access->CanWrite(GetComponentId<ComponentTs>()))) &&
+                             (true && ... && m_access->CanRead(GetComponentId<ExcludeTs>())) &&
+                             (true && ... && m_access->CanRead(GetComponentId<ChangedTs>())) &&
+                             (true && ... && m_access->CanRead(GetComponentId<AddedTs>()));
+        if (!allowed) throw std::runtime_error("EntityQuery: the view accesses component types not declared by the system");
+    }
+    return ComponentView<ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>, ComponentTs...>(
+        { &m_registry.GetComponentStorage<std::remove_const_t<ComponentTs>>()... },
+        { &m_registry.GetComponentStorage<ExcludeTs>()... },
+        { &m_registry.GetComponentStorage<ChangedTs>()... },
+        { &m_registry.GetComponentStorage<AddedTs>()... },
+        m_since);
+}
+
+template <typename... ComponentTs, typename... ExcludeTs>
+inline EntityManager EntityQuery::Match(Without<ExcludeTs...>) const
+{
+    static_assert(sizeof...(ComponentTs) > 0, "EntityQuery: at least one component type has to be given");
+    if (m_access) {
+        const bool allowed = (... && m_access->CanRead(GetComponentId<ComponentTs>())) && (true && ... && m_access->CanRead(GetComponentId<ExcludeTs>()));
+        if (!allowed) throw std::runtime_error("EntityQuery: the match accesses component types not declared by the system");
+    }
+    const ComponentId include[] = { GetComponentId<ComponentTs>()... };
+    const ComponentId exclude[] = { GetComponentId<ExcludeTs>()..., INVALID_COMPONENT_ID };
+    std::pmr::vector<Entity> entities(m_resource ? m_resource : &m_registry.FrameResource());
+    m_registry.MatchSignatures(include, sizeof...(ComponentTs), exclude, sizeof...(ExcludeTs), entities);
+    m_num_queried += entities.size();
+    return EntityManager(std::move(entities));
+}
+
 template <typename ComponentT, typename StorageT>
 inline StorageT& Registry::GetComponentStorage()
 {
-    const auto tidx = TypeIndex<ComponentT>();
-    assert(m_components.find(tidx) != m_components.cend());
-    auto storage = static_cast<StorageT*>(m_components[tidx].get());
-    return *storage;
+    const ComponentId id = GetComponentId<ComponentT>();
+    if (id >= m_components.size() || !m_components[id]) throw std::runtime_error("Registry: the specified component type is not registered");
+    if constexpr (!std::is_same_v<StorageT, ComponentStorageInterface>) {
+        if (m_storage_ids[id] != detail::StorageIdOf<StorageT>()) throw std::runtime_error("Registry: the component type is registered with another storage");
+    }
+    return *static_cast<StorageT*>(m_components[id].get());
+}
+
+template <typename EventT>
+inline EventChannel<EventT>& Registry::GetEventChannel()
+{
+    const EventId id = GetEventId<EventT>();
+    if (id >= m_events.size() || !m_events[id]) throw std::runtime_error("Registry: the specified event type is not registered");
+    return *static_cast<EventChannel<EventT>*>(m_events[id].get());
+}
+
+template <typename EventT>
+inline void Registry::RegisterEvent()
+{
+    std::lock_guard<std::mutex> lock(m_system_mtx);
+    const EventId id = GetEventId<EventT>();
+    if (id < m_events.size() && m_events[id]) throw std::runtime_error("Registry: the specified event type is already registered");
+    if (id >= m_events.size()) m_events.resize(size_t(id) + 1);
+    m_events[id] = std::make_unique<EventChannel<EventT>>(m_executor.num_workers() + 1);
+}
+
+template <typename EventT, typename F>
+inline void Registry::ForEachEvent(F&& f)
+{
+    GetEventChannel<EventT>().ForEachPrevious([&f](const EventT* events, size_t count) {
+        for (size_t i = 0; i < count; ++i) f(events[i]);
+    });
 }
 
 template <typename ComponentT, typename StorageT>
 inline void Registry::RegisterComponent()
 {
     std::lock_guard<std::mutex> lock(m_component_mtx);
-    const auto tidx = TypeIndex<ComponentT>();
-    if (m_components.find(tidx) != m_components.cend()) throw std::runtime_error("Registry: the specified component type is already registered.");
-    m_components.emplace(tidx, std::move(std::make_unique<StorageT>()));
+    const ComponentId id = GetComponentId<ComponentT>();
+    if (id < m_components.size() && m_components[id]) throw std::runtime_error("Registry: the specified component type is already registered.");
+    if (id >= m_components.size()) {
+        m_components.resize(size_t(id) + 1);
+        m_storage_names.resize(size_t(id) + 1, nullptr);
+        m_storage_ids.resize(size_t(id) + 1, 0);
+    }
+    m_storage_names[id] = typeid(StorageT).name();
+    m_storage_ids[id]   = detail::StorageIdOf<StorageT>();
+    {
+        std::lock_guard<std::mutex> elock(m_entity_mtx);
+        ResizeSignatures();
+    }
+    if constexpr (std::is_constructible_v<StorageT, ArchetypeWorld&>) m_components[id] = std::make_unique<StorageT>(m_archetypes);
+    else if constexpr (std::is_constructible_v<StorageT, Registry&>) m_components[id] = std::make_unique<StorageT>(*this);
+    else if constexpr (std::is_constructible_v<StorageT, std::pmr::memory_resource*>) m_components[id] = std::make_unique<StorageT>(&m_storage_resource);
+    else m_components[id] = std::make_unique<StorageT>();
+    m_components[id]->SetTick(m_tick);
+    m_archetypes.SetTick(m_tick);
+}
+
+template <typename ComponentT, typename StorageT>
+inline decltype(auto) Registry::AddComponent(Entity entity)
+{
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    CheckAlive(entity);
+    auto& storage = GetComponentStorage<ComponentT, StorageT>();
+    decltype(auto) component = storage.AddComponent(entity);
+    const ComponentId type = GetComponentId<ComponentT>();
+    OnStructuralChange(&entity, 1, &type, 1);
+    // Joining a group moves the new component to the end of the group.
+    if (type < m_component_groups.size() && m_component_groups[type]) return storage.GetComponent(entity);
+    return component;
+}
+
+template <typename... ComponentTs>
+inline void Registry::AddComponents(Entity entity)
+{
+    static_assert(sizeof...(ComponentTs) > 0, "Registry: at least one component type has to be given");
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    CheckAlive(entity);
+    const ComponentId types[] = { GetComponentId<ComponentTs>()... };
+    // Check every type up front, so that nothing is changed if one of them cannot be added.
+    CheckDistinct(types, sizeof...(ComponentTs));
+    if ((... || GetComponentStorage<ComponentTs>().HasComponent(entity))) throw std::runtime_error("Registry: the entity already has one of the specified components");
+    // Gather archetype components to move the entity only once.
+    const ComponentInfo* archetype_components[sizeof...(ComponentTs)];
+    size_t num_archetype_components = 0;
+    auto add = [&](auto tag) {
+        using ComponentT = typename decltype(tag)::Type;
+        auto& storage = GetComponentStorage<ComponentT>();
+        if constexpr (IsArchetypeStorage<DefaultStorage<ComponentT>>::value) archetype_components[num_archetype_components++] = &GetComponentInfo<ComponentT>();
+        else storage.AddComponent(entity);
+    };
+    (add(TypeTag<ComponentTs>{}), ...);
+    if (num_archetype_components > 0) m_archetypes.Add(entity, archetype_components, num_archetype_components);
+    OnStructuralChange(&entity, 1, types, sizeof...(ComponentTs));
+}
+
+template <typename... ComponentTs>
+inline std::vector<Entity> Registry::CreateEntities(size_t count, const ComponentTs&... values)
+{
+    std::vector<Entity> entities(count);
+    if constexpr (sizeof...(ComponentTs) > 0) {
+        // Check the types and look up the storages first, so that no entities are created if one of them is missing.
+        const ComponentId types[] = { GetComponentId<ComponentTs>()... };
+        CheckDistinct(types, sizeof...(ComponentTs));
+        (void(GetComponentStorage<ComponentTs>()), ...);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_entity_mtx);
+        AllocateEntities(entities.data(), count);
+    }
+    if constexpr (sizeof...(ComponentTs) > 0) {
+        try {
+            std::lock_guard<std::mutex> lock(m_component_mtx);
+            // Archetype components of all entities are added together, one move per entity.
+            const ComponentInfo* archetype_components[sizeof...(ComponentTs)];
+            size_t num_archetype_components = 0;
+            auto add = [&](const auto& value) {
+                using ComponentT = std::decay_t<decltype(value)>;
+                auto& storage = GetComponentStorage<ComponentT>();
+                if constexpr (IsArchetypeStorage<DefaultStorage<ComponentT>>::value) archetype_components[num_archetype_components++] = &GetComponentInfo<ComponentT>();
+                else if constexpr (detail::HasBulkAdd<DefaultStorage<ComponentT>>::value) storage.AddComponents(entities.data(), count, value);
+                else for (Entity entity : entities) storage.AddComponent(entity) = value;
+            };
+            (add(values), ...);
+            if (num_archetype_components > 0) {
+                m_archetypes.Add(entities.data(), count, archetype_components, num_archetype_components);
+                auto assign = [&](const auto& value) {
+                    using ComponentT = std::decay_t<decltype(value)>;
+                    if constexpr (IsArchetypeStorage<DefaultStorage<ComponentT>>::value) {
+                        for (Entity entity : entities) m_archetypes.Get<ComponentT>(entity) = value;
+                    }
+                };
+                (assign(values), ...);
+            }
+            const ComponentId types[] = { GetComponentId<ComponentTs>()... };
+            OnStructuralChange(entities.data(), count, types, sizeof...(ComponentTs));
+        } catch (...) {
+            // A storage threw halfway, e.g., from a copy constructor. Drop the entities with the components added so far.
+            DestroyEntities(entities.data(), count);
+            throw;
+        }
+    }
+    return entities;
+}
+
+template <typename... ComponentTs>
+inline void Registry::RemoveComponents(Entity entity)
+{
+    static_assert(sizeof...(ComponentTs) > 0, "Registry: at least one component type has to be given");
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    CheckAlive(entity);
+    const ComponentId types[] = { GetComponentId<ComponentTs>()... };
+    // Check every type up front, so that nothing is changed if one of them cannot be removed.
+    CheckDistinct(types, sizeof...(ComponentTs));
+    if (!(... && GetComponentStorage<ComponentTs, ComponentStorageInterface>().HasComponent(entity))) throw std::runtime_error("Registry: the entity does not have one of the specified components");
+    // Gather archetype components to move the entity only once.
+    ComponentId archetype_components[] = { GetComponentId<ComponentTs>()... };
+    size_t num_archetype_components = 0;
+    auto remove = [&](auto tag) {
+        using ComponentT = typename decltype(tag)::Type;
+        auto& storage = GetComponentStorage<ComponentT, ComponentStorageInterface>();
+        if constexpr (IsArchetypeStorage<DefaultStorage<ComponentT>>::value) archetype_components[num_archetype_components++] = GetComponentId<ComponentT>();
+        else {
+            const ComponentId type = GetComponentId<ComponentT>();
+            LeaveGroups(&entity, 1, &type, 1);
+            storage.RemoveComponent(entity);
+        }
+    };
+    (remove(TypeTag<ComponentTs>{}), ...);
+    if (num_archetype_components > 0) m_archetypes.Remove(entity, archetype_components, num_archetype_components);
+    OnStructuralChange(&entity, 1, types, sizeof...(ComponentTs));
 }
 
 template <typename ComponentT>
-inline ComponentT& Registry::AddComponent(Entity entity)
+inline void CommandBuffer::AddComponent(Entity entity, ComponentT value)
+{
+    void* payload = new (m_payloads.allocate(sizeof(ComponentT), alignof(ComponentT))) ComponentT(std::move(value));
+    m_commands.push_back({ GetComponentId<ComponentT>(), detail::StorageIdOf<DefaultStorage<ComponentT>>(), entity, payload,
+        [](Registry& registry, Entity entity, void* payload) {
+            auto& storage = registry.GetComponentStorage<ComponentT>();
+            if (storage.HasComponent(entity)) storage.MarkChanged(entity, storage.GetTick());
+            auto&& component = storage.HasComponent(entity) ? storage.GetComponent(entity) : storage.AddComponent(entity);
+            component = std::move(*static_cast<ComponentT*>(payload));
+        },
+        [](void* payload) { static_cast<ComponentT*>(payload)->~ComponentT(); } });
+}
+
+template <typename ComponentT>
+inline void CommandBuffer::RemoveComponent(Entity entity)
+{
+    m_commands.push_back({ GetComponentId<ComponentT>(), ANY_STORAGE, entity, nullptr,
+        [](Registry& registry, Entity entity, void*) {
+            auto& storage = registry.GetComponentStorage<ComponentT, ComponentStorageInterface>();
+            if (!storage.HasComponent(entity)) return;
+            const ComponentId type = GetComponentId<ComponentT>();
+            registry.LeaveGroups(&entity, 1, &type, 1);
+            storage.RemoveComponent(entity);
+        },
+        nullptr });
+}
+
+template <typename... ComponentTs>
+inline CachedQuery& Registry::CreateQuery()
+{
+    static_assert(sizeof...(ComponentTs) > 0, "Registry: at least one component type has to be given");
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    (GetComponentStorage<ComponentTs, ComponentStorageInterface>(), ...);
+    m_queries.push_back(std::unique_ptr<CachedQuery>(new CachedQuery(*this, { GetComponentId<ComponentTs>()... }, &m_storage_resource)));
+    CachedQuery& query = *m_queries.back();
+    for (ComponentId type : query.m_required) {
+        if (type >= m_component_queries.size()) m_component_queries.resize(size_t(type) + 1);
+        m_component_queries[type].push_back(&query);
+    }
+    RebuildQuery(query);
+    return query;
+}
+
+template <typename... ComponentTs>
+inline Group<ComponentTs...>& Registry::CreateGroup()
 {
     std::lock_guard<std::mutex> lock(m_component_mtx);
-    return GetComponentStorage<ComponentT>().AddComponent(entity);
+    const ComponentId types[] = { GetComponentId<ComponentTs>()... };
+    for (size_t i = 0; i < sizeof...(ComponentTs); ++i) {
+        if (std::find(types, types + i, types[i]) != types + i) throw std::runtime_error("Registry: a group cannot own a component type twice");
+        CheckNotGrouped(types[i]);
+    }
+    auto group = std::make_unique<Group<ComponentTs...>>(std::make_tuple(&GetComponentStorage<ComponentTs>()...));
+    Group<ComponentTs...>& result = *group;
+    for (ComponentId type : types) {
+        if (type >= m_component_groups.size()) m_component_groups.resize(size_t(type) + 1, nullptr);
+        m_component_groups[type] = group.get();
+    }
+    m_groups.push_back(std::move(group));
+    return result;
+}
+
+template <typename ComponentT, typename CompareT>
+inline void Registry::SortComponents(CompareT compare)
+{
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    auto& storage = GetComponentStorage<ComponentT>();
+    CheckNotGrouped(GetComponentId<ComponentT>());
+    storage.Sort(std::move(compare));
+}
+
+template <typename ComponentT, typename OtherT>
+inline void Registry::SortComponentsAs()
+{
+    std::lock_guard<std::mutex> lock(m_component_mtx);
+    auto& storage = GetComponentStorage<ComponentT>();
+    CheckNotGrouped(GetComponentId<ComponentT>());
+    storage.SortAs(GetComponentStorage<OtherT>());
+}
+
+template <typename... ComponentTs>
+inline CachedQuery& CachedQuery::Exclude()
+{
+    std::lock_guard<std::mutex> lock(m_registry.m_component_mtx);
+    (m_registry.GetComponentStorage<ComponentTs, ComponentStorageInterface>(), ...);
+    for (ComponentId type : { GetComponentId<ComponentTs>()... }) {
+        if (std::find(m_excluded.begin(), m_excluded.end(), type) != m_excluded.end()) continue;
+        m_excluded.push_back(type);
+        if (type >= m_registry.m_component_queries.size()) m_registry.m_component_queries.resize(size_t(type) + 1);
+        m_registry.m_component_queries[type].push_back(this);
+    }
+    m_registry.RebuildQuery(*this);
+    return *this;
+}
+
+template <typename... ComponentTs, typename F>
+inline void CachedQuery::Each(F&& f)
+{
+    auto storages = std::make_tuple(&m_registry.GetComponentStorage<std::remove_const_t<ComponentTs>>()...);
+    for (Entity entity : m_entities) {
+        std::apply([&](auto*... storages) { f(entity, storages->GetComponent(entity)...); }, storages);
+    }
+}
+
+template <typename PredicateT>
+inline void Registry::RunUntil(PredicateT&& pred)
+{
+    if (m_systems.empty()) {
+        // Executors do not iterate empty taskflows, step on the calling thread instead.
+        while (!pred()) {
+            BeginStep();
+            EndStep();
+        }
+        return;
+    }
+    RunAsyncUntil(std::forward<PredicateT>(pred)).get();
+}
+
+template <typename PredicateT>
+inline std::future<void> Registry::RunAsyncUntil(PredicateT&& pred)
+{
+    if (m_systems.empty()) {
+        // Executors do not iterate empty taskflows, step on a thread of its own instead, so the caller is not blocked.
+        return std::async(std::launch::async, [this, pred = std::forward<PredicateT>(pred)]() mutable {
+            while (!pred()) {
+                BeginStep();
+                EndStep();
+            }
+        });
+    }
+    // The executor checks the predicate between the iterations of the taskflow, which is where one step ends
+    // and the next one begins.
+    return m_executor.run_until(m_taskflow, [this, pred = std::forward<PredicateT>(pred), running = false]() mutable {
+        if (running) EndStep();
+        running = !pred();
+        if (running) BeginStep();
+        return !running;
+    });
 }
 
 template <typename SystemT, typename... Args>
@@ -186,14 +938,43 @@ inline void Registry::RegisterSystem(Args&&... args)
     if (m_systems.find(tidx) != m_systems.cend()) throw std::runtime_error("Registry: system type already registered");
 
     SystemInvocation invoke;
+    invoke.access = GetSystemAccess<SystemT>();
+    CheckEvents(invoke.access);
     invoke.system = std::make_unique<SystemT>(std::forward<Args>(args)...);
-    invoke.task   = m_taskflow.emplace([system=invoke.system.get(), this](tf::Subflow& subflow) {
-        ComponentAccess access(*this);
-        EntityQuery     query(*this);
-        system->Run(access, query, subflow);
+    invoke.order  = m_systems.size();
+    invoke.name   = detail::TypeName(typeid(SystemT).name());
+    auto& invocation = m_systems.emplace(tidx, std::move(invoke)).first->second;
+    invocation.task  = m_taskflow.emplace([&invocation, this](tf::Subflow& subflow) {
+#if ECS_PROFILING
+        const auto start = m_profiler.Now();
+#endif
+        // Every run gets a tick of its own, so the system sees all changes made after it last started.
+        const Tick      tick = ++m_tick;
+        ComponentAccess access(*this, &invocation.access, tick);
+        EntityQuery     query(*this, &invocation.access, invocation.last_run, nullptr);
+        invocation.system->Run(access, query, subflow);
+        invocation.last_run = tick;
+#if ECS_PROFILING
+        m_profiler.Record(invocation.name.c_str(), ProfileEvent::Kind::SYSTEM, start, m_profiler.Now(), m_executor.this_worker_id(), query.NumQueried());
+#endif
     });
+    ScheduleSystem(invocation);
+}
 
-    m_systems.emplace(tidx, std::move(invoke));
+template <typename SystemT, typename... ReadTs, typename... WriteTs>
+inline void Registry::DeclareAccess(Components<ReadTs...> reads, Components<WriteTs...> writes)
+{
+    std::lock_guard<std::mutex> lock(m_system_mtx);
+    auto system = m_systems.find(TypeIndex<SystemT>());
+    if (system == m_systems.end()) throw std::runtime_error("Registry: the specified system type was not found");
+    if (system->second.access.declared) throw std::runtime_error("Registry: the system already declared its access");
+    SystemAccess previous = std::exchange(system->second.access, MakeSystemAccess(reads, writes));
+    try {
+        ScheduleSystem(system->second);
+    } catch (...) {
+        system->second.access = std::move(previous);
+        throw;
+    }
 }
 
 template <typename SystemT>
@@ -208,10 +989,94 @@ inline SystemT& Registry::GetSystem()
 template <typename SystemT0, typename SystemT1>
 inline void Registry::Precede()
 {
+    std::lock_guard<std::mutex> lock(m_system_mtx);
     const auto tidx0 = TypeIndex<SystemT0>(), tidx1 = TypeIndex<SystemT1>();
     auto s0 = m_systems.find(tidx0), s1 = m_systems.find(tidx1);
     if (s0 == m_systems.cend() || s1 == m_systems.cend()) throw std::runtime_error("Registry: one of the specified system types were not found");
-    s0->second.task.precede(s1->second.task);
+    if (s0 == s1 || IsOrderedAfter(s0->second, s1->second)) throw std::runtime_error("Registry: the systems are already ordered the other way round");
+    Order(s0->second, s1->second);
+}
+
+template <typename T>
+inline bool TagStorage<T>::HasComponent(Entity entity) const
+{
+    return m_registry.IsAlive(entity) && m_registry.HasType(GetEntityIndex(entity), GetComponentId<T>());
+}
+
+template <typename T>
+inline T& TagStorage<T>::AddComponent(Entity entity)
+{
+    if (!m_registry.IsAlive(entity)) throw std::runtime_error("ComponentCollection: only alive entities can be tagged");
+    if (HasComponent(entity)) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+    m_registry.SetType(GetEntityIndex(entity), GetComponentId<T>(), true);
+    ++m_size;
+    return m_tag;
+}
+
+template <typename T>
+inline void TagStorage<T>::AddComponents(const Entity* entities, size_t count, const T&)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (!m_registry.IsAlive(entities[i])) throw std::runtime_error("ComponentCollection: only alive entities can be tagged");
+        if (HasComponent(entities[i])) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+    }
+    for (size_t i = 0; i < count; ++i) m_registry.SetType(GetEntityIndex(entities[i]), GetComponentId<T>(), true);
+    m_size += count;
+}
+
+template <typename T>
+inline void TagStorage<T>::RemoveComponent(Entity entity)
+{
+    if (!HasComponent(entity)) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    m_registry.SetType(GetEntityIndex(entity), GetComponentId<T>(), false);
+    --m_size;
+}
+
+template <typename T>
+inline const T& TagStorage<T>::GetComponent(Entity entity) const
+{
+    if (!HasComponent(entity)) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return m_tag;
+}
+
+template <typename T>
+inline T& TagStorage<T>::GetComponent(Entity entity)
+{
+    if (!HasComponent(entity)) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return m_tag;
+}
+
+template <typename T>
+inline void TagStorage<T>::ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const
+{
+    // Tagging is a structural change, which the Registry records in the tick of the entity.
+    for (EntityIndex i = 0; i < m_registry.m_entities.size(); ++i) {
+        if (m_registry.m_entity_ticks[i] > since && HasComponent(m_registry.m_entities[i])) f(m_registry.m_entities[i], &m_tag);
+    }
+}
+
+template <typename T>
+inline void TagStorage<T>::Save(SnapshotWriter& writer) const
+{
+    std::vector<Entity> tagged;
+    tagged.reserve(m_size);
+    for (Entity entity : m_registry.m_entities) {
+        if (HasComponent(entity)) tagged.push_back(entity);
+    }
+    writer.WriteArray(tagged);
+}
+
+template <typename T>
+inline void TagStorage<T>::Load(SnapshotReader& reader)
+{
+    // Loading snapshots clears all signatures first, only the tagged entities are set again.
+    std::vector<Entity> tagged;
+    reader.ReadArray(tagged);
+    for (Entity entity : tagged) {
+        if (!m_registry.IsAlive(entity)) throw std::runtime_error("Snapshot: tagged entity is not alive");
+        m_registry.SetType(GetEntityIndex(entity), GetComponentId<T>(), true);
+    }
+    m_size = tagged.size();
 }
 
 } // namespace ecs
@@ -0,0 +1,158 @@
+#include "snapshot.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ECS_HAS_MMAP 1
+#endif
+
+namespace ecs
+{
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size)
+{
+    m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!m_out) throw std::runtime_error("Snapshot: failed to write");
+    m_offset += size;
+}
+
+void SnapshotWriter::WriteString(const std::string& value)
+{
+    Write<std::uint64_t>(value.size());
+    WriteBytes(value.data(), value.size());
+}
+
+void SnapshotWriter::WriteVarint(std::uint64_t value)
+{
+    std::uint8_t bytes[10];
+    size_t size = 0;
+    for (; value >= 0x80; value >>= 7) bytes[size++] = static_cast<std::uint8_t>(value | 0x80);
+    bytes[size++] = static_cast<std::uint8_t>(value);
+    WriteBytes(bytes, size);
+}
+
+void SnapshotWriter::Align()
+{
+    static const char padding[ALIGNMENT] = {};
+    const size_t size = (ALIGNMENT - m_offset % ALIGNMENT) % ALIGNMENT;
+    if (size > 0) WriteBytes(padding, size);
+}
+
+const std::byte* SnapshotReader::ReadBytes(size_t size)
+{
+    if (size > m_size - m_offset) throw std::runtime_error("Snapshot: unexpected end of data");
+    const std::byte* data = m_data + m_offset;
+    m_offset += size;
+    return data;
+}
+
+std::string SnapshotReader::ReadString()
+{
+    const auto size = Read<std::uint64_t>();
+    if (size > m_size - m_offset) throw std::runtime_error("Snapshot: unexpected end of data");
+    const std::byte* data = ReadBytes(static_cast<size_t>(size));
+    return std::string(reinterpret_cast<const char*>(data), static_cast<size_t>(size));
+}
+
+std::uint64_t SnapshotReader::ReadVarint()
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        const auto byte = static_cast<std::uint8_t>(*ReadBytes(1));
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+    throw std::runtime_error("Snapshot: malformed varint");
+}
+
+void SnapshotReader::Align()
+{
+    const size_t size = (SnapshotWriter::ALIGNMENT - m_offset % SnapshotWriter::ALIGNMENT) % SnapshotWriter::ALIGNMENT;
+    ReadBytes(size);
+}
+
+void detail::WriteXorRle(SnapshotWriter& writer, const std::byte* data, size_t count, size_t element_size)
+{
+    const size_t total = count * element_size;
+    auto at = [&](size_t i) { return i < element_size ? data[i] : data[i] ^ data[i - element_size]; };
+    // Zero runs shorter than this stay part of the literal, a new triple would not be smaller.
+    constexpr size_t MIN_ZERO_RUN = 3;
+    auto zero_run_at = [&](size_t i) {
+        for (size_t j = i; j < i + MIN_ZERO_RUN; ++j) {
+            if (j >= total || at(j) != std::byte{ 0 }) return false;
+        }
+        return true;
+    };
+    std::vector<std::byte> literal;
+    for (size_t i = 0; i < total;) {
+        size_t zeros = 0;
+        for (; i < total && at(i) == std::byte{ 0 }; ++i) ++zeros;
+        literal.clear();
+        for (; i < total && !zero_run_at(i); ++i) literal.push_back(at(i));
+        writer.WriteVarint(zeros);
+        writer.WriteVarint(literal.size());
+        writer.WriteBytes(literal.data(), literal.size());
+    }
+}
+
+void detail::ReadXorRle(SnapshotReader& reader, std::byte* out, size_t count, size_t element_size)
+{
+    const size_t total = count * element_size;
+    for (size_t i = 0; i < total;) {
+        const auto zeros   = reader.ReadVarint();
+        const auto literal = reader.ReadVarint();
+        if (zeros + literal == 0 || zeros > total - i || literal > total - i - zeros) throw std::runtime_error("Snapshot: malformed delta payload");
+        std::memset(out + i, 0, static_cast<size_t>(zeros));
+        i += static_cast<size_t>(zeros);
+        std::memcpy(out + i, reader.ReadBytes(static_cast<size_t>(literal)), static_cast<size_t>(literal));
+        i += static_cast<size_t>(literal);
+    }
+    // Undo the XOR with the predecessor, front to back.
+    for (size_t i = element_size; i < total; ++i) out[i] ^= out[i - element_size];
+}
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef ECS_HAS_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Snapshot: cannot open " + path);
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Snapshot: cannot stat " + path);
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size > 0) {
+        void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // Snapshots are read front to back once.
+            ::madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data   = data;
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+    if (m_mapped || m_size == 0) return;
+#endif
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("Snapshot: cannot open " + path);
+    m_buffer.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+    if (!in) throw std::runtime_error("Snapshot: cannot read " + path);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef ECS_HAS_MMAP
+    if (m_mapped) ::munmap(const_cast<void*>(m_data), m_size);
+#endif
+}
+
+} // namespace ecs
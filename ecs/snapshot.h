@@ -0,0 +1,162 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "ecs/common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace ecs
+{
+
+// Version of the snapshot format written by Registry::SaveSnapshot(). Snapshots of other versions are rejected.
+constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+
+// Sequential binary writer for snapshots.
+// Arrays are prefixed with their element count and size and start at ALIGNMENT-aligned offsets,
+// so a reader working on a memory-mapped file can copy them out directly.
+class SnapshotWriter {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    explicit SnapshotWriter(std::ostream& out) : m_out(out) {}
+
+    // Write a single trivially copyable value.
+    template <typename T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SnapshotWriter: only trivially copyable values can be written");
+        WriteBytes(&value, sizeof(T));
+    }
+    void WriteString(const std::string& value);
+    // Write an unsigned integer in 7-bit groups, small values take a single byte.
+    void WriteVarint(std::uint64_t value);
+
+    // Write the header of an array of count elements of type T. The elements have to follow as raw bytes.
+    template <typename T>
+    void BeginArray(size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SnapshotWriter: only trivially copyable arrays can be written");
+        Write<std::uint64_t>(count);
+        Write<std::uint64_t>(sizeof(T));
+        Align();
+    }
+    // Write an array of trivially copyable elements.
+    template <typename T>
+    void WriteArray(const T* data, size_t count) { BeginArray<T>(count); WriteBytes(data, count * sizeof(T)); }
+    template <typename T, typename AllocT>
+    void WriteArray(const std::vector<T, AllocT>& values) { WriteArray(values.data(), values.size()); }
+
+    void WriteBytes(const void* data, size_t size);
+
+private:
+    // Pad the output to the next multiple of ALIGNMENT.
+    void Align();
+
+    std::ostream& m_out;
+    size_t        m_offset = 0;
+};
+
+// Sequential binary reader over a snapshot in memory, e.g., a MappedFile.
+// Every read is bounds checked and throws std::runtime_error on truncated or malformed data.
+class SnapshotReader {
+public:
+    SnapshotReader(const void* data, size_t size) : m_data(static_cast<const std::byte*>(data)), m_size(size) {}
+
+    template <typename T>
+    T Read()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SnapshotReader: only trivially copyable values can be read");
+        T value;
+        std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+    std::string ReadString();
+    std::uint64_t ReadVarint();
+
+    // Read the header of an array of T and return its count elements as raw bytes within the snapshot.
+    template <typename T>
+    const std::byte* BeginArray(size_t& count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SnapshotReader: only trivially copyable arrays can be read");
+        const auto num_elements = Read<std::uint64_t>();
+        if (Read<std::uint64_t>() != sizeof(T)) throw std::runtime_error("Snapshot: array element size does not match");
+        Align();
+        if (num_elements > (m_size - m_offset) / sizeof(T)) throw std::runtime_error("Snapshot: unexpected end of data");
+        count = static_cast<size_t>(num_elements);
+        return ReadBytes(count * sizeof(T));
+    }
+    // Replace the content of values with an array, copied with a single memcpy.
+    template <typename T, typename AllocT>
+    void ReadArray(std::vector<T, AllocT>& values)
+    {
+        size_t count = 0;
+        const std::byte* data = BeginArray<T>(count);
+        values.resize(count);
+        if (count > 0) std::memcpy(values.data(), data, count * sizeof(T));
+    }
+
+    const std::byte* ReadBytes(size_t size);
+
+private:
+    void Align();
+
+    const std::byte* m_data;
+    size_t           m_size;
+    size_t           m_offset = 0;
+};
+
+// Read-only view of a whole file, memory-mapped where the platform supports it and read into memory otherwise.
+class MappedFile {
+public:
+    // Throws std::runtime_error if the file cannot be opened.
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void* Data() const { return m_data; }
+    size_t      Size() const { return m_size; }
+
+private:
+    const void*            m_data = nullptr;
+    size_t                 m_size = 0;
+    bool                   m_mapped = false;
+    std::vector<std::byte> m_buffer;
+};
+
+namespace detail
+{
+// Write count elements of element_size bytes, each XORed with its predecessor so that unchanged bytes of similar
+// neighbours become zero, as a sequence of (zero run, literal length, literal bytes) triples.
+void WriteXorRle(SnapshotWriter& writer, const std::byte* data, size_t count, size_t element_size);
+// Decode count elements written by WriteXorRle() into out.
+void ReadXorRle(SnapshotReader& reader, std::byte* out, size_t count, size_t element_size);
+
+// Read the added and changed ticks of a storage holding size components. Ticks missing from the snapshot, i.e.,
+// written by a storage not tracking changes, are stamped with tick. Untracked storages drop them.
+template <bool TRACK_CHANGES, typename VectorT>
+inline void ReadTicks(SnapshotReader& reader, VectorT& added, VectorT& changed, size_t size, Tick tick)
+{
+    reader.ReadArray(added);
+    reader.ReadArray(changed);
+    if (!TRACK_CHANGES) {
+        added.clear();
+        changed.clear();
+    } else if (added.size() != size || changed.size() != size) {
+        added.assign(size, tick);
+        changed.assign(size, tick);
+    }
+}
+} // namespace detail
+
+} // namespace ecs
+
+#endif
@@ -0,0 +1,441 @@
+#ifndef SOA_H
+#define SOA_H
+
+#include "ecs/common.h"
+#include "ecs/component.h"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+
+// List of the data members of an aggregate component that SoAComponentStorage splits into columns.
+template <auto... Members>
+struct Fields {
+    static constexpr size_t COUNT = sizeof...(Members);
+    template <size_t I>
+    static constexpr auto MEMBER = std::get<I>(std::make_tuple(Members...));
+};
+
+// Declares the columns of ComponentT by deriving from Fields, e.g.,
+// template <> struct ecs::SoALayout<Position> : ecs::Fields<&Position::x, &Position::y, &Position::z> {};
+// Members not listed are not stored and come back value-initialized.
+template <typename ComponentT>
+struct SoALayout;
+
+// Contiguous range of a column, valid until the next structural change of the storage.
+template <typename T>
+class ColumnSpan {
+public:
+    ColumnSpan(T* data, size_t size) noexcept : m_data(data), m_size(size) {}
+
+    T*     Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+    T& operator[](size_t idx) const { return m_data[idx]; }
+    T* begin() const { return m_data; }
+    T* end()   const { return m_data + m_size; }
+
+private:
+    T*     m_data;
+    size_t m_size;
+};
+
+namespace detail
+{
+template <typename MemberT>
+struct MemberTraits;
+template <typename ClassT, typename FieldT>
+struct MemberTraits<FieldT ClassT::*> {
+    using Class = ClassT;
+    using Field = FieldT;
+};
+
+template <auto A, auto B>
+constexpr bool SameMember()
+{
+    if constexpr (std::is_same_v<decltype(A), decltype(B)>) return A == B;
+    else return false;
+}
+
+// Position of Member within the layout, LayoutT::COUNT if it is not part of it.
+template <auto Member, typename LayoutT, size_t... Is>
+constexpr size_t FieldIndex(std::index_sequence<Is...>)
+{
+    size_t idx = LayoutT::COUNT;
+    ((SameMember<Member, LayoutT::template MEMBER<Is>>() && idx == LayoutT::COUNT ? (idx = Is, 0) : 0), ...);
+    return idx;
+}
+} // namespace detail
+
+// Component storage splitting an aggregate component into one array per field as declared by SoALayout<T>.
+// Every column is aligned to and padded to a multiple of COLUMN_ALIGNMENT bytes, so systems can run vectorized
+// kernels over Column<&T::member>() and may process full vectors reaching into the padding past Size().
+// Entity lookup goes through a paged sparse array like SparseComponentStorage and Entities()[i] owns row i.
+// Components are not stored as objects, so GetComponent() returns a Reference proxy that loads or stores whole
+// components and gives access to single fields. The storage cannot back ComponentViews.
+template <typename T>
+class SoAComponentStorage : public ComponentStorageInterface {
+public:
+    using ComponentType = T;
+    using Layout        = SoALayout<T>;
+
+    // Whether added and changed ticks are kept per component, see ComponentStorageTraits.
+    static constexpr bool TRACK_CHANGES = detail::TrackChanges<T>::value;
+
+    // Alignment of every column, enough for 512-bit vector loads.
+    static constexpr size_t COLUMN_ALIGNMENT = 64;
+
+    // Number of entity indices covered by a single sparse page.
+    static constexpr size_t SPARSE_PAGE_SIZE = 4096;
+
+    // Type of the I-th field.
+    template <size_t I>
+    using FieldType = typename detail::MemberTraits<std::remove_const_t<decltype(Layout::template MEMBER<I>)>>::Field;
+
+    static_assert(std::is_default_constructible_v<T>, "SoAComponentStorage: components have to be default constructible");
+
+    // Proxy to the fields of one component.
+    class Reference {
+    public:
+        // Store all fields of value.
+        Reference& operator=(const T& value) { m_storage->Store(m_idx, value); return *this; }
+        // Load all fields into a component.
+        operator T() const { return m_storage->Load(m_idx); }
+        // Access a single field, e.g., ref.Get<&Position::x>() += 1.f.
+        template <auto Member>
+        auto& Get() const { return m_storage->template Column<Member>()[m_idx]; }
+
+    private:
+        Reference(SoAComponentStorage* storage, ComponentIndex idx) noexcept : m_storage(storage), m_idx(idx) {}
+
+        SoAComponentStorage* m_storage;
+        ComponentIndex       m_idx;
+
+        friend class SoAComponentStorage;
+    };
+
+    SoAComponentStorage() : SoAComponentStorage(std::pmr::get_default_resource()) {}
+    // Allocate all memory of the storage, including columns, from resource.
+    explicit SoAComponentStorage(std::pmr::memory_resource* resource)
+        : m_resource(resource), m_sparse(resource), m_entities(resource), m_added_ticks(resource), m_changed_ticks(resource) {}
+    ~SoAComponentStorage() override { Release(); }
+
+    SoAComponentStorage(const SoAComponentStorage&) = delete;
+    SoAComponentStorage& operator=(const SoAComponentStorage&) = delete;
+
+    // Get collection size.
+    size_t Size() const override { return m_entities.size(); }
+
+    // True if entity has a component in this collection.
+    bool HasComponent(Entity entity) const override { return Index(entity) != INVALID_COMPONENT_INDEX; }
+
+    // Remove component from entity.
+    void RemoveComponent(Entity entity) override;
+
+    // Write every column as a raw blob, respectively replace all components with the columns read.
+    void Save(SnapshotWriter& writer) const override;
+    void Load(SnapshotReader& reader) override;
+    size_t RawSize() const override { return sizeof(T); }
+    void ForEachChanged(Tick since, const std::function<void(Entity, const void*)>& f) const override { detail::ForEachChangedRaw(*this, since, f); }
+    void SetRaw(Entity entity, const void* data) override { detail::SetRaw(*this, entity, data); }
+
+    // Get component for entity, throws std::runtime_error if HasComponent(entity) == false.
+    Reference GetComponent(Entity entity) { return Reference(this, CheckedIndex(entity)); }
+    T         GetComponent(Entity entity) const { return Load(CheckedIndex(entity)); }
+
+    // Add a value-initialized component to an entity.
+    Reference AddComponent(Entity entity);
+
+    // Add copies of value to count distinct entities at once.
+    // Throws std::runtime_error without adding anything if one of the entities already has a component.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+
+    // Reserve memory for at least capacity components.
+    void Reserve(size_t capacity);
+
+    // Get dense index of the entity's component, or INVALID_COMPONENT_INDEX if it has none.
+    ComponentIndex Index(Entity entity) const;
+
+    // Dense array of entities owning a component. Entities()[idx] owns row idx of every column.
+    const std::pmr::vector<Entity>& Entities() const { return m_entities; }
+
+    // Column of a field, e.g., Column<&Position::x>().
+    template <auto Member>
+    auto Column()       { return ColumnSpan<FieldType<FieldIndex<Member>()>>(ColumnData<FieldIndex<Member>()>(), Size()); }
+    template <auto Member>
+    auto Column() const { return ColumnSpan<const FieldType<FieldIndex<Member>()>>(ColumnData<FieldIndex<Member>()>(), Size()); }
+
+    // Tick at which the component of an entity was added or last changed, 0 if the entity has none.
+    Tick AddedTick(Entity entity) const;
+    Tick ChangedTick(Entity entity) const;
+    // Tick at which the component at idx was added or last changed.
+    Tick AddedTickAt(ComponentIndex idx) const   { return TRACK_CHANGES ? m_added_ticks[idx] : UNTRACKED_TICK; }
+    Tick ChangedTickAt(ComponentIndex idx) const { return TRACK_CHANGES ? m_changed_ticks[idx] : UNTRACKED_TICK; }
+    // Stamp the component of an entity as changed at tick. Does nothing if the entity has none.
+    void MarkChanged(Entity entity, Tick tick);
+
+    // Access component by idx.
+    Reference operator[](ComponentIndex idx)       { return Reference(this, idx); }
+    T         operator[](ComponentIndex idx) const { return Load(idx); }
+
+private:
+    using SparseIndex = std::uint32_t;
+    static constexpr SparseIndex INVALID_SPARSE_INDEX = ~0u;
+    using Indices = std::make_index_sequence<Layout::COUNT>;
+
+    template <auto Member>
+    static constexpr size_t FieldIndex()
+    {
+        constexpr size_t idx = detail::FieldIndex<Member, Layout>(Indices());
+        static_assert(idx < Layout::COUNT, "SoAComponentStorage: the member is not part of the component's SoALayout");
+        return idx;
+    }
+
+    template <size_t I>
+    FieldType<I>* ColumnData() const { return static_cast<FieldType<I>*>(m_columns[I]); }
+    // Bytes allocated for a column of capacity elements, padded to the column alignment.
+    template <size_t I>
+    static size_t ColumnBytes(size_t capacity) { return (capacity * sizeof(FieldType<I>) + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT; }
+
+    template <size_t... Is>
+    void Store(ComponentIndex idx, const T& value, std::index_sequence<Is...>) { ((ColumnData<Is>()[idx] = value.*Layout::template MEMBER<Is>), ...); }
+    void Store(ComponentIndex idx, const T& value) { Store(idx, value, Indices()); }
+    template <size_t... Is>
+    void Load(ComponentIndex idx, T& value, std::index_sequence<Is...>) const { ((value.*Layout::template MEMBER<Is> = ColumnData<Is>()[idx]), ...); }
+    T Load(ComponentIndex idx) const { T value{}; Load(idx, value, Indices()); return value; }
+    template <size_t... Is>
+    void Move(ComponentIndex to, ComponentIndex from, std::index_sequence<Is...>) { ((ColumnData<Is>()[to] = ColumnData<Is>()[from]), ...); }
+
+    // Reallocate all columns to hold capacity components.
+    template <size_t... Is>
+    void Grow(size_t capacity, std::index_sequence<Is...>);
+    template <size_t... Is>
+    void Release(std::index_sequence<Is...>);
+    template <size_t... Is>
+    void SaveColumns(SnapshotWriter& writer, std::index_sequence<Is...>) const { (writer.WriteArray(ColumnData<Is>(), Size()), ...); }
+    template <size_t... Is>
+    void LoadColumns(SnapshotReader& reader, std::index_sequence<Is...>);
+    void Release() { Release(Indices()); }
+
+    ComponentIndex CheckedIndex(Entity entity) const;
+    // Get sparse entry of an entity, allocating its page if needed.
+    SparseIndex& SparseEntry(Entity entity);
+
+    std::pmr::memory_resource*                      m_resource;
+    std::array<void*, Layout::COUNT>                m_columns{};
+    size_t                                          m_capacity = 0;
+    // Pages of sparse entries, empty for pages not allocated yet.
+    std::pmr::vector<std::pmr::vector<SparseIndex>> m_sparse;
+    std::pmr::vector<Entity>                        m_entities;
+    // Ticks parallel to the columns, empty unless TRACK_CHANGES.
+    std::pmr::vector<Tick>                          m_added_ticks;
+    std::pmr::vector<Tick>                          m_changed_ticks;
+
+    template <size_t I>
+    static constexpr bool TRIVIAL_FIELD = std::is_trivially_copyable_v<FieldType<I>>;
+    template <size_t... Is>
+    static constexpr bool AllTrivial(std::index_sequence<Is...>) { return (TRIVIAL_FIELD<Is> && ...); }
+    static_assert(AllTrivial(Indices()), "SoAComponentStorage: fields have to be trivially copyable");
+};
+
+template <typename T>
+template <size_t... Is>
+inline void SoAComponentStorage<T>::Grow(size_t capacity, std::index_sequence<Is...>)
+{
+    auto grow = [&](auto column) {
+        constexpr size_t I = decltype(column)::value;
+        void* data = m_resource->allocate(ColumnBytes<I>(capacity), COLUMN_ALIGNMENT);
+        if (m_columns[I]) {
+            std::memcpy(data, m_columns[I], Size() * sizeof(FieldType<I>));
+            m_resource->deallocate(m_columns[I], ColumnBytes<I>(m_capacity), COLUMN_ALIGNMENT);
+        }
+        m_columns[I] = data;
+    };
+    (grow(std::integral_constant<size_t, Is>()), ...);
+    m_capacity = capacity;
+}
+
+template <typename T>
+template <size_t... Is>
+inline void SoAComponentStorage<T>::Release(std::index_sequence<Is...>)
+{
+    ((m_columns[Is] ? m_resource->deallocate(m_columns[Is], ColumnBytes<Is>(m_capacity), COLUMN_ALIGNMENT) : void()), ...);
+    m_columns  = {};
+    m_capacity = 0;
+}
+
+template <typename T>
+template <size_t... Is>
+inline void SoAComponentStorage<T>::LoadColumns(SnapshotReader& reader, std::index_sequence<Is...>)
+{
+    auto load = [&](auto column) {
+        constexpr size_t I = decltype(column)::value;
+        size_t count = 0;
+        const std::byte* data = reader.BeginArray<FieldType<I>>(count);
+        if (count != Size()) throw std::runtime_error("Snapshot: column and entity counts do not match");
+        if (count > 0) std::memcpy(ColumnData<I>(), data, count * sizeof(FieldType<I>));
+    };
+    (load(std::integral_constant<size_t, Is>()), ...);
+}
+
+template <typename T>
+inline void SoAComponentStorage<T>::Save(SnapshotWriter& writer) const
+{
+    writer.WriteArray(m_entities);
+    SaveColumns(writer, Indices());
+    writer.WriteArray(m_added_ticks);
+    writer.WriteArray(m_changed_ticks);
+}
+
+template <typename T>
+inline void SoAComponentStorage<T>::Load(SnapshotReader& reader)
+{
+    reader.ReadArray(m_entities);
+    // The old rows are overwritten anyway, so columns too small are replaced instead of grown.
+    if (Size() > m_capacity) {
+        Release();
+        Grow(Size(), Indices());
+    }
+    LoadColumns(reader, Indices());
+    detail::ReadTicks<TRACK_CHANGES>(reader, m_added_ticks, m_changed_ticks, Size(), m_tick);
+    m_sparse.clear();
+    for (ComponentIndex i = 0; i < Size(); ++i) SparseEntry(m_entities[i]) = static_cast<SparseIndex>(i);
+}
+
+template <typename T>
+inline ComponentIndex SoAComponentStorage<T>::Index(Entity entity) const
+{
+    const size_t page = GetEntityIndex(entity) / SPARSE_PAGE_SIZE;
+    if (page >= m_sparse.size() || m_sparse[page].empty()) return INVALID_COMPONENT_INDEX;
+    const SparseIndex idx = m_sparse[page][GetEntityIndex(entity) % SPARSE_PAGE_SIZE];
+    // Comparing the owner rejects stale handles whose index got reused.
+    return idx == INVALID_SPARSE_INDEX || m_entities[idx] != entity ? INVALID_COMPONENT_INDEX : idx;
+}
+
+template <typename T>
+inline ComponentIndex SoAComponentStorage<T>::CheckedIndex(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specific component");
+    return idx;
+}
+
+template <typename T>
+inline typename SoAComponentStorage<T>::SparseIndex& SoAComponentStorage<T>::SparseEntry(Entity entity)
+{
+    const size_t page = GetEntityIndex(entity) / SPARSE_PAGE_SIZE;
+    if (page >= m_sparse.size()) m_sparse.resize(page + 1);
+    if (m_sparse[page].empty()) m_sparse[page].resize(SPARSE_PAGE_SIZE, INVALID_SPARSE_INDEX);
+    return m_sparse[page][GetEntityIndex(entity) % SPARSE_PAGE_SIZE];
+}
+
+template <typename T>
+inline void SoAComponentStorage<T>::Reserve(size_t capacity)
+{
+    if (capacity > m_capacity) Grow(capacity, Indices());
+    m_entities.reserve(capacity);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.reserve(capacity);
+        m_changed_ticks.reserve(capacity);
+    }
+}
+
+template <typename T>
+inline typename SoAComponentStorage<T>::Reference SoAComponentStorage<T>::AddComponent(Entity entity)
+{
+    SparseIndex& idx = SparseEntry(entity);
+    if (idx != INVALID_SPARSE_INDEX) {
+        if (m_entities[idx] == entity) throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+        throw std::runtime_error("ComponentCollection: Entity index is in use by another version of the entity");
+    }
+    if (Size() == m_capacity) Grow(std::max<size_t>(16, 2 * m_capacity), Indices());
+    idx = static_cast<SparseIndex>(Size());
+    Store(idx, T{});
+    m_entities.push_back(entity);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.push_back(m_tick);
+        m_changed_ticks.push_back(m_tick);
+    }
+    return Reference(this, idx);
+}
+
+template <typename T>
+inline void SoAComponentStorage<T>::AddComponents(const Entity* entities, size_t count, const T& value)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const size_t page = GetEntityIndex(entities[i]) / SPARSE_PAGE_SIZE;
+        if (page < m_sparse.size() && !m_sparse[page].empty() && m_sparse[page][GetEntityIndex(entities[i]) % SPARSE_PAGE_SIZE] != INVALID_SPARSE_INDEX) {
+            throw std::runtime_error("ComponentCollection: Entity already contains the specific component");
+        }
+    }
+    if (Size() + count > m_capacity) Grow(std::max(Size() + count, 2 * m_capacity), Indices());
+    for (size_t i = 0; i < count; ++i) {
+        SparseEntry(entities[i]) = static_cast<SparseIndex>(Size() + i);
+        Store(Size() + i, value);
+    }
+    m_entities.insert(m_entities.end(), entities, entities + count);
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.insert(m_added_ticks.end(), count, m_tick);
+        m_changed_ticks.insert(m_changed_ticks.end(), count, m_tick);
+    }
+}
+
+template <typename T>
+inline void SoAComponentStorage<T>::RemoveComponent(Entity entity)
+{
+    const ComponentIndex free_idx = Index(entity);
+    if (free_idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    // Move the last row into the freed one and redirect its owner.
+    const ComponentIndex last_idx = Size() - 1;
+    if (free_idx != last_idx) {
+        Move(free_idx, last_idx, Indices());
+        m_entities[free_idx] = m_entities[last_idx];
+        SparseEntry(m_entities[free_idx]) = static_cast<SparseIndex>(free_idx);
+        if constexpr (TRACK_CHANGES) {
+            m_added_ticks[free_idx]   = m_added_ticks[last_idx];
+            m_changed_ticks[free_idx] = m_changed_ticks[last_idx];
+        }
+    }
+    SparseEntry(entity) = INVALID_SPARSE_INDEX;
+    m_entities.pop_back();
+    if constexpr (TRACK_CHANGES) {
+        m_added_ticks.pop_back();
+        m_changed_ticks.pop_back();
+    }
+}
+
+template <typename T>
+inline Tick SoAComponentStorage<T>::AddedTick(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? 0 : AddedTickAt(idx);
+}
+
+template <typename T>
+inline Tick SoAComponentStorage<T>::ChangedTick(Entity entity) const
+{
+    const ComponentIndex idx = Index(entity);
+    return idx == INVALID_COMPONENT_INDEX ? 0 : ChangedTickAt(idx);
+}
+
+template <typename T>
+inline void SoAComponentStorage<T>::MarkChanged(Entity entity, Tick tick)
+{
+    if constexpr (TRACK_CHANGES) {
+        const ComponentIndex idx = Index(entity);
+        if (idx != INVALID_COMPONENT_INDEX) m_changed_ticks[idx] = tick;
+    }
+}
+
+} // namespace ecs
+
+#endif
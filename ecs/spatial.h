@@ -0,0 +1,461 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "ecs/common.h"
+#include "ecs/component.h"
+#include "ecs/soa.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+
+// Point in space as seen by SpatialHashStorage. Two dimensional layouts keep z at 0.
+using SpatialVector = std::array<float, 3>;
+
+// Declares the coordinates of ComponentT indexed by SpatialHashStorage by deriving from Fields, e.g.,
+// template <> struct ecs::SpatialLayout<Collider> : ecs::Fields<&Collider::x, &Collider::y, &Collider::z> {};
+// Two fields index the plane, three fields space.
+template <typename ComponentT>
+struct SpatialLayout;
+
+// Component storage indexing its components by position in a uniform hash grid, for proximity queries without
+// looking at every entity, e.g., collision broadphase or interest management.
+// Every component is filed in the cell of the position it had when it was added or last indexed. Components whose
+// position is written have to be stamped as changed, e.g., through ComponentAccess::Write(entity) or MarkChanged(),
+// and are moved to their new cells by the next Update(). Stamping only flags the slot of the entity, so distinct
+// entities can be stamped from parallel tasks, e.g., within ParallelEach(). Queries are const, may run concurrently
+// and see the positions as of the last Update(). Cells are cheapest for queries with a radius around the cell size.
+// Cell coordinates are expected to stay within +-2^20.
+template <typename T>
+class SpatialHashStorage : public SparseComponentStorage<T> {
+    using Base   = SparseComponentStorage<T>;
+    using Layout = SpatialLayout<T>;
+    static_assert(Layout::COUNT == 2 || Layout::COUNT == 3, "SpatialHashStorage: the layout has to list two or three coordinates");
+public:
+    using ComponentType = T;
+
+    static constexpr size_t DIMENSIONS        = Layout::COUNT;
+    static constexpr float  DEFAULT_CELL_SIZE = 1.f;
+
+    SpatialHashStorage() = default;
+    // Allocate all memory of the storage, including the grid, from resource.
+    explicit SpatialHashStorage(std::pmr::memory_resource* resource)
+        : Base(resource), m_locations(resource), m_cells(resource), m_cell_index(resource) {}
+    ~SpatialHashStorage() override = default;
+
+    void RemoveComponent(Entity entity) override;
+    // Load the components and index all of them.
+    void Load(SnapshotReader& reader) override;
+    void SetRaw(Entity entity, const void* data) override { detail::SetRaw(*this, entity, data); }
+
+    // Add a component to an entity. The component is indexed once more by the next Update(), so that the position
+    // can be assigned through the returned reference.
+    T& AddComponent(Entity entity);
+    // Add copies of value to count distinct entities at once, indexed right away.
+    // Throws std::runtime_error without adding anything if one of the entities already has a component.
+    void AddComponents(const Entity* entities, size_t count, const T& value);
+    // Stamp the component of an entity as changed at tick and flag it for the next Update().
+    // Writes only the slot of the entity, like SparseComponentStorage::MarkChanged().
+    void MarkChanged(Entity entity, Tick tick);
+
+    // Swap and sort like SparseComponentStorage, keeping the index intact.
+    void Swap(ComponentIndex lhs, ComponentIndex rhs);
+    template <typename CompareT>
+    void Sort(CompareT compare) { detail::SortDense(*this, Base::Size(), compare); }
+    template <typename StorageT>
+    void SortAs(const StorageT& other) { detail::SortDenseAs(*this, other); }
+
+    // Move the components flagged since the last Update() to the cells of their current positions.
+    // Scans the flags of all components, which is cheap next to moving them.
+    void Update();
+    // Set the edge length of the cells and index all components anew. Throws std::runtime_error unless positive.
+    void SetCellSize(float cell_size);
+    float CellSize() const { return m_cell_size; }
+
+    // Position of a component according to SpatialLayout.
+    static SpatialVector PositionOf(const T& component);
+
+    // Call f(Entity) for every entity within the axis-aligned box [min, max].
+    template <typename F>
+    void QueryBox(const SpatialVector& min, const SpatialVector& max, F&& f) const;
+    // Call f(Entity) for every entity within radius of center.
+    template <typename F>
+    void QueryRadius(const SpatialVector& center, float radius, F&& f) const;
+    // Append the k entities nearest to center to result, nearest first.
+    void QueryNearest(const SpatialVector& center, size_t k, std::vector<Entity>& result) const;
+
+    // Call f(Entity, Entity) once for every pair of entities within radius of each other.
+    template <typename F>
+    void ForEachPair(float radius, F&& f) const { ForEachPair(0, m_cells.size(), radius, std::forward<F>(f)); }
+    // Call f(Entity, Entity) for the pairs within radius whose first entity lies in the cells [first, last) of
+    // [0, NumCells()), e.g., to split ForEachPair() among tasks.
+    template <typename F>
+    void ForEachPair(size_t first, size_t last, float radius, F&& f) const;
+    // Number of occupied cells.
+    size_t NumCells() const { return m_cells.size(); }
+
+private:
+    using Coord = std::array<std::int32_t, 3>;
+
+    // Indexed position of a component.
+    struct Entry {
+        Entity        entity;
+        SpatialVector position;
+    };
+    struct Cell {
+        Coord                    coord;
+        std::pmr::vector<Entry>  entries;
+    };
+    // Cell of a component, parallel to the dense component array.
+    struct Location {
+        std::uint64_t key   = 0;
+        bool          dirty = false;
+    };
+
+    static constexpr std::int32_t COORD_BITS = 21;
+
+    Coord CoordOf(const SpatialVector& position) const;
+    static std::uint64_t KeyOf(const Coord& coord);
+    // Cell at coord, nullptr if it is empty.
+    const Cell* FindCell(const Coord& coord) const;
+
+    // File an entity in the cell of position and return the cell's key.
+    std::uint64_t Insert(Entity entity, const SpatialVector& position);
+    // Take an entity out of the cell with key, dropping the cell once empty.
+    void Erase(Entity entity, std::uint64_t key);
+    // Index all components from scratch.
+    void Rebuild();
+    // Call f(const Cell&) for every occupied cell in [lo, hi], clamped to the occupied extent.
+    template <typename F>
+    void EachCell(Coord lo, Coord hi, F&& f) const;
+
+    float                                                m_cell_size = DEFAULT_CELL_SIZE;
+    std::pmr::vector<Location>                           m_locations;
+    std::pmr::vector<Cell>                               m_cells;
+    std::pmr::unordered_map<std::uint64_t, std::uint32_t> m_cell_index;
+    // Bounds of all cells ever occupied since the last Rebuild(), limiting the cells visited by queries.
+    Coord                                                m_min{ 0, 0, 0 };
+    Coord                                                m_max{ -1, -1, -1 };
+};
+
+template <typename T>
+inline SpatialVector SpatialHashStorage<T>::PositionOf(const T& component)
+{
+    SpatialVector position{ 0.f, 0.f, 0.f };
+    position[0] = static_cast<float>(component.*(Layout::template MEMBER<0>));
+    position[1] = static_cast<float>(component.*(Layout::template MEMBER<1>));
+    if constexpr (DIMENSIONS == 3) position[2] = static_cast<float>(component.*(Layout::template MEMBER<2>));
+    return position;
+}
+
+template <typename T>
+inline typename SpatialHashStorage<T>::Coord SpatialHashStorage<T>::CoordOf(const SpatialVector& position) const
+{
+    Coord coord{ 0, 0, 0 };
+    for (size_t d = 0; d < DIMENSIONS; ++d) coord[d] = static_cast<std::int32_t>(std::floor(position[d] / m_cell_size));
+    return coord;
+}
+
+template <typename T>
+inline std::uint64_t SpatialHashStorage<T>::KeyOf(const Coord& coord)
+{
+    constexpr std::uint64_t MASK = (std::uint64_t(1) << COORD_BITS) - 1;
+    return ((static_cast<std::uint64_t>(coord[0]) & MASK) << (2 * COORD_BITS)) |
+           ((static_cast<std::uint64_t>(coord[1]) & MASK) << COORD_BITS) | (static_cast<std::uint64_t>(coord[2]) & MASK);
+}
+
+template <typename T>
+inline const typename SpatialHashStorage<T>::Cell* SpatialHashStorage<T>::FindCell(const Coord& coord) const
+{
+    const auto it = m_cell_index.find(KeyOf(coord));
+    return it == m_cell_index.end() ? nullptr : &m_cells[it->second];
+}
+
+template <typename T>
+inline std::uint64_t SpatialHashStorage<T>::Insert(Entity entity, const SpatialVector& position)
+{
+    const Coord coord = CoordOf(position);
+    const std::uint64_t key = KeyOf(coord);
+    auto [it, inserted] = m_cell_index.try_emplace(key, static_cast<std::uint32_t>(m_cells.size()));
+    if (inserted) {
+        m_cells.push_back(Cell{ coord, std::pmr::vector<Entry>(m_cells.get_allocator()) });
+        if (m_max[0] < m_min[0]) {
+            m_min = m_max = coord;
+        } else {
+            for (size_t d = 0; d < 3; ++d) {
+                m_min[d] = std::min(m_min[d], coord[d]);
+                m_max[d] = std::max(m_max[d], coord[d]);
+            }
+        }
+    }
+    m_cells[it->second].entries.push_back(Entry{ entity, position });
+    return key;
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::Erase(Entity entity, std::uint64_t key)
+{
+    const auto it = m_cell_index.find(key);
+    auto& entries = m_cells[it->second].entries;
+    auto entry = std::find_if(entries.begin(), entries.end(), [entity](const Entry& e) { return e.entity == entity; });
+    *entry = entries.back();
+    entries.pop_back();
+    if (!entries.empty()) return;
+    // Move the last cell into the freed one.
+    const std::uint32_t idx = it->second;
+    m_cell_index.erase(it);
+    if (idx + 1 != m_cells.size()) {
+        m_cells[idx] = std::move(m_cells.back());
+        m_cell_index[KeyOf(m_cells[idx].coord)] = idx;
+    }
+    m_cells.pop_back();
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::Rebuild()
+{
+    m_cells.clear();
+    m_cell_index.clear();
+    m_min = { 0, 0, 0 };
+    m_max = { -1, -1, -1 };
+    m_locations.resize(Base::Size());
+    for (ComponentIndex i = 0; i < Base::Size(); ++i) m_locations[i] = Location{ Insert(Base::Entities()[i], PositionOf((*this)[i])), false };
+}
+
+template <typename T>
+inline T& SpatialHashStorage<T>::AddComponent(Entity entity)
+{
+    T& component = Base::AddComponent(entity);
+    m_locations.push_back(Location{ Insert(entity, PositionOf(component)), true });
+    return component;
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::AddComponents(const Entity* entities, size_t count, const T& value)
+{
+    Base::AddComponents(entities, count, value);
+    const SpatialVector position = PositionOf(value);
+    for (size_t i = 0; i < count; ++i) m_locations.push_back(Location{ Insert(entities[i], position), false });
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::RemoveComponent(Entity entity)
+{
+    const ComponentIndex idx = Base::Index(entity);
+    if (idx == INVALID_COMPONENT_INDEX) throw std::runtime_error("ComponentCollection: Entity does not contain the specified component");
+    Erase(entity, m_locations[idx].key);
+    // The storage moves the last component into the freed slot.
+    Base::RemoveComponent(entity);
+    m_locations[idx] = m_locations.back();
+    m_locations.pop_back();
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::MarkChanged(Entity entity, Tick tick)
+{
+    Base::MarkChanged(entity, tick);
+    const ComponentIndex idx = Base::Index(entity);
+    if (idx != INVALID_COMPONENT_INDEX) m_locations[idx].dirty = true;
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::Swap(ComponentIndex lhs, ComponentIndex rhs)
+{
+    Base::Swap(lhs, rhs);
+    std::swap(m_locations[lhs], m_locations[rhs]);
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::Update()
+{
+    for (ComponentIndex idx = 0; idx < m_locations.size(); ++idx) {
+        Location& location = m_locations[idx];
+        if (!location.dirty) continue;
+        location.dirty = false;
+        const Entity entity = Base::Entities()[idx];
+        const SpatialVector position = PositionOf((*this)[idx]);
+        if (KeyOf(CoordOf(position)) == location.key) {
+            auto& entries = m_cells[m_cell_index.find(location.key)->second].entries;
+            std::find_if(entries.begin(), entries.end(), [entity](const Entry& e) { return e.entity == entity; })->position = position;
+        } else {
+            Erase(entity, location.key);
+            location.key = Insert(entity, position);
+        }
+    }
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::SetCellSize(float cell_size)
+{
+    if (!(cell_size > 0.f)) throw std::runtime_error("SpatialHashStorage: the cell size has to be positive");
+    m_cell_size = cell_size;
+    Rebuild();
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::Load(SnapshotReader& reader)
+{
+    Base::Load(reader);
+    Rebuild();
+}
+
+template <typename T>
+template <typename F>
+inline void SpatialHashStorage<T>::EachCell(Coord lo, Coord hi, F&& f) const
+{
+    std::uint64_t num_cells = 1;
+    for (size_t d = 0; d < 3; ++d) {
+        lo[d] = std::max(lo[d], m_min[d]);
+        hi[d] = std::min(hi[d], m_max[d]);
+        if (lo[d] > hi[d]) return;
+        num_cells *= static_cast<std::uint64_t>(hi[d] - lo[d]) + 1;
+    }
+    // Large ranges are cheaper to answer by walking the occupied cells.
+    if (num_cells > m_cells.size()) {
+        for (const Cell& cell : m_cells) {
+            bool inside = true;
+            for (size_t d = 0; d < 3; ++d) inside = inside && cell.coord[d] >= lo[d] && cell.coord[d] <= hi[d];
+            if (inside) f(cell);
+        }
+        return;
+    }
+    for (std::int32_t x = lo[0]; x <= hi[0]; ++x) {
+        for (std::int32_t y = lo[1]; y <= hi[1]; ++y) {
+            for (std::int32_t z = lo[2]; z <= hi[2]; ++z) {
+                if (const Cell* cell = FindCell({ x, y, z })) f(*cell);
+            }
+        }
+    }
+}
+
+template <typename T>
+template <typename F>
+inline void SpatialHashStorage<T>::QueryBox(const SpatialVector& min, const SpatialVector& max, F&& f) const
+{
+    EachCell(CoordOf(min), CoordOf(max), [&](const Cell& cell) {
+        for (const Entry& entry : cell.entries) {
+            bool inside = true;
+            for (size_t d = 0; d < DIMENSIONS; ++d) inside = inside && entry.position[d] >= min[d] && entry.position[d] <= max[d];
+            if (inside) f(entry.entity);
+        }
+    });
+}
+
+template <typename T>
+template <typename F>
+inline void SpatialHashStorage<T>::QueryRadius(const SpatialVector& center, float radius, F&& f) const
+{
+    SpatialVector min = center, max = center;
+    for (size_t d = 0; d < DIMENSIONS; ++d) {
+        min[d] -= radius;
+        max[d] += radius;
+    }
+    const float radius_sq = radius * radius;
+    EachCell(CoordOf(min), CoordOf(max), [&](const Cell& cell) {
+        for (const Entry& entry : cell.entries) {
+            float distance_sq = 0.f;
+            for (size_t d = 0; d < DIMENSIONS; ++d) distance_sq += (entry.position[d] - center[d]) * (entry.position[d] - center[d]);
+            if (distance_sq <= radius_sq) f(entry.entity);
+        }
+    });
+}
+
+template <typename T>
+inline void SpatialHashStorage<T>::QueryNearest(const SpatialVector& center, size_t k, std::vector<Entity>& result) const
+{
+    if (k == 0 || m_cells.empty()) return;
+    // Max-heap of the k nearest candidates found so far.
+    std::priority_queue<std::pair<float, Entity>> nearest;
+    auto visit = [&](const Cell& cell) {
+        for (const Entry& entry : cell.entries) {
+            float distance_sq = 0.f;
+            for (size_t d = 0; d < DIMENSIONS; ++d) distance_sq += (entry.position[d] - center[d]) * (entry.position[d] - center[d]);
+            if (nearest.size() < k) nearest.emplace(distance_sq, entry.entity);
+            else if (distance_sq < nearest.top().first) {
+                nearest.pop();
+                nearest.emplace(distance_sq, entry.entity);
+            }
+        }
+    };
+    // Visit shells of cells around the center cell until no unvisited cell can hold anything nearer.
+    const Coord origin = CoordOf(center);
+    for (std::int32_t r = 0;; ++r) {
+        Coord lo, hi;
+        for (size_t d = 0; d < 3; ++d) {
+            lo[d] = d < DIMENSIONS ? origin[d] - r : 0;
+            hi[d] = d < DIMENSIONS ? origin[d] + r : 0;
+        }
+        // Cells of the shell only, the interior was visited before.
+        EachCell(lo, hi, [&](const Cell& cell) {
+            std::int32_t distance = 0;
+            for (size_t d = 0; d < DIMENSIONS; ++d) distance = std::max(distance, std::abs(cell.coord[d] - origin[d]));
+            if (distance == r) visit(cell);
+        });
+        // Unvisited points lie beyond the faces of the visited cube that do not enclose the occupied extent yet.
+        bool covered = true;
+        float bound = INFINITY;
+        for (size_t d = 0; d < DIMENSIONS; ++d) {
+            if (lo[d] > m_min[d]) bound = std::min(bound, center[d] - float(lo[d]) * m_cell_size), covered = false;
+            if (hi[d] < m_max[d]) bound = std::min(bound, float(hi[d] + 1) * m_cell_size - center[d]), covered = false;
+        }
+        if (covered || (nearest.size() == k && nearest.top().first <= bound * bound)) break;
+    }
+    const size_t first = result.size();
+    result.resize(first + nearest.size());
+    for (size_t i = result.size(); i-- > first; nearest.pop()) result[i] = nearest.top().second;
+}
+
+template <typename T>
+template <typename F>
+inline void SpatialHashStorage<T>::ForEachPair(size_t first, size_t last, float radius, F&& f) const
+{
+    last = std::min(last, m_cells.size());
+    const float radius_sq = radius * radius;
+    auto within = [radius_sq](const Entry& a, const Entry& b) {
+        float distance_sq = 0.f;
+        for (size_t d = 0; d < DIMENSIONS; ++d) distance_sq += (a.position[d] - b.position[d]) * (a.position[d] - b.position[d]);
+        return distance_sq <= radius_sq;
+    };
+    // Every pair of cells is visited from one side only: the neighbours in the lexicographically positive half.
+    const std::int32_t n = static_cast<std::int32_t>(std::ceil(radius / m_cell_size));
+    const std::int32_t nz = DIMENSIONS == 3 ? n : 0;
+    std::vector<Coord> offsets;
+    for (std::int32_t x = 0; x <= n; ++x) {
+        for (std::int32_t y = x == 0 ? 0 : -n; y <= n; ++y) {
+            for (std::int32_t z = x == 0 && y == 0 ? 1 : -nz; z <= nz; ++z) offsets.push_back({ x, y, z });
+        }
+    }
+    for (size_t c = first; c < last; ++c) {
+        const Cell& cell = m_cells[c];
+        const auto& entries = cell.entries;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            for (size_t j = i + 1; j < entries.size(); ++j) {
+                if (within(entries[i], entries[j])) f(entries[i].entity, entries[j].entity);
+            }
+        }
+        for (const Coord& offset : offsets) {
+            const Cell* neighbour = FindCell({ cell.coord[0] + offset[0], cell.coord[1] + offset[1], cell.coord[2] + offset[2] });
+            if (!neighbour) continue;
+            for (const Entry& a : entries) {
+                for (const Entry& b : neighbour->entries) {
+                    if (within(a, b)) f(a.entity, b.entity);
+                }
+            }
+        }
+    }
+}
+
+} // namespace ecs
+
+#endif
@@ -1,17 +1,43 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include "ecs/common.h"
+
 #include <thirdparty/taskflow/taskflow/taskflow.hpp>
 
+#include <algorithm>
+#include <type_traits>
+#include <typeindex>
+#include <vector>
+
 namespace ecs
 {
 
 class EntityQuery;
 class ComponentAccess;
 
+// List of component types, used by systems to declare which components they access.
+template <typename... ComponentTs>
+struct Components {};
+
+// List of event types, used by systems to declare which events they send and receive.
+template <typename... EventTs>
+struct Events {};
+
 // Interface for system implementers.
 // Registry talks to registered systems via the System interface by calling
 // System::Run() on every registered system every time Registry::Run() is called.
+//
+// Systems may declare the component types they access by defining the member aliases
+//   using Reads  = ecs::Components<Position>;
+//   using Writes = ecs::Components<Velocity>;
+// The Registry then orders conflicting systems by registration order, runs all others in parallel,
+// and verifies that ComponentAccess and EntityQuery are only used for the declared types.
+//
+// Likewise, systems exchanging events declare the event types they send and receive, e.g.,
+//   using Sends    = ecs::Events<Damage>;
+//   using Receives = ecs::Events<Collision>;
+// Senders of an event type are run before its receivers, see Registry::RegisterEvent().
 class System {
 public:
     virtual ~System() = default;
@@ -21,6 +47,103 @@ public:
     virtual void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) = 0;
 };
 
+// Component types a system declared to access. Systems without a declaration are neither scheduled nor checked,
+// except that they can neither send nor receive events.
+struct SystemAccess {
+    bool                     declared = false;
+    std::vector<ComponentId> reads;
+    // Written types are implicitly read as well.
+    std::vector<ComponentId> writes;
+    std::vector<EventId>     sends;
+    std::vector<EventId>     receives;
+
+    bool CanRead(ComponentId type) const  { return !declared || Contains(reads, type) || Contains(writes, type); }
+    bool CanWrite(ComponentId type) const { return !declared || Contains(writes, type); }
+    // Senders have to be ordered before the receivers, which only declared senders are.
+    bool CanSend(EventId type) const      { return declared && Contains(sends, type); }
+    // Receiving keeps track of the events read so far, which only declared receivers have.
+    bool CanReceive(EventId type) const   { return declared && Contains(receives, type); }
+
+    // True if both systems declared their access and one of them writes a type the other one accesses.
+    bool ConflictsWith(const SystemAccess& rhs) const
+    {
+        if (!declared || !rhs.declared) return false;
+        for (const auto& type : writes) {
+            if (Contains(rhs.reads, type) || Contains(rhs.writes, type)) return true;
+        }
+        for (const auto& type : rhs.writes) {
+            if (Contains(reads, type)) return true;
+        }
+        return false;
+    }
+
+    // True if this system sends an event type the other system receives.
+    bool SendsTo(const SystemAccess& rhs) const
+    {
+        for (const auto& type : sends) {
+            if (Contains(rhs.receives, type)) return true;
+        }
+        return false;
+    }
+
+private:
+    static bool Contains(const std::vector<std::uint32_t>& types, std::uint32_t type)
+    {
+        return std::find(types.cbegin(), types.cend(), type) != types.cend();
+    }
+};
+
+// Create a SystemAccess from lists of read and written component types.
+template <typename... ReadTs, typename... WriteTs>
+inline SystemAccess MakeSystemAccess(Components<ReadTs...>, Components<WriteTs...>)
+{
+    SystemAccess access;
+    access.declared = true;
+    access.reads    = { GetComponentId<ReadTs>()... };
+    access.writes   = { GetComponentId<WriteTs>()... };
+    return access;
+}
+
+namespace detail
+{
+
+template <typename SystemT, typename = void>
+struct SystemReads { using Type = Components<>; static constexpr bool declared = false; };
+template <typename SystemT>
+struct SystemReads<SystemT, std::void_t<typename SystemT::Reads>> { using Type = typename SystemT::Reads; static constexpr bool declared = true; };
+
+template <typename SystemT, typename = void>
+struct SystemWrites { using Type = Components<>; static constexpr bool declared = false; };
+template <typename SystemT>
+struct SystemWrites<SystemT, std::void_t<typename SystemT::Writes>> { using Type = typename SystemT::Writes; static constexpr bool declared = true; };
+
+template <typename SystemT, typename = void>
+struct SystemSends { using Type = Events<>; static constexpr bool declared = false; };
+template <typename SystemT>
+struct SystemSends<SystemT, std::void_t<typename SystemT::Sends>> { using Type = typename SystemT::Sends; static constexpr bool declared = true; };
+
+template <typename SystemT, typename = void>
+struct SystemReceives { using Type = Events<>; static constexpr bool declared = false; };
+template <typename SystemT>
+struct SystemReceives<SystemT, std::void_t<typename SystemT::Receives>> { using Type = typename SystemT::Receives; static constexpr bool declared = true; };
+
+template <typename... EventTs>
+inline std::vector<EventId> GetEventIds(Events<EventTs...>) { return { GetEventId<EventTs>()... }; }
+
+} // namespace detail
+
+// Get the access a system type declared through its Reads, Writes, Sends and Receives member aliases.
+template <typename SystemT>
+inline SystemAccess GetSystemAccess()
+{
+    if (!detail::SystemReads<SystemT>::declared && !detail::SystemWrites<SystemT>::declared &&
+        !detail::SystemSends<SystemT>::declared && !detail::SystemReceives<SystemT>::declared) return SystemAccess();
+    SystemAccess access = MakeSystemAccess(typename detail::SystemReads<SystemT>::Type(), typename detail::SystemWrites<SystemT>::Type());
+    access.sends    = detail::GetEventIds(typename detail::SystemSends<SystemT>::Type());
+    access.receives = detail::GetEventIds(typename detail::SystemReceives<SystemT>::Type());
+    return access;
+}
+
 } // namespace ecs
 
 #endif
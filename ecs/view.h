@@ -0,0 +1,180 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include "ecs/common.h"
+#include "ecs/component.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ecs
+{
+
+// Component types an entity must not have to be part of a view.
+// E.g., entity_query.View<Position, Velocity>(Without<Dead>{}).
+template <typename... ComponentTs>
+struct Without {};
+
+// Component types that must have changed, or have been added, since the system last ran for an entity to be part of a view.
+// E.g., entity_query.View<const Position>(Changed<Position>{}, Added<Mesh>{}).
+template <typename... ComponentTs>
+struct Changed {};
+template <typename... ComponentTs>
+struct Added {};
+
+// All filters of a view, Without, Changed and Added merged into one type each.
+template <typename WithoutT = Without<>, typename ChangedT = Changed<>, typename AddedT = Added<>>
+struct ViewFilter {};
+
+namespace detail
+{
+// Merge a list of Without, Changed and Added filters into a ViewFilter.
+template <typename FilterT, typename... ArgTs>
+struct MakeViewFilter { using Type = FilterT; };
+template <typename... Es, typename... Cs, typename... As, typename... Ts, typename... ArgTs>
+struct MakeViewFilter<ViewFilter<Without<Es...>, Changed<Cs...>, Added<As...>>, Without<Ts...>, ArgTs...>
+    : MakeViewFilter<ViewFilter<Without<Es..., Ts...>, Changed<Cs...>, Added<As...>>, ArgTs...> {};
+template <typename... Es, typename... Cs, typename... As, typename... Ts, typename... ArgTs>
+struct MakeViewFilter<ViewFilter<Without<Es...>, Changed<Cs...>, Added<As...>>, Changed<Ts...>, ArgTs...>
+    : MakeViewFilter<ViewFilter<Without<Es...>, Changed<Cs..., Ts...>, Added<As...>>, ArgTs...> {};
+template <typename... Es, typename... Cs, typename... As, typename... Ts, typename... ArgTs>
+struct MakeViewFilter<ViewFilter<Without<Es...>, Changed<Cs...>, Added<As...>>, Added<Ts...>, ArgTs...>
+    : MakeViewFilter<ViewFilter<Without<Es...>, Changed<Cs...>, Added<As..., Ts...>>, ArgTs...> {};
+} // namespace detail
+
+template <typename... FilterTs>
+using MakeViewFilter = typename detail::MakeViewFilter<ViewFilter<>, FilterTs...>::Type;
+
+// Storage of a component type as seen by a view. Const component types are only read.
+template <typename ComponentT>
+using ViewStorage = std::conditional_t<std::is_const_v<ComponentT>,
+                                       const DefaultStorage<std::remove_const_t<ComponentT>>,
+                                       DefaultStorage<ComponentT>>;
+
+template <typename FilterT, typename... ComponentTs>
+class ComponentView;
+
+// Lazy view over all entities having every component in ComponentTs and none of the components in ExcludeTs.
+// Entities can further be restricted to those whose ChangedTs changed or whose AddedTs were added after a tick.
+// The view walks the dense entity array of the smallest participating storage and looks the entity up in the others,
+// so no entity lists are materialized and no memory is allocated. Views are invalidated by structural changes.
+template <typename... ExcludeTs, typename... ChangedTs, typename... AddedTs, typename... ComponentTs>
+class ComponentView<ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>, ComponentTs...> {
+    static_assert(sizeof...(ComponentTs) > 0, "ComponentView: at least one component type has to be given");
+public:
+    using Storages         = std::tuple<ViewStorage<ComponentTs>*...>;
+    using ExcludedStorages = std::tuple<const DefaultStorage<ExcludeTs>*...>;
+    using ChangedStorages  = std::tuple<const DefaultStorage<ChangedTs>*...>;
+    using AddedStorages    = std::tuple<const DefaultStorage<AddedTs>*...>;
+    using Components       = std::tuple<ComponentTs*...>;
+
+    // Forward iterator yielding std::tuple<Entity, ComponentTs&...>.
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::tuple<Entity, ComponentTs&...>;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = value_type;
+        using pointer           = void;
+
+        reference operator*() const
+        {
+            return std::apply([this](auto*... components) { return value_type(m_view->m_entities[m_idx], *components...); }, m_components);
+        }
+        Iterator& operator++() { ++m_idx; Seek(); return *this; }
+        Iterator  operator++(int) { Iterator it = *this; ++*this; return it; }
+
+        bool operator==(const Iterator& rhs) const { return m_idx == rhs.m_idx; }
+        bool operator!=(const Iterator& rhs) const { return m_idx != rhs.m_idx; }
+
+    private:
+        Iterator(const ComponentView* view, size_t idx) : m_view(view), m_idx(idx) { Seek(); }
+        // Advance to the next matching entity.
+        void Seek()
+        {
+            while (m_idx < m_view->m_size && !m_view->Fetch(m_view->m_entities[m_idx], m_components)) ++m_idx;
+        }
+
+        const ComponentView* m_view;
+        size_t               m_idx;
+        Components           m_components;
+
+        friend class ComponentView;
+    };
+
+    // Components of changed and added have to be changed or added after since.
+    ComponentView(const Storages& storages, const ExcludedStorages& excluded,
+                  const ChangedStorages& changed = {}, const AddedStorages& added = {}, Tick since = 0) noexcept;
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end()   const { return Iterator(this, m_size); }
+
+    // Call f(Entity, ComponentTs&...) for every entity in the view.
+    template <typename F>
+    void Each(F&& f) const { Each(0, m_size, std::forward<F>(f)); }
+
+    // Call f(Entity, ComponentTs&...) for every entity in the view found in [first, last) of the iterated entity array.
+    template <typename F>
+    void Each(size_t first, size_t last, F&& f) const;
+
+    // Upper bound on the number of entities in the view, i.e., the size of the iterated entity array.
+    size_t SizeHint() const { return m_size; }
+
+private:
+    // Look up the components of an entity. Returns false if the entity is not part of the view.
+    bool Fetch(Entity entity, Components& components) const
+    {
+        return Fetch(entity, components, std::index_sequence_for<ComponentTs...>{});
+    }
+    template <size_t... Is>
+    bool Fetch(Entity entity, Components& components, std::index_sequence<Is...>) const
+    {
+        return ((std::get<Is>(components) = std::get<Is>(m_storages)->TryGetComponent(entity)) && ...) &&
+               !std::apply([entity](const auto*... excluded) { return (false || ... || excluded->HasComponent(entity)); }, m_excluded) &&
+               std::apply([this, entity](const auto*... changed) { return (true && ... && (changed->ChangedTick(entity) > m_since)); }, m_changed) &&
+               std::apply([this, entity](const auto*... added) { return (true && ... && (added->AddedTick(entity) > m_since)); }, m_added);
+    }
+
+    Storages         m_storages;
+    ExcludedStorages m_excluded;
+    ChangedStorages  m_changed;
+    AddedStorages    m_added;
+    // Components changed or added at or before this tick are filtered out.
+    Tick             m_since = 0;
+    // Dense entity array of the smallest storage.
+    const Entity*    m_entities = nullptr;
+    size_t           m_size     = 0;
+};
+
+template <typename... ExcludeTs, typename... ChangedTs, typename... AddedTs, typename... ComponentTs>
+inline ComponentView<ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>, ComponentTs...>::ComponentView(
+    const Storages& storages, const ExcludedStorages& excluded, const ChangedStorages& changed, const AddedStorages& added, Tick since) noexcept
+    : m_storages(storages), m_excluded(excluded), m_changed(changed), m_added(added), m_since(since)
+{
+    // Iterate over the smallest storage to minimize the number of lookups.
+    m_size = std::get<0>(m_storages)->Size();
+    m_entities = std::get<0>(m_storages)->Entities().data();
+    std::apply([this](const auto*... storages) {
+        ((storages->Size() < m_size ? (m_size = storages->Size(), m_entities = storages->Entities().data()) : m_entities), ...);
+    }, m_storages);
+}
+
+template <typename... ExcludeTs, typename... ChangedTs, typename... AddedTs, typename... ComponentTs>
+template <typename F>
+inline void ComponentView<ViewFilter<Without<ExcludeTs...>, Changed<ChangedTs...>, Added<AddedTs...>>, ComponentTs...>::Each(size_t first, size_t last, F&& f) const
+{
+    Components components;
+    last = std::min(last, m_size);
+    for (size_t i = first; i < last; ++i) {
+        const Entity entity = m_entities[i];
+        if (Fetch(entity, components)) std::apply([&](auto*... c) { f(entity, *c...); }, components);
+    }
+}
+
+} // namespace ecs
+
+#endif
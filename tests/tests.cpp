@@ -3,7 +3,15 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
 #include "catch2/catch.hpp"
 
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <memory_resource>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 
 struct TestData  { float x; };
 struct TestData1 { float x, y; };
@@ -142,3 +150,1702 @@ TEST_CASE("Counting system", "[registry|system]")
     REQUIRE(count1 == EXPECTED_NUM_ENTITIES / 2);
     REQUIRE(count2 == 0);
 }
+
+TEST_CASE("Sparse component storage", "[component]")
+{
+    using namespace ecs;
+    SparseComponentStorage<TestData> storage;
+
+    // Entities far apart land in different sparse pages.
+    const Entity far_entity = 10 * SparseComponentStorage<TestData>::PAGE_SIZE + 3;
+    REQUIRE_FALSE(storage.HasComponent(far_entity));
+    storage.AddComponent(1).x = 1.f;
+    storage.AddComponent(far_entity).x = 2.f;
+    storage.AddComponent(7).x = 3.f;
+    REQUIRE_THROWS_AS(storage.AddComponent(7), std::runtime_error);
+    REQUIRE(storage.Size() == 3);
+    REQUIRE(storage.HasComponent(far_entity));
+    REQUIRE_FALSE(storage.HasComponent(far_entity + 1));
+
+    REQUIRE_NOTHROW(storage.RemoveComponent(1));
+    REQUIRE_THROWS_AS(storage.RemoveComponent(1), std::runtime_error);
+    REQUIRE_THROWS_AS(storage.GetComponent(1), std::runtime_error);
+    REQUIRE(storage.Size() == 2);
+    REQUIRE(storage.GetComponent(far_entity).x == 2.f);
+    REQUIRE(storage.GetComponent(7).x == 3.f);
+
+    // Dense entities stay aligned with the dense components.
+    for (ComponentIndex i = 0; i < storage.Size(); ++i) {
+        REQUIRE(storage.Index(storage.Entities()[i]) == i);
+        REQUIRE(&storage.GetComponent(storage.Entities()[i]) == &storage[i]);
+    }
+}
+
+// Throws once a given number of constructions were made, to make additions fail halfway.
+struct Fallible {
+    static inline int constructions_left = 0;
+    int value = 0;
+    Fallible() { Construct(); }
+    Fallible(const Fallible& rhs) : value(rhs.value) { Construct(); }
+    Fallible& operator=(const Fallible&) = default;
+    static void Construct() { if (constructions_left-- == 0) throw std::runtime_error("Fallible: out of constructions"); }
+};
+
+struct PagedData { float x; };
+
+template <>
+struct ecs::ComponentStorageTraits<PagedData> { using StorageType = PagedComponentStorage<PagedData>; };
+
+TEST_CASE("Paged component storage", "[component]")
+{
+    using namespace ecs;
+    using Storage = PagedComponentStorage<TestData, 8>;
+    Storage storage;
+
+    // Addresses survive growth by many pages and removal of other components.
+    TestData* first = &storage.AddComponent(0);
+    first->x = 1.f;
+    for (Entity e = 1; e < 100; ++e) storage.AddComponent(e).x = float(e);
+    REQUIRE(&storage.GetComponent(0) == first);
+    TestData* last = &storage.GetComponent(99);
+    for (Entity e = 1; e < 99; ++e) storage.RemoveComponent(e);
+    REQUIRE(storage.Size() == 2);
+    REQUIRE(&storage.GetComponent(0) == first);
+    REQUIRE(&storage.GetComponent(99) == last);
+    REQUIRE(storage.GetComponent(99).x == 99.f);
+    REQUIRE_THROWS_AS(storage.RemoveComponent(1), std::runtime_error);
+    REQUIRE_THROWS_AS(storage.AddComponent(0), std::runtime_error);
+
+    // Freed slots are reused before new pages are allocated.
+    const size_t capacity = storage.Capacity();
+    const Entity entities[] = { 200, 201, 202 };
+    storage.AddComponents(entities, 3, TestData{ 5.f });
+    REQUIRE(storage.Capacity() == capacity);
+    REQUIRE(storage.GetComponent(201).x == 5.f);
+
+    for (ComponentIndex i = 0; i < storage.Size(); ++i) {
+        REQUIRE(storage.Index(storage.Entities()[i]) == i);
+        REQUIRE(&storage.GetComponent(storage.Entities()[i]) == &storage[i]);
+    }
+
+    // Failing constructions leave neither components nor used slots behind.
+    PagedComponentStorage<Fallible, 8> fallible;
+    const Entity more[] = { 10, 11, 12, 13, 14 };
+    Fallible::constructions_left = 3;
+    REQUIRE_THROWS_AS(fallible.AddComponents(more, 5, Fallible{}), std::runtime_error);
+    REQUIRE(fallible.Size() == 0);
+    for (Entity e : more) REQUIRE_FALSE(fallible.HasComponent(e));
+    Fallible::constructions_left = 0;
+    REQUIRE_THROWS_AS(fallible.AddComponent(10), std::runtime_error);
+    REQUIRE_FALSE(fallible.HasComponent(10));
+    Fallible::constructions_left = 100;
+    fallible.AddComponents(more, 5, Fallible{});
+    fallible.AddComponent(15);
+    REQUIRE(fallible.Size() == 6);
+    REQUIRE(fallible.Capacity() == 8);
+
+    // References obtained from the Registry stay valid while other entities are created.
+    Registry registry;
+    registry.RegisterComponent<PagedData>();
+    auto created = registry.CreateEntities(20, PagedData{ 2.f });
+    PagedData& component = registry.GetComponent<PagedData>(created[0]);
+    registry.CreateEntities(10000, PagedData{ 3.f });
+    REQUIRE(&registry.GetComponent<PagedData>(created[0]) == &component);
+    REQUIRE(component.x == 2.f);
+}
+
+TEST_CASE("Register component with explicit storage", "[registry|component]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData, PackedComponentStorage<TestData>>());
+    auto entity = registry.CreateEntity().Build();
+    REQUIRE_NOTHROW(registry.AddComponent<TestData, PackedComponentStorage<TestData>>(entity));
+    REQUIRE(registry.HasComponent<TestData>(entity));
+    // Paths using the default storage refuse to access the storage as another class.
+    REQUIRE_THROWS_AS(registry.GetComponent<TestData>(entity), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.AddComponents<TestData>(registry.CreateEntity().Build()), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.CreateEntities(10, TestData{}), std::runtime_error);
+    REQUIRE(registry.GetNumComponents<TestData>() == 1);
+    REQUIRE_NOTHROW(registry.DestroyEntity(entity));
+    REQUIRE_FALSE(registry.HasComponent<TestData>(entity));
+}
+
+struct Name          { std::string value; };
+struct ArchetypeData { float x, y, z; };
+
+template <>
+struct ecs::ComponentStorageTraits<Name> { using StorageType = ArchetypeComponentStorage<Name>; };
+template <>
+struct ecs::ComponentStorageTraits<ArchetypeData> { using StorageType = ArchetypeComponentStorage<ArchetypeData>; };
+
+TEST_CASE("Archetype components", "[registry|archetype]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<Name>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<ArchetypeData>());
+
+    // Enough entities to span several chunks.
+    constexpr int NUM_ENTITIES = 5000;
+    std::vector<Entity> entities;
+    for (int i = 0; i < NUM_ENTITIES; ++i) {
+        auto entity = registry.CreateEntity().AddComponents<TestData, Name, ArchetypeData>().Build();
+        registry.GetComponent<Name>(entity).value = std::to_string(i);
+        registry.GetComponent<ArchetypeData>(entity).x = static_cast<float>(i);
+        entities.push_back(entity);
+    }
+    REQUIRE_THROWS_AS(registry.AddComponent<Name>(entities[0]), std::runtime_error);
+    // Failing bulk changes leave every component in place.
+    const Entity partial = registry.CreateEntity().AddComponents<Name>().Build();
+    REQUIRE_THROWS_AS((registry.AddComponents<TestData, Name>(partial)), std::runtime_error);
+    REQUIRE_THROWS_AS((registry.AddComponents<TestData, TestData>(partial)), std::runtime_error);
+    REQUIRE_FALSE(registry.HasComponent<TestData>(partial));
+    REQUIRE_NOTHROW(registry.AddComponent<TestData>(partial));
+    REQUIRE_THROWS_AS((registry.RemoveComponents<TestData, ArchetypeData>(partial)), std::runtime_error);
+    REQUIRE(registry.HasComponent<TestData>(partial));
+    REQUIRE_NOTHROW(registry.DestroyEntity(partial));
+    REQUIRE(registry.GetNumComponents<Name>() == NUM_ENTITIES);
+    REQUIRE(registry.GetNumComponents<TestData>() == NUM_ENTITIES);
+
+    // Move every other entity into another archetype.
+    for (int i = 0; i < NUM_ENTITIES; i += 2) REQUIRE_NOTHROW(registry.RemoveComponent<ArchetypeData>(entities[i]));
+    REQUIRE_THROWS_AS(registry.RemoveComponent<ArchetypeData>(entities[0]), std::runtime_error);
+    REQUIRE(registry.GetNumComponents<ArchetypeData>() == NUM_ENTITIES / 2);
+    for (int i = 0; i < NUM_ENTITIES; ++i) {
+        REQUIRE(registry.GetComponent<Name>(entities[i]).value == std::to_string(i));
+        REQUIRE(registry.HasComponent<ArchetypeData>(entities[i]) == (i % 2 == 1));
+        REQUIRE(registry.HasComponent<TestData>(entities[i]));
+    }
+
+    REQUIRE_NOTHROW(registry.DestroyEntity(entities[1]));
+    REQUIRE_FALSE(registry.HasComponent<Name>(entities[1]));
+    REQUIRE_FALSE(registry.HasComponent<TestData>(entities[1]));
+
+    class ArchetypeSystem : public System {
+    private:
+        int& m_count;
+        float& m_sum;
+    public:
+        ArchetypeSystem(int& count, float& sum) : m_count(count), m_sum(sum) {}
+
+        void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override
+        {
+            access.Archetypes().Each<const Name, ArchetypeData>([this](Entity e, const Name& name, ArchetypeData& td) {
+                REQUIRE(std::to_string(static_cast<int>(td.x)) == name.value);
+                m_sum += td.x;
+                ++m_count;
+            });
+        }
+    };
+
+    int count = 0;
+    float sum = 0.f;
+    REQUIRE_NOTHROW(registry.RegisterSystem<ArchetypeSystem>(count, sum));
+    REQUIRE_NOTHROW(registry.Run());
+    REQUIRE(count == NUM_ENTITIES / 2 - 1);
+}
+
+TEST_CASE("Component view", "[registry|view]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData1>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData2>());
+
+    constexpr int NUM_ENTITIES = 1024;
+    for (int i = 0; i < NUM_ENTITIES; ++i) {
+        auto entity = registry.CreateEntity().AddComponent<TestData>().Build();
+        if (i % 2 == 0) registry.AddComponent<TestData1>(entity);
+        if (i % 4 == 0) registry.AddComponent<TestData2>(entity);
+        registry.GetComponent<TestData>(entity).x = static_cast<float>(i);
+    }
+
+    class ViewSystem : public System {
+    private:
+        int& m_count0, &m_count1, &m_count2;
+    public:
+        ViewSystem(int& count0, int& count1, int& count2) : m_count0(count0), m_count1(count1), m_count2(count2) {}
+
+        void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override
+        {
+            for (auto [entity, td, td1] : entity_query.View<const TestData, TestData1>()) {
+                td1.x = td.x;
+                ++m_count0;
+            }
+            entity_query.View<TestData1>(Without<TestData2>{}).Each([this](Entity entity, TestData1& td1) {
+                REQUIRE(static_cast<int>(td1.x) % 4 == 2);
+                ++m_count1;
+            });
+            entity_query.View<TestData, TestData2>(Without<TestData1>{}).Each([this](Entity, TestData&, TestData2&) { ++m_count2; });
+        }
+    };
+
+    int count0 = 0, count1 = 0, count2 = 0;
+    REQUIRE_NOTHROW(registry.RegisterSystem<ViewSystem>(count0, count1, count2));
+    REQUIRE_NOTHROW(registry.Run());
+    REQUIRE(count0 == NUM_ENTITIES / 2);
+    REQUIRE(count1 == NUM_ENTITIES / 4);
+    REQUIRE(count2 == 0);
+}
+
+TEST_CASE("Parallel iteration", "[registry|parallel]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData1>());
+
+    constexpr int NUM_ENTITIES = 100000;
+    for (int i = 0; i < NUM_ENTITIES; ++i) {
+        auto entity = registry.CreateEntity().AddComponent<TestData>().Build();
+        if (i % 3 == 0) registry.AddComponent<TestData1>(entity);
+    }
+
+    class ParallelSystem : public System {
+    private:
+        std::atomic<int>& m_count;
+    public:
+        explicit ParallelSystem(std::atomic<int>& count) : m_count(count) {}
+
+        void Run(ComponentAccess& access, EntityQuery& entity_query, tf::Subflow& subflow) override
+        {
+            auto each = ParallelEach(subflow, access.Write<TestData>(), [](Entity entity, TestData& td) { td.x = static_cast<float>(entity); }, 1000);
+            auto view = ParallelView(subflow, entity_query.View<const TestData, TestData1>(), [this](Entity entity, const TestData& td, TestData1& td1) {
+                td1.y = td.x;
+                ++m_count;
+            }, 1000);
+            each.precede(view);
+        }
+    };
+
+    std::atomic<int> count{0};
+    REQUIRE_NOTHROW(registry.RegisterSystem<ParallelSystem>(count));
+    REQUIRE_NOTHROW(registry.Run());
+    REQUIRE(count == (NUM_ENTITIES + 2) / 3);
+    for (Entity entity = 0; entity < NUM_ENTITIES; ++entity) {
+        REQUIRE(registry.GetComponent<TestData>(entity).x == static_cast<float>(entity));
+        if (entity % 3 == 0) REQUIRE(registry.GetComponent<TestData1>(entity).y == static_cast<float>(entity));
+    }
+}
+
+// Writes TestData, which makes every later system reading it run afterwards.
+struct TestWriterSystem : public ecs::System {
+    using Writes = ecs::Components<TestData>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        for (auto [entity, td] : entity_query.View<TestData>()) td.x = 1.f;
+    }
+};
+// Reads TestData and writes TestData1.
+struct TestReaderSystem : public ecs::System {
+    using Reads  = ecs::Components<TestData>;
+    using Writes = ecs::Components<TestData1>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        const auto& td = access.Read<TestData>();
+        entity_query.View<TestData1>().Each([&td](ecs::Entity entity, TestData1& td1) { td1.x = td.GetComponent(entity).x; });
+    }
+};
+// Declares its access at registration.
+struct TestCounterSystem : public ecs::System {
+    int& m_count;
+    explicit TestCounterSystem(int& count) : m_count(count) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        entity_query.View<const TestData1>().Each([this](ecs::Entity, const TestData1& td1) { m_count += td1.x == 1.f; });
+    }
+};
+
+TEST_CASE("Declared system access", "[registry|system]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData1>());
+
+    constexpr int NUM_ENTITIES = 1024;
+    for (int i = 0; i < NUM_ENTITIES; ++i) REQUIRE_NOTHROW(registry.CreateEntity().AddComponent<TestData>().AddComponent<TestData1>().Build());
+
+    int count = 0;
+    REQUIRE_NOTHROW(registry.RegisterSystem<TestWriterSystem>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<TestReaderSystem>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<TestCounterSystem>(count));
+    REQUIRE_THROWS_AS(registry.DeclareAccess<TestSystem>(Components<TestData1>{}, Components<>{}), std::runtime_error);
+    REQUIRE_NOTHROW(registry.DeclareAccess<TestCounterSystem>(Components<TestData1>{}, Components<>{}));
+    REQUIRE_THROWS_AS(registry.DeclareAccess<TestCounterSystem>(Components<TestData1>{}, Components<>{}), std::runtime_error);
+
+    // The writer runs before the reader because of their declared access, the reverse order would be a cycle.
+    REQUIRE_THROWS_AS((registry.Precede<TestReaderSystem, TestWriterSystem>()), std::runtime_error);
+    REQUIRE_THROWS_AS((registry.Precede<TestCounterSystem, TestWriterSystem>()), std::runtime_error);
+    REQUIRE_THROWS_AS((registry.Precede<TestWriterSystem, TestWriterSystem>()), std::runtime_error);
+    REQUIRE_NOTHROW(registry.Precede<TestWriterSystem, TestCounterSystem>());
+
+    REQUIRE_NOTHROW(registry.Run());
+    REQUIRE(count == NUM_ENTITIES);
+}
+
+TEST_CASE("System access conflicts", "[system]")
+{
+    using namespace ecs;
+    const auto reader  = MakeSystemAccess(Components<TestData>{}, Components<>{});
+    const auto reader1 = MakeSystemAccess(Components<TestData, TestData1>{}, Components<>{});
+    const auto writer  = MakeSystemAccess(Components<>{}, Components<TestData>{});
+    const auto writer1 = MakeSystemAccess(Components<TestData>{}, Components<TestData1>{});
+
+    REQUIRE_FALSE(reader.ConflictsWith(reader1));
+    REQUIRE(reader.ConflictsWith(writer));
+    REQUIRE(writer.ConflictsWith(reader));
+    REQUIRE(writer.ConflictsWith(writer1));
+    REQUIRE(reader1.ConflictsWith(writer1));
+    REQUIRE_FALSE(reader.ConflictsWith(writer1));
+    REQUIRE_FALSE(reader.ConflictsWith(SystemAccess()));
+
+    REQUIRE(writer.CanRead(GetComponentId<TestData>()));
+    REQUIRE_FALSE(reader.CanWrite(GetComponentId<TestData>()));
+    REQUIRE_FALSE(reader.CanRead(GetComponentId<TestData1>()));
+    REQUIRE(SystemAccess().CanWrite(GetComponentId<TestData1>()));
+}
+
+TEST_CASE("Entity versions", "[registry|entity]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<Name>());
+
+    auto entity0 = registry.CreateEntity().AddComponent<TestData>().AddComponent<Name>().Build();
+    auto entity1 = registry.CreateEntity().Build();
+    REQUIRE(registry.IsAlive(entity0));
+    REQUIRE(registry.IsAlive(entity1));
+    REQUIRE_FALSE(registry.IsAlive(INVALID_ENTITY));
+
+    REQUIRE_NOTHROW(registry.DestroyEntity(entity0));
+    REQUIRE_FALSE(registry.IsAlive(entity0));
+    REQUIRE_THROWS_AS(registry.DestroyEntity(entity0), std::runtime_error);
+
+    // The freed index is reused with a new version, the stale handle does not alias the new entity.
+    auto entity2 = registry.CreateEntity().AddComponent<TestData>().AddComponent<Name>().Build();
+    REQUIRE(GetEntityIndex(entity2) == GetEntityIndex(entity0));
+    REQUIRE(GetEntityVersion(entity2) == GetEntityVersion(entity0) + 1);
+    REQUIRE(registry.IsAlive(entity2));
+    REQUIRE_FALSE(registry.IsAlive(entity0));
+    REQUIRE(registry.HasComponent<TestData>(entity2));
+    REQUIRE_FALSE(registry.HasComponent<TestData>(entity0));
+    REQUIRE_FALSE(registry.HasComponent<Name>(entity0));
+    REQUIRE_THROWS_AS(registry.GetComponent<TestData>(entity0), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.GetComponent<Name>(entity0), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.AddComponent<TestData>(entity0), std::runtime_error);
+
+    // Fresh indices are only handed out once the free list is empty.
+    auto entity3 = registry.CreateEntity().Build();
+    REQUIRE(GetEntityIndex(entity3) == 2);
+}
+
+TEST_CASE("Bulk entity creation and destruction", "[registry|entity]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<Name>());
+
+    // Leave a few holes in the free list.
+    auto first = registry.CreateEntities(8);
+    REQUIRE_NOTHROW(registry.DestroyEntities(std::vector<Entity>(first.begin(), first.begin() + 4)));
+
+    constexpr size_t NUM_ENTITIES = 10000;
+    auto entities = registry.CreateEntities(NUM_ENTITIES, TestData{ 1.f }, Name{ "bulk" });
+    REQUIRE(entities.size() == NUM_ENTITIES);
+    REQUIRE(registry.GetNumComponents<TestData>() == NUM_ENTITIES);
+    REQUIRE(registry.GetNumComponents<Name>() == NUM_ENTITIES);
+    for (Entity entity : entities) {
+        REQUIRE(registry.IsAlive(entity));
+        REQUIRE(registry.GetComponent<TestData>(entity).x == 1.f);
+        REQUIRE(registry.GetComponent<Name>(entity).value == "bulk");
+    }
+    for (size_t i = 0; i < 4; ++i) REQUIRE(GetEntityIndex(entities[i]) < 4);
+
+    REQUIRE_THROWS_AS(registry.DestroyEntities(first), std::runtime_error);
+    REQUIRE(registry.IsAlive(first[4]));
+    // Duplicates are rejected, otherwise their slot would be reused twice.
+    REQUIRE_THROWS_AS(registry.DestroyEntities(std::vector<Entity>{ first[4], first[5], first[4] }), std::runtime_error);
+    REQUIRE(registry.IsAlive(first[4]));
+    REQUIRE(registry.IsAlive(first[5]));
+    REQUIRE_NOTHROW(registry.DestroyEntities(std::vector<Entity>{ first[4], first[5] }));
+    const auto reused = registry.CreateEntities(3);
+    REQUIRE(GetEntityIndex(reused[0]) != GetEntityIndex(reused[1]));
+
+    // Failing creations leave neither entities nor components behind.
+    REQUIRE_NOTHROW(registry.RegisterComponent<Fallible>());
+    REQUIRE_THROWS_AS(registry.CreateEntities(3, TestData{ 1.f }, TestData{ 2.f }), std::runtime_error);
+    Fallible::constructions_left = 50;
+    REQUIRE_THROWS_AS(registry.CreateEntities(100, TestData{ 3.f }, Fallible{}), std::runtime_error);
+    REQUIRE(registry.GetNumComponents<TestData>() == NUM_ENTITIES);
+    REQUIRE(registry.GetNumComponents<Fallible>() == 0);
+    REQUIRE(registry.CreateQuery<TestData>().Size() == NUM_ENTITIES);
+    Fallible::constructions_left = 1000;
+    REQUIRE(registry.CreateEntities(100, Fallible{}).size() == 100);
+    REQUIRE(registry.GetNumComponents<Fallible>() == 100);
+
+    std::vector<Entity> destroyed(entities.begin(), entities.begin() + NUM_ENTITIES / 2);
+    REQUIRE_NOTHROW(registry.DestroyEntities(destroyed));
+    REQUIRE(registry.GetNumComponents<TestData>() == NUM_ENTITIES / 2);
+    REQUIRE(registry.GetNumComponents<Name>() == NUM_ENTITIES / 2);
+    for (Entity entity : destroyed) REQUIRE_FALSE(registry.IsAlive(entity));
+}
+
+// Spawns an entity per TestData and destroys the entities having TestData1 through its command buffer.
+struct TestSpawnerSystem : public ecs::System {
+    using Reads = ecs::Components<TestData, TestData1>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        auto& commands = access.Commands();
+        entity_query.View<const TestData>().Each([&commands](ecs::Entity, const TestData& td) {
+            const ecs::Entity spawned = commands.CreateEntity();
+            commands.AddComponent(spawned, TestData2{ td.x, 0.f, 0.f });
+            commands.AddComponent(spawned, Name{ "spawned" });
+        });
+        entity_query.View<const TestData1>().Each([&commands](ecs::Entity entity, const TestData1&) { commands.DestroyEntity(entity); });
+    }
+};
+
+// Creates an entity per step and names it from subflow tasks, which may record into the buffers of other workers.
+struct TestHandOverSystem : public ecs::System {
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        const ecs::Entity spawned = access.Commands().CreateEntity();
+        for (int i = 0; i < 8; ++i) subflow.emplace([&access, spawned]() { access.Commands().AddComponent(spawned, Name{ "handed over" }); });
+        subflow.join();
+    }
+};
+
+TEST_CASE("Command buffers", "[registry|command]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData1>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData2>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<Name>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<TestSpawnerSystem>());
+
+    auto sources = registry.CreateEntities(100, TestData{ 2.f });
+    auto doomed  = registry.CreateEntities(10, TestData1{});
+    registry.Run();
+
+    for (Entity entity : doomed) REQUIRE_FALSE(registry.IsAlive(entity));
+    for (Entity entity : sources) REQUIRE(registry.IsAlive(entity));
+    REQUIRE(registry.GetNumComponents<TestData1>() == 0);
+    REQUIRE(registry.GetNumComponents<TestData2>() == 100);
+    REQUIRE(registry.GetNumComponents<Name>() == 100);
+
+    // Commands recorded outside of systems are played back explicitly.
+    auto& commands = registry.Commands();
+    commands.AddComponent(sources[0], TestData{ 5.f });
+    commands.RemoveComponent<TestData>(sources[1]);
+    commands.RemoveComponent<TestData1>(sources[2]);
+    commands.DestroyEntity(doomed[0]);
+    REQUIRE_FALSE(commands.Empty());
+    REQUIRE_NOTHROW(registry.FlushCommands());
+    REQUIRE(commands.Empty());
+    REQUIRE(registry.GetComponent<TestData>(sources[0]).x == 5.f);
+    REQUIRE_FALSE(registry.HasComponent<TestData>(sources[1]));
+    REQUIRE(registry.IsAlive(sources[2]));
+
+    // Placeholders no buffer has handed out are rejected and all commands are dropped.
+    commands.AddComponent(MakeEntity(7, ~0u), TestData{});
+    REQUIRE_THROWS_AS(registry.FlushCommands(), std::runtime_error);
+    REQUIRE(commands.Empty());
+
+    // Placeholders resolve in the buffers of other workers.
+    Registry workers(4);
+    workers.RegisterComponent<Name>();
+    workers.RegisterSystem<TestHandOverSystem>();
+    workers.RunFor(3);
+    REQUIRE(workers.GetNumComponents<Name>() == 3);
+
+    // Commands for unregistered types or other storages fail the playback, which drops them, so later steps run again.
+    workers.RegisterComponent<TestData1, PackedComponentStorage<TestData1>>();
+    workers.Commands().AddComponent(workers.Commands().CreateEntity(), TestData{});
+    REQUIRE_THROWS_AS(workers.Run(), std::runtime_error);
+    REQUIRE_NOTHROW(workers.Run());
+    workers.Commands().AddComponent(workers.Commands().CreateEntity(), TestData1{});
+    REQUIRE_THROWS_AS(workers.Run(), std::runtime_error);
+    REQUIRE_NOTHROW(workers.Run());
+    // The names recorded during the failed steps are dropped along with the failing commands.
+    REQUIRE(workers.GetNumComponents<Name>() == 5);
+    REQUIRE(workers.GetNumComponents<TestData1>() == 0);
+}
+
+TEST_CASE("Repeated steps", "[registry|system]")
+{
+    using namespace ecs;
+    Registry registry;
+    registry.RegisterComponent<TestData>();
+    registry.RegisterComponent<TestData1>();
+    registry.RegisterComponent<TestData2>();
+    registry.RegisterComponent<Name>();
+
+    // Without systems, steps still play back commands.
+    registry.Commands().CreateEntity();
+    registry.RunFor(2);
+    REQUIRE(registry.Commands().Empty());
+    // Nor do background steps block the caller, e.g., on a predicate waiting for it.
+    std::atomic<bool> released{ false };
+    auto waiting = registry.RunAsyncUntil([&released]() {
+        while (!released) std::this_thread::yield();
+        return true;
+    });
+    released = true;
+    REQUIRE_NOTHROW(waiting.get());
+
+    registry.RegisterSystem<TestSpawnerSystem>();
+    registry.CreateEntities(100, TestData{ 2.f });
+
+    // Commands are played back after every step, so every step spawns another batch.
+    registry.RunFor(3);
+    REQUIRE(registry.GetNumComponents<TestData2>() == 300);
+    int num_steps = 0;
+    registry.RunUntil([&]() { return ++num_steps > 2; });
+    REQUIRE(registry.GetNumComponents<TestData2>() == 500);
+    registry.RunUntil([&]() { return registry.GetNumComponents<TestData2>() >= 800; });
+    REQUIRE(registry.GetNumComponents<TestData2>() == 800);
+
+    auto future = registry.RunAsync(2);
+    future.get();
+    REQUIRE(registry.GetNumComponents<TestData2>() == 1000);
+    registry.RunFor(0);
+    REQUIRE(registry.GetNumComponents<TestData2>() == 1000);
+}
+
+// Counts the TestData components added or changed and the Name chunks changed since its previous run.
+struct TestChangeCounterSystem : public ecs::System {
+    using Reads = ecs::Components<TestData, Name>;
+    size_t added = 0, changed = 0, changed_rows = 0;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        using namespace ecs;
+        added = changed = changed_rows = 0;
+        entity_query.View<const TestData>(Added<TestData>{}).Each([this](Entity, const TestData&) { ++added; });
+        for (auto it : entity_query.View<const TestData>(Changed<TestData>{})) changed += std::get<1>(it).x >= 0.f;
+        access.Archetypes().EachChunk<const Name>(Changed<Name>{}, entity_query.Since(), [this](size_t count, const Entity*, const Name*) { changed_rows += count; });
+    }
+};
+// Writes the TestData of a single entity every run.
+struct TestTouchSystem : public ecs::System {
+    using Writes = ecs::Components<TestData>;
+    ecs::Entity entity;
+    explicit TestTouchSystem(ecs::Entity entity) : entity(entity) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        access.Write<TestData>(entity).x += 1.f;
+    }
+};
+// Stamps the Name of every given entity from parallel tasks.
+struct TestParallelTouchSystem : public ecs::System {
+    using Writes = ecs::Components<Name>;
+    const std::vector<ecs::Entity>& entities;
+    explicit TestParallelTouchSystem(const std::vector<ecs::Entity>& entities) : entities(entities) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery& entity_query, tf::Subflow& subflow) override
+    {
+        auto& names = access.Write<Name>();
+        ecs::ParallelFor(subflow, nullptr, sizeof(ecs::Entity), entities.size(), 1, [this, &names, tick = access.GetTick()](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) names.MarkChanged(entities[i], tick);
+        });
+    }
+};
+
+TEST_CASE("Change detection", "[registry|system]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<Name>());
+    auto entities = registry.CreateEntities(10, TestData{ 0.f });
+    for (size_t i = 0; i < 3; ++i) registry.AddComponent<Name>(entities[i]).value = "named";
+
+    REQUIRE_NOTHROW(registry.RegisterSystem<TestChangeCounterSystem>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<TestTouchSystem>(entities[5]));
+    auto& counter = registry.GetSystem<TestChangeCounterSystem>();
+
+    // Everything is new to the first run.
+    registry.Run();
+    REQUIRE(counter.added == 10);
+    REQUIRE(counter.changed == 10);
+    REQUIRE(counter.changed_rows == 3);
+
+    // The writer ran after the counter, so its change shows up in the next run.
+    registry.Run();
+    REQUIRE(counter.added == 0);
+    REQUIRE(counter.changed == 1);
+    REQUIRE(counter.changed_rows == 0);
+    REQUIRE(registry.GetComponent<TestData>(entities[5]).x == 2.f);
+
+    // Changes between runs are seen by the next run.
+    registry.CreateEntity().AddComponent<TestData>();
+    registry.AddComponent<Name>(entities[4]);
+    registry.Run();
+    REQUIRE(counter.added == 1);
+    REQUIRE(counter.changed == 2);
+    REQUIRE(counter.changed_rows == 4);
+
+    // Archetype chunks are stamped by several tasks at once.
+    Registry parallel(4);
+    parallel.RegisterComponent<TestData>();
+    parallel.RegisterComponent<Name>();
+    auto named = parallel.CreateEntities(5000, Name{});
+    parallel.RegisterSystem<TestParallelTouchSystem>(named);
+    parallel.RegisterSystem<TestChangeCounterSystem>();
+    parallel.Run();
+    parallel.Run();
+    REQUIRE(parallel.GetSystem<TestChangeCounterSystem>().changed_rows == named.size());
+}
+
+TEST_CASE("Component ids", "[component]")
+{
+    using namespace ecs;
+    REQUIRE(GetComponentId<TestData>() == GetComponentId<const TestData>());
+    REQUIRE(GetComponentId<TestData>() != GetComponentId<TestData1>());
+    REQUIRE(GetComponentId<TestData>() != INVALID_COMPONENT_ID);
+
+    Registry registry;
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData1>());
+    const Entity entity = registry.CreateEntity().AddComponent<TestData1>().Build();
+    REQUIRE(registry.HasComponent<TestData1>(entity));
+    REQUIRE_THROWS_AS(registry.HasComponent<TestData2>(entity), std::runtime_error);
+}
+
+TEST_CASE("Cached queries", "[registry|query]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<TestData1>());
+    REQUIRE_NOTHROW(registry.RegisterComponent<Name>());
+
+    auto entities = registry.CreateEntities(10, TestData{ 1.f });
+    for (size_t i = 0; i < 5; ++i) registry.AddComponent<TestData1>(entities[i]);
+    registry.AddComponent<Name>(entities[0]);
+
+    // Entities existing at creation are picked up.
+    CachedQuery& query = registry.CreateQuery<TestData, TestData1>().Exclude<Name>();
+    REQUIRE(query.Size() == 4);
+    REQUIRE_FALSE(query.Contains(entities[0]));
+    REQUIRE(query.Contains(entities[1]));
+    REQUIRE_THROWS_AS(registry.CreateQuery<TestData2>(), std::runtime_error);
+
+    // Structural changes update the query.
+    registry.AddComponent<TestData1>(entities[9]);
+    registry.RemoveComponent<TestData1>(entities[1]);
+    registry.AddComponent<Name>(entities[2]);
+    registry.RemoveComponent<Name>(entities[0]);
+    registry.DestroyEntity(entities[3]);
+    auto created = registry.CreateEntities(3, TestData{ 2.f }, TestData1{});
+    REQUIRE(query.Size() == 6);
+    for (Entity entity : { entities[0], entities[4], entities[9], created[0], created[1], created[2] }) REQUIRE(query.Contains(entity));
+
+    // So does command buffer playback.
+    registry.Commands().RemoveComponent<TestData>(entities[4]);
+    registry.Commands().DestroyEntity(created[0]);
+    registry.FlushCommands();
+    REQUIRE(query.Size() == 4);
+    REQUIRE_FALSE(query.Contains(entities[4]));
+
+    float sum = 0.f;
+    query.Each<const TestData, TestData1>([&sum](Entity, const TestData& td, TestData1& td1) { sum += td.x; td1.x = td.x; });
+    REQUIRE(sum == 6.f);
+}
+
+namespace
+{
+// Upstream resource counting the bytes currently allocated through it.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t allocated = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override { allocated += bytes; return std::pmr::new_delete_resource()->allocate(bytes, alignment); }
+    void  do_deallocate(void* p, size_t bytes, size_t alignment) override { allocated -= bytes; std::pmr::new_delete_resource()->deallocate(p, bytes, alignment); }
+    bool  do_is_equal(const std::pmr::memory_resource& rhs) const noexcept override { return this == &rhs; }
+};
+} // namespace
+
+TEST_CASE("Memory resources", "[registry|memory]")
+{
+    using namespace ecs;
+
+    SECTION("Linear arena") {
+        CountingResource upstream;
+        {
+            LinearArena arena(256, &upstream);
+            void* a = arena.allocate(3, 1);
+            void* b = arena.allocate(16, 16);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 16 == 0);
+            REQUIRE(a != b);
+            // Oversized requests get a block of their own.
+            REQUIRE(arena.allocate(1024, 8) != nullptr);
+            const size_t capacity = arena.Capacity();
+            REQUIRE(upstream.allocated == capacity);
+
+            // After a reset the same memory is handed out again without touching upstream.
+            arena.Reset();
+            REQUIRE(arena.allocate(3, 1) == a);
+            REQUIRE(arena.allocate(1024, 8) != nullptr);
+            REQUIRE(arena.Capacity() == capacity);
+        }
+        REQUIRE(upstream.allocated == 0);
+    }
+
+    SECTION("Registry storage resource") {
+        CountingResource upstream;
+        {
+            Registry registry(&upstream, 1);
+            registry.RegisterComponent<TestData>();
+            registry.RegisterComponent<TestData1, SparseComponentStorage<TestData1>>();
+            registry.CreateEntities(1000, TestData{ 1.f }, TestData1{});
+            REQUIRE(upstream.allocated > 1000 * (sizeof(Entity) + sizeof(TestData) + sizeof(TestData1)));
+        }
+        REQUIRE(upstream.allocated == 0);
+    }
+
+    SECTION("Frame resource") {
+        Registry registry(1);
+        std::pmr::memory_resource& frame = registry.FrameResource();
+        void* first = frame.allocate(64, 8);
+        REQUIRE(frame.allocate(64, 8) != first);
+        // Every Run() step starts from an empty arena.
+        registry.Run();
+        REQUIRE(frame.allocate(64, 8) == first);
+    }
+}
+
+struct Body { float x, y, z; double mass; };
+
+template <>
+struct ecs::SoALayout<Body> : ecs::Fields<&Body::x, &Body::y, &Body::z, &Body::mass> {};
+template <>
+struct ecs::ComponentStorageTraits<Body> { using StorageType = SoAComponentStorage<Body>; };
+
+struct TestGravitySystem : public ecs::System {
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        auto y    = access.WriteColumn<&Body::y>();
+        auto mass = access.ReadColumn<&Body::mass>();
+        for (size_t i = 0; i < y.Size(); ++i) y[i] -= float(mass[i]);
+    }
+};
+
+TEST_CASE("SoA component storage", "[component]")
+{
+    using namespace ecs;
+    using Storage = SoAComponentStorage<Body>;
+    Storage storage;
+
+    for (Entity e = 0; e < 100; ++e) storage.AddComponent(e) = Body{ float(e), 0.f, 0.f, 1.0 };
+    storage.GetComponent(5).Get<&Body::z>() = 7.f;
+    const Body body = storage.GetComponent(5);
+    REQUIRE(body.x == 5.f);
+    REQUIRE(body.z == 7.f);
+    REQUIRE_THROWS_AS(storage.AddComponent(5), std::runtime_error);
+
+    // Columns are aligned for vector loads and stay aligned with the dense entities after removals.
+    for (Entity e = 0; e < 100; e += 2) storage.RemoveComponent(e);
+    REQUIRE_THROWS_AS(storage.GetComponent(0), std::runtime_error);
+    auto x = storage.Column<&Body::x>();
+    REQUIRE(x.Size() == 50);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(x.Data()) % Storage::COLUMN_ALIGNMENT == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(storage.Column<&Body::mass>().Data()) % Storage::COLUMN_ALIGNMENT == 0);
+    for (ComponentIndex i = 0; i < storage.Size(); ++i) {
+        REQUIRE(storage.Index(storage.Entities()[i]) == i);
+        REQUIRE(x[i] == float(storage.Entities()[i]));
+    }
+
+    // Systems reach the columns through ComponentAccess.
+    Registry registry;
+    registry.RegisterComponent<Body>();
+    registry.RegisterSystem<TestGravitySystem>();
+    registry.DeclareAccess<TestGravitySystem>(Components<>{}, Components<Body>{});
+    auto entities = registry.CreateEntities(10, Body{ 0.f, 10.f, 0.f, 2.0 });
+    const Entity single = registry.CreateEntity().Build();
+    registry.AddComponent<Body>(single) = Body{ 0.f, 4.f, 0.f, 1.0 };
+    registry.Run();
+    REQUIRE(Body(registry.GetComponent<Body>(entities[3])).y == 8.f);
+    REQUIRE(registry.GetComponent<Body>(single).Get<&Body::y>() == 3.f);
+}
+
+TEST_CASE("Snapshots", "[registry|snapshot]")
+{
+    using namespace ecs;
+    auto register_components = [](Registry& registry) {
+        registry.RegisterComponent<TestData, PackedComponentStorage<TestData>>();
+        registry.RegisterComponent<TestData1>();
+        registry.RegisterComponent<PagedData>();
+        registry.RegisterComponent<Body>();
+    };
+    Registry registry;
+    register_components(registry);
+
+    std::vector<Entity> entities;
+    for (int i = 0; i < 100; ++i) {
+        const Entity entity = registry.CreateEntity().Build();
+        registry.AddComponent<TestData, PackedComponentStorage<TestData>>(entity).x = float(i);
+        if (i % 2 == 0) registry.AddComponent<TestData1>(entity) = TestData1{ float(i), 1.f };
+        if (i % 3 == 0) registry.AddComponent<PagedData>(entity).x = float(i);
+        if (i % 5 == 0) registry.AddComponent<Body>(entity) = Body{ float(i), 0.f, 0.f, 2.0 };
+        entities.push_back(entity);
+    }
+    for (int i = 0; i < 100; i += 7) registry.DestroyEntity(entities[i]);
+    CachedQuery& saved_query = registry.CreateQuery<TestData1, PagedData>();
+
+    std::stringstream stream;
+    REQUIRE_NOTHROW(registry.SaveSnapshot(stream));
+    const std::string bytes = stream.str();
+
+    auto check = [&](Registry& loaded) {
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(loaded.IsAlive(entities[i]) == (i % 7 != 0));
+            if (i % 7 == 0) continue;
+            REQUIRE(loaded.GetComponent<TestData, PackedComponentStorage<TestData>>(entities[i]).x == float(i));
+            REQUIRE(loaded.HasComponent<TestData1>(entities[i]) == (i % 2 == 0));
+            REQUIRE(loaded.HasComponent<PagedData>(entities[i]) == (i % 3 == 0));
+            if (i % 2 == 0) REQUIRE(loaded.GetComponent<TestData1>(entities[i]).x == float(i));
+            if (i % 3 == 0) REQUIRE(loaded.GetComponent<PagedData>(entities[i]).x == float(i));
+            if (i % 5 == 0) REQUIRE(Body(loaded.GetComponent<Body>(entities[i])).x == float(i));
+        }
+        // Free slots are restored, so new entities reuse them with the same versions as in the saved registry.
+        REQUIRE(loaded.CreateEntity().Build() == registry.CreateEntity().Build());
+    };
+
+    SECTION("From memory") {
+        Registry loaded;
+        register_components(loaded);
+        CachedQuery& query = loaded.CreateQuery<TestData1, PagedData>();
+        REQUIRE_NOTHROW(loaded.LoadSnapshot(bytes.data(), bytes.size()));
+        REQUIRE(query.Size() == saved_query.Size());
+        check(loaded);
+    }
+
+    SECTION("From a memory-mapped file") {
+        const std::string path = "ecs_snapshot_test.bin";
+        registry.SaveSnapshot(path);
+        Registry loaded;
+        register_components(loaded);
+        REQUIRE_NOTHROW(loaded.LoadSnapshot(path));
+        std::remove(path.c_str());
+        check(loaded);
+    }
+
+    SECTION("Mismatches") {
+        Registry missing;
+        missing.RegisterComponent<TestData, PackedComponentStorage<TestData>>();
+        REQUIRE_THROWS_AS(missing.LoadSnapshot(bytes.data(), bytes.size()), std::runtime_error);
+        Registry other_storage;
+        register_components(other_storage);
+        REQUIRE_THROWS_AS(other_storage.LoadSnapshot(bytes.data(), bytes.size() / 2), std::runtime_error);
+        REQUIRE_THROWS_AS(other_storage.LoadSnapshot("does/not/exist.bin"), std::runtime_error);
+
+        Registry archetypes;
+        archetypes.RegisterComponent<ArchetypeData>();
+        REQUIRE_THROWS_AS(archetypes.SaveSnapshot(stream), std::runtime_error);
+    }
+}
+
+TEST_CASE("Delta snapshots", "[registry|snapshot]")
+{
+    using namespace ecs;
+    auto register_components = [](Registry& registry) {
+        registry.RegisterComponent<TestData, PackedComponentStorage<TestData>>();
+        registry.RegisterComponent<TestData1>();
+        registry.RegisterComponent<Body>();
+    };
+    Registry source, replica;
+    register_components(source);
+    register_components(replica);
+
+    auto entities = source.CreateEntities(1000, TestData1{ 1.f, 2.f });
+    for (size_t i = 0; i < entities.size(); i += 2) source.AddComponent<TestData, PackedComponentStorage<TestData>>(entities[i]).x = float(i);
+    for (size_t i = 0; i < entities.size(); i += 10) source.AddComponent<Body>(entities[i]) = Body{ 1.f, 2.f, 3.f, 4.0 };
+    // Handles that were never created have no slot to stamp.
+    REQUIRE_THROWS_AS(source.AddComponent<Body>(Entity(100000)), std::runtime_error);
+    REQUIRE_THROWS_AS(source.AddComponents<Body>(MakeEntity(1000, 0)), std::runtime_error);
+    REQUIRE_THROWS_AS(source.RemoveComponent<TestData1>(MakeEntity(5000, 3)), std::runtime_error);
+
+    auto replicate = [&](Tick since) {
+        std::stringstream stream;
+        const Tick tick = source.SaveDelta(stream, since);
+        const std::string delta = stream.str();
+        replica.ApplyDelta(delta.data(), delta.size());
+        return std::make_pair(tick, delta.size());
+    };
+    auto check = [&]() {
+        for (size_t i = 0; i < entities.size(); ++i) {
+            REQUIRE(replica.IsAlive(entities[i]) == source.IsAlive(entities[i]));
+            if (!source.IsAlive(entities[i])) continue;
+            REQUIRE(replica.HasComponent<TestData>(entities[i]) == source.HasComponent<TestData>(entities[i]));
+            REQUIRE(replica.HasComponent<Body>(entities[i]) == source.HasComponent<Body>(entities[i]));
+            REQUIRE(replica.GetComponent<TestData1>(entities[i]).y == source.GetComponent<TestData1>(entities[i]).y);
+            if (source.HasComponent<TestData>(entities[i])) {
+                REQUIRE(replica.GetComponent<TestData, PackedComponentStorage<TestData>>(entities[i]).x ==
+                        source.GetComponent<TestData, PackedComponentStorage<TestData>>(entities[i]).x);
+            }
+        }
+    };
+
+    // A delta since tick 0 initializes the replica.
+    CachedQuery& query = replica.CreateQuery<TestData1, Body>();
+    auto [tick, full_size] = replicate(0);
+    check();
+    REQUIRE(query.Size() == 100);
+
+    // Only changes after the previous delta are sent.
+    source.Commands().AddComponent(entities[1], TestData1{ 5.f, 6.f });
+    source.Commands().RemoveComponent<Body>(entities[10]);
+    source.Commands().DestroyEntity(entities[20]);
+    source.Commands().AddComponent(entities[3], Body{ 7.f, 0.f, 0.f, 1.0 });
+    source.FlushCommands();
+    entities.push_back(source.CreateEntity().Build());
+    source.AddComponent<TestData1>(entities.back()) = TestData1{ 8.f, 9.f };
+    auto [next_tick, delta_size] = replicate(tick);
+    REQUIRE(next_tick > tick);
+    REQUIRE(delta_size * 20 < full_size);
+    check();
+    REQUIRE(replica.GetComponent<TestData1>(entities[1]).x == 5.f);
+    REQUIRE(query.Size() == 99);
+
+    // Nothing changed, nothing but the headers is sent, and applying a stale delta fails.
+    auto [last_tick, empty_size] = replicate(next_tick);
+    REQUIRE(empty_size < 64);
+    std::stringstream stale;
+    Registry other;
+    other.RegisterComponent<TestData1>();
+    source.SaveDelta(stale, 0);
+    REQUIRE_THROWS_AS(other.ApplyDelta(stale.str().data(), stale.str().size()), std::runtime_error);
+}
+
+TEST_CASE("Sorting and groups", "[component|group]")
+{
+    using namespace ecs;
+    auto by_x = [](const TestData& lhs, const TestData& rhs) { return lhs.x < rhs.x; };
+
+    SECTION("Storage sorting")
+    {
+        PackedComponentStorage<TestData> packed;
+        SparseComponentStorage<TestData> sparse;
+        PagedComponentStorage<TestData> paged;
+        for (Entity e = 0; e < 100; ++e) {
+            packed.AddComponent(e).x = float((e * 37) % 100);
+            sparse.AddComponent(99 - e).x = float(e);
+            if (e % 3 == 0) paged.AddComponent(e).x = float(e);
+        }
+        const TestData* address = &paged.GetComponent(3);
+        packed.Sort(by_x);
+        for (ComponentIndex i = 0; i < packed.Size(); ++i) {
+            REQUIRE(packed[i].x == float(i));
+            REQUIRE(packed.Index(packed.Entities()[i]) == i);
+            REQUIRE(packed.GetComponent(packed.Entities()[i]).x == float((packed.Entities()[i] * 37) % 100));
+        }
+        // Entities of packed come first in sparse, the others follow.
+        paged.SortAs(packed);
+        sparse.SortAs(packed);
+        for (ComponentIndex i = 0; i < sparse.Size(); ++i) {
+            REQUIRE(sparse.Entities()[i] == packed.Entities()[i]);
+            REQUIRE(sparse[i].x == float(99 - sparse.Entities()[i]));
+        }
+        for (ComponentIndex i = 1; i < paged.Size(); ++i) {
+            REQUIRE(packed.Index(paged.Entities()[i - 1]) < packed.Index(paged.Entities()[i]));
+            REQUIRE(paged.Index(paged.Entities()[i]) == i);
+        }
+        REQUIRE(&paged.GetComponent(3) == address);
+    }
+
+    SECTION("Owning groups")
+    {
+        Registry registry;
+        registry.RegisterComponent<TestData>();
+        registry.RegisterComponent<TestData1>();
+        registry.RegisterComponent<TestData2>();
+        std::vector<Entity> entities;
+        for (int i = 0; i < 100; ++i) {
+            const Entity entity = registry.CreateEntity().Build();
+            entities.push_back(entity);
+            if (i % 2 == 0) registry.AddComponent<TestData>(entity).x = float(i);
+            if (i % 3 == 0) registry.AddComponent<TestData1>(entity).x = float(i);
+        }
+        auto& group = registry.CreateGroup<TestData, TestData1>();
+        // Every component at the same group index belongs to the same entity.
+        auto check = [&](size_t expected) {
+            REQUIRE(group.Size() == expected);
+            size_t count = 0;
+            group.Each([&](Entity entity, TestData& td, TestData1& td1) {
+                REQUIRE(td.x == td1.x);
+                REQUIRE(group.Entities()[count++] == entity);
+                REQUIRE(group.Contains(entity));
+            });
+            REQUIRE(count == expected);
+        };
+        check(17);
+        REQUIRE_THROWS_AS(registry.CreateGroup<TestData1>(), std::runtime_error);
+        REQUIRE_THROWS_AS(registry.SortComponents<TestData>(by_x), std::runtime_error);
+        REQUIRE_NOTHROW(registry.SortComponentsAs<TestData2, TestData>());
+
+        registry.AddComponent<TestData1>(entities[2]).x = 2.f;
+        check(18);
+        registry.RemoveComponent<TestData>(entities[0]);
+        REQUIRE_FALSE(group.Contains(entities[0]));
+        check(17);
+        registry.DestroyEntity(entities[6]);
+        check(16);
+        registry.Commands().RemoveComponent<TestData1>(entities[12]);
+        registry.Commands().AddComponent(entities[4], TestData1{ 4.f, 0.f });
+        registry.FlushCommands();
+        check(16);
+        REQUIRE(group.Contains(entities[4]));
+
+        group.Sort<TestData1>([](const TestData1& lhs, const TestData1& rhs) { return lhs.x > rhs.x; });
+        check(16);
+        for (size_t i = 1; i < group.Size(); ++i) REQUIRE(registry.GetComponent<TestData>(group.Entities()[i - 1]).x > registry.GetComponent<TestData>(group.Entities()[i]).x);
+
+        // Loading a snapshot packs the group again.
+        std::stringstream stream;
+        registry.SaveSnapshot(stream);
+        registry.RemoveComponent<TestData>(entities[4]);
+        const std::string snapshot = stream.str();
+        registry.LoadSnapshot(snapshot.data(), snapshot.size());
+        check(16);
+    }
+}
+
+struct TestQuerySystem : public ecs::System {
+    void Run(ecs::ComponentAccess&, ecs::EntityQuery& query, tf::Subflow&) override { query(); }
+};
+
+TEST_CASE("Profiler", "[profiler]")
+{
+    using namespace ecs;
+    using Kind = ProfileEvent::Kind;
+    Profiler profiler(2, 8);
+    REQUIRE(profiler.Events().empty());
+
+    // Two systems overlapping for 20ns, followed by a single one.
+    profiler.BeginFrame();
+    const auto start = profiler.Now();
+    profiler.Record("A", Kind::SYSTEM, start, start + 30, 0, 5);
+    profiler.Record("B", Kind::SYSTEM, start + 10, start + 30, 1);
+    profiler.Record("C", Kind::SYSTEM, start + 30, start + 40, 1);
+    profiler.EndFrame();
+    const FrameProfile frame = profiler.LastFrame();
+    REQUIRE(frame.frame == 1);
+    REQUIRE(frame.systems_ns == 60);
+    REQUIRE(frame.worker_busy_ns[0] == 30);
+    REQUIRE(frame.worker_busy_ns[1] == 30);
+    REQUIRE(frame.serialized_ns == frame.duration_ns - 20);
+    REQUIRE(frame.Utilization(0) > 0.);
+
+    std::stringstream trace;
+    profiler.WriteChromeTrace(trace);
+    REQUIRE(trace.str().find("{\"traceEvents\":[{\"name\":\"A\",\"cat\":\"system\"") == 0);
+    REQUIRE(trace.str().find("\"entities\":5") != std::string::npos);
+
+    // The ring buffer keeps the latest events only.
+    for (int i = 0; i < 10; ++i) profiler.Record("D", Kind::SYSTEM, 0, 1, 0);
+    const auto events = profiler.Events();
+    REQUIRE(events.size() == profiler.Capacity());
+    REQUIRE(std::string(events.front().name) == "D");
+
+#if ECS_PROFILING
+    Registry registry;
+    registry.RegisterSystem<TestQuerySystem>();
+    registry.CreateEntities(10);
+    registry.Run();
+    registry.Run();
+    const Profiler& registry_profiler = registry.GetProfiler();
+    REQUIRE(registry_profiler.CurrentFrame() == 2);
+    size_t num_systems = 0;
+    for (const ProfileEvent& event : registry_profiler.Events()) {
+        if (event.kind != Kind::SYSTEM) continue;
+        ++num_systems;
+        REQUIRE(std::string(event.name) == "TestQuerySystem");
+        REQUIRE(event.entities == 10);
+        REQUIRE(event.worker >= 0);
+    }
+    REQUIRE(num_systems == 2);
+    REQUIRE(registry_profiler.LastFrame().duration_ns > 0);
+#endif
+}
+
+struct Enemy   {};
+struct Visible {};
+template <int N>
+struct ManyTag {};
+
+template <int... Ns>
+void RegisterManyTags(ecs::Registry& registry, std::integer_sequence<int, Ns...>)
+{
+    (registry.RegisterComponent<ManyTag<Ns>>(), ...);
+}
+
+TEST_CASE("Tags and signatures", "[registry|tag]")
+{
+    using namespace ecs;
+    static_assert(std::is_same_v<DefaultStorage<Enemy>, TagStorage<Enemy>>);
+    auto register_components = [](Registry& registry) {
+        registry.RegisterComponent<TestData>();
+        registry.RegisterComponent<Enemy>();
+        registry.RegisterComponent<Visible>();
+    };
+    Registry registry;
+    register_components(registry);
+    auto entities = registry.CreateEntities(200, TestData{ 1.f });
+    for (size_t i = 0; i < entities.size(); i += 2) registry.AddComponent<Enemy>(entities[i]);
+    for (size_t i = 0; i < entities.size(); i += 3) registry.AddComponent<Visible>(entities[i]);
+    REQUIRE(registry.GetNumComponents<Enemy>() == 100);
+    REQUIRE(registry.HasComponent<Enemy>(entities[0]));
+    REQUIRE_FALSE(registry.HasComponent<Enemy>(entities[1]));
+    REQUIRE_THROWS_AS(registry.AddComponent<Enemy>(entities[0]), std::runtime_error);
+
+    EntityQuery query(registry);
+    auto count = [&]() { return std::make_pair(query.Match<Enemy, Visible>().Entities().size(), query.Match<TestData>(Without<Enemy>{}).Entities().size()); };
+    REQUIRE(count() == std::make_pair(size_t(34), size_t(100)));
+    const EntityManager matched = query.Match<Enemy, Visible>();
+    for (Entity entity : matched.Entities()) REQUIRE(GetEntityIndex(entity) % 6 == 0);
+    // Tags can be used in the filters of views and in cached queries.
+    size_t num_viewed = 0;
+    query.View<TestData>(Without<Enemy>{}).Each([&](Entity, TestData&) { ++num_viewed; });
+    REQUIRE(num_viewed == 100);
+    CachedQuery& cached = registry.CreateQuery<TestData, Visible>().Exclude<Enemy>();
+    REQUIRE(cached.Size() == 33);
+
+    registry.RemoveComponent<Enemy>(entities[0]);
+    registry.DestroyEntity(entities[6]);
+    REQUIRE(registry.GetNumComponents<Enemy>() == 98);
+    REQUIRE(count() == std::make_pair(size_t(32), size_t(101)));
+    REQUIRE(cached.Size() == 34);
+    // Reused slots start without tags.
+    const Entity reused = registry.CreateEntity().Build();
+    REQUIRE(GetEntityIndex(reused) == 6);
+    REQUIRE_FALSE(registry.HasComponent<Visible>(reused));
+    // Stale handles to the reused slot cannot change the signature of the new entity.
+    REQUIRE_THROWS_AS(registry.AddComponent<Visible>(entities[6]), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.AddComponents<TestData>(entities[6]), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.RemoveComponent<TestData>(entities[6]), std::runtime_error);
+    REQUIRE_FALSE(registry.HasComponent<TestData>(reused));
+    const EntityManager with_data = query.Match<TestData>();
+    REQUIRE(std::find(with_data.Entities().begin(), with_data.Entities().end(), reused) == with_data.Entities().end());
+
+    auto& commands = registry.Commands();
+    commands.AddComponent(entities[1], Enemy{});
+    commands.RemoveComponent<Visible>(entities[3]);
+    registry.FlushCommands();
+    REQUIRE(registry.HasComponent<Enemy>(entities[1]));
+    REQUIRE(count() == std::make_pair(size_t(32), size_t(100)));
+
+    SECTION("Snapshots")
+    {
+        std::stringstream stream;
+        registry.SaveSnapshot(stream);
+        const std::string snapshot = stream.str();
+        Registry loaded;
+        register_components(loaded);
+        loaded.LoadSnapshot(snapshot.data(), snapshot.size());
+        EntityQuery loaded_query(loaded);
+        REQUIRE(loaded.GetNumComponents<Enemy>() == registry.GetNumComponents<Enemy>());
+        REQUIRE(loaded_query.Match<Enemy, Visible>().Entities().size() == 32);
+        REQUIRE(loaded_query.Match<TestData>(Without<Enemy>{}).Entities().size() == 100);
+    }
+
+    SECTION("Wide signatures")
+    {
+        // Registering more than 64 types widens the signatures of existing entities.
+        RegisterManyTags(registry, std::make_integer_sequence<int, 70>{});
+        REQUIRE(count() == std::make_pair(size_t(32), size_t(100)));
+        registry.AddComponent<ManyTag<69>>(entities[12]);
+        registry.AddComponent<ManyTag<69>>(entities[13]);
+        REQUIRE(query.Match<ManyTag<69>, Enemy>().Entities().size() == 1);
+        REQUIRE(query.Match<ManyTag<69>>(Without<ManyTag<0>, Enemy>{}).Entities().size() == 1);
+        REQUIRE(count() == std::make_pair(size_t(32), size_t(100)));
+    }
+
+    REQUIRE_THROWS_AS(query.Match<TestData2>(), std::runtime_error);
+}
+
+struct Node { float local, world; };
+
+template <>
+struct ecs::ComponentStorageTraits<Node> { using StorageType = HierarchyStorage<Node>; };
+
+TEST_CASE("Hierarchies", "[component|hierarchy]")
+{
+    using namespace ecs;
+    auto propagate = [](Node& node, const Node* parent) { node.world = node.local + (parent ? parent->world : 0.f); };
+
+    SECTION("Breadth-first layout")
+    {
+        HierarchyStorage<Node> nodes;
+        for (Entity e = 0; e < 1000; ++e) nodes.AddComponent(e) = Node{ 1.f, 0.f };
+        // Every node but the first ten gets an earlier one as parent.
+        for (Entity e = 10; e < 1000; ++e) nodes.SetParent(e, (e * 7919) % e);
+
+        // world is the level of a node + 1, parents precede their children and siblings are contiguous.
+        auto check = [&]() {
+            size_t level = 0;
+            for (ComponentIndex i = 0; i < nodes.Size(); ++i) {
+                while (i >= nodes.LevelEnd(level)) ++level;
+                const Entity parent = nodes.GetParent(nodes.Entities()[i]);
+                REQUIRE(nodes[i].world == float(level + 1));
+                REQUIRE((parent == INVALID_ENTITY) == (level == 0));
+                if (parent == INVALID_ENTITY) continue;
+                REQUIRE(nodes.Index(parent) < i);
+                REQUIRE(nodes.ParentAt(i) == &nodes.GetComponent(parent));
+            }
+            for (Entity entity : nodes.Entities()) {
+                ComponentIndex previous = INVALID_COMPONENT_INDEX;
+                nodes.EachChild(entity, [&](Entity child) {
+                    REQUIRE(nodes.GetParent(child) == entity);
+                    if (previous != INVALID_COMPONENT_INDEX) REQUIRE(nodes.Index(child) == previous + 1);
+                    previous = nodes.Index(child);
+                });
+            }
+        };
+        nodes.Propagate(propagate);
+        REQUIRE(nodes.LevelEnd(0) == 10);
+        check();
+
+        REQUIRE_THROWS_AS(nodes.SetParent(0, 999), std::runtime_error);
+        REQUIRE_THROWS_AS(nodes.SetParent(5, 5), std::runtime_error);
+        REQUIRE_THROWS_AS(nodes.SetParent(5, 1000), std::runtime_error);
+        // Reparent a subtree below the deepest node, turn a node into a root and drop nodes with children.
+        const Entity deepest = nodes.Entities()[nodes.Size() - 1];
+        nodes.SetParent(10, deepest);
+        nodes.SetParent(500, INVALID_ENTITY);
+        REQUIRE(nodes.GetParent(10) == deepest);
+        nodes.RemoveComponent(1);
+        nodes.RemoveComponent(2);
+        nodes.Propagate(propagate);
+        REQUIRE(nodes.Size() == 998);
+        check();
+        // Drop the nodes of the last level.
+        for (Entity e = 0; e < 1000; ++e) {
+            if (e != deepest && nodes.HasComponent(e) && nodes.Index(e) >= nodes.LevelBegin(nodes.NumLevels() - 1)) nodes.RemoveComponent(e);
+        }
+        nodes.Propagate(propagate);
+        check();
+    }
+
+    SECTION("Registry")
+    {
+        Registry registry;
+        registry.RegisterComponent<Node>();
+        auto entities = registry.CreateEntities(1000, Node{ 1.f, 0.f });
+        for (size_t i = 10; i < entities.size(); ++i) registry.SetParent<Node>(entities[i], entities[(i * 7919) % i]);
+        registry.DestroyEntity(entities[3]);
+        REQUIRE_THROWS_AS(registry.SetParent<Node>(entities[0], entities[3]), std::runtime_error);
+
+        class PropagateSystem : public System {
+        public:
+            void Run(ComponentAccess& access, EntityQuery&, tf::Subflow& subflow) override
+            {
+                ParallelPropagate(subflow, access.Write<Node>(), [](Node& node, const Node* parent) {
+                    node.world = node.local + (parent ? parent->world : 0.f);
+                }, 16);
+            }
+        };
+        registry.RegisterSystem<PropagateSystem>();
+        auto check = [&](Registry& registry) {
+            for (Entity entity : entities) {
+                if (!registry.IsAlive(entity)) continue;
+                float depth = 1.f;
+                for (Entity parent = registry.GetParent<Node>(entity); parent != INVALID_ENTITY; parent = registry.GetParent<Node>(parent)) depth += 1.f;
+                REQUIRE(registry.GetComponent<Node>(entity).world == depth);
+            }
+        };
+        registry.Run();
+        check(registry);
+
+        // Snapshots keep the hierarchy including the order of siblings.
+        std::stringstream stream;
+        registry.SaveSnapshot(stream);
+        const std::string snapshot = stream.str();
+        Registry loaded;
+        loaded.RegisterComponent<Node>();
+        loaded.LoadSnapshot(snapshot.data(), snapshot.size());
+        loaded.RegisterSystem<PropagateSystem>();
+        for (Entity entity : entities) {
+            if (registry.IsAlive(entity)) REQUIRE(loaded.GetParent<Node>(entity) == registry.GetParent<Node>(entity));
+        }
+        loaded.Run();
+        check(loaded);
+    }
+}
+
+struct Collider { float x, y, z; };
+struct Marker2D { float u, v; };
+
+template <>
+struct ecs::SpatialLayout<Collider> : ecs::Fields<&Collider::x, &Collider::y, &Collider::z> {};
+template <>
+struct ecs::SpatialLayout<Marker2D> : ecs::Fields<&Marker2D::u, &Marker2D::v> {};
+template <>
+struct ecs::ComponentStorageTraits<Collider> { using StorageType = SpatialHashStorage<Collider>; };
+
+// Counts colliding pairs on a lattice through the parallel pair query.
+class CollisionSystem : public ecs::System {
+public:
+    using Writes = ecs::Components<Collider>;
+    explicit CollisionSystem(std::atomic<int>& count) : m_count(count) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow& subflow) override
+    {
+        auto& colliders = access.Write<Collider>();
+        colliders.Update();
+        ecs::ParallelPairs(subflow, colliders, 1.f, [this](ecs::Entity, ecs::Entity) { ++m_count; }, 4);
+    }
+private:
+    std::atomic<int>& m_count;
+};
+
+// Lifts the colliders of the upper half of a lattice from parallel tasks, stamping each of them.
+class LiftSystem : public ecs::System {
+public:
+    using Writes = ecs::Components<Collider>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow& subflow) override
+    {
+        auto& colliders = access.Write<Collider>();
+        ecs::ParallelEach(subflow, colliders, [&colliders, tick = access.GetTick()](ecs::Entity entity, Collider& collider) {
+            if (collider.y < 5.f) return;
+            collider.z += 100.f;
+            colliders.MarkChanged(entity, tick);
+        }, 16);
+    }
+};
+
+// Counts the colliders around a point after moving them to their cells, run after LiftSystem.
+class RadiusSystem : public ecs::System {
+public:
+    using Writes = ecs::Components<Collider>;
+    explicit RadiusSystem(size_t& count) : m_count(count) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        auto& colliders = access.Write<Collider>();
+        colliders.Update();
+        m_count = 0;
+        colliders.QueryRadius({ 50.f, 7.f, 100.f }, 60.f, [this](ecs::Entity) { ++m_count; });
+    }
+private:
+    size_t& m_count;
+};
+
+TEST_CASE("Spatial hash storage", "[component|spatial]")
+{
+    using namespace ecs;
+    SpatialHashStorage<Collider> colliders;
+    colliders.SetCellSize(4.f);
+    auto coordinate = [](Entity e, uint64_t salt) { return float((e * 2654435761u * salt + salt) % 2000) / 20.f - 50.f; };
+    for (Entity e = 0; e < 500; ++e) colliders.AddComponent(e) = Collider{ coordinate(e, 1), coordinate(e, 3), coordinate(e, 7) };
+    colliders.Update();
+
+    auto distance_sq = [&](Entity e, const SpatialVector& p) {
+        const Collider& c = colliders.GetComponent(e);
+        return (c.x - p[0]) * (c.x - p[0]) + (c.y - p[1]) * (c.y - p[1]) + (c.z - p[2]) * (c.z - p[2]);
+    };
+    // Compare every query against checking all components.
+    auto check = [&]() {
+        const SpatialVector center{ 3.f, -7.f, 11.f };
+        std::vector<Entity> found, expected;
+        colliders.QueryRadius(center, 15.f, [&](Entity e) { found.push_back(e); });
+        for (Entity e : colliders.Entities()) {
+            if (distance_sq(e, center) <= 225.f) expected.push_back(e);
+        }
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(!expected.empty());
+        REQUIRE(found == expected);
+
+        found.clear();
+        expected.clear();
+        colliders.QueryBox({ -20.f, -10.f, 0.f }, { 5.f, 30.f, 50.f }, [&](Entity e) { found.push_back(e); });
+        for (Entity e : colliders.Entities()) {
+            const Collider& c = colliders.GetComponent(e);
+            if (c.x >= -20.f && c.x <= 5.f && c.y >= -10.f && c.y <= 30.f && c.z >= 0.f && c.z <= 50.f) expected.push_back(e);
+        }
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(found == expected);
+
+        for (size_t k : { size_t(1), size_t(10), size_t(1000) }) {
+            found.clear();
+            colliders.QueryNearest(center, k, found);
+            expected.assign(colliders.Entities().begin(), colliders.Entities().end());
+            std::sort(expected.begin(), expected.end(), [&](Entity a, Entity b) { return distance_sq(a, center) < distance_sq(b, center); });
+            expected.resize(std::min(k, expected.size()));
+            REQUIRE(found.size() == expected.size());
+            for (size_t i = 0; i < found.size(); ++i) REQUIRE(distance_sq(found[i], center) == distance_sq(expected[i], center));
+        }
+
+        std::vector<std::pair<Entity, Entity>> pairs, expected_pairs;
+        colliders.ForEachPair(6.f, [&](Entity a, Entity b) { pairs.emplace_back(std::min(a, b), std::max(a, b)); });
+        for (Entity a : colliders.Entities()) {
+            for (Entity b : colliders.Entities()) {
+                if (a < b && distance_sq(a, { colliders.GetComponent(b).x, colliders.GetComponent(b).y, colliders.GetComponent(b).z }) <= 36.f) expected_pairs.emplace_back(a, b);
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+        std::sort(expected_pairs.begin(), expected_pairs.end());
+        REQUIRE(!expected_pairs.empty());
+        REQUIRE(pairs == expected_pairs);
+    };
+    check();
+
+    // Moved components are found at their new positions once stamped as changed and updated.
+    for (Entity e = 0; e < 500; e += 3) {
+        colliders.GetComponent(e).x += 9.5f;
+        colliders.MarkChanged(e, 1);
+    }
+    for (Entity e = 1; e < 500; e += 7) colliders.RemoveComponent(e);
+    colliders.Update();
+    check();
+    colliders.SetCellSize(25.f);
+    check();
+    REQUIRE_THROWS_AS(colliders.SetCellSize(0.f), std::runtime_error);
+
+    SECTION("Plane")
+    {
+        SpatialHashStorage<Marker2D> markers;
+        for (Entity e = 0; e < 100; ++e) markers.AddComponent(e) = Marker2D{ float(e % 10), float(e / 10) };
+        markers.Update();
+        std::vector<Entity> nearest;
+        markers.QueryNearest({ 4.2f, 4.9f, 0.f }, 3, nearest);
+        REQUIRE(nearest.size() == 3);
+        REQUIRE(nearest[0] == 54);
+        size_t num_pairs = 0;
+        markers.ForEachPair(1.f, [&](Entity, Entity) { ++num_pairs; });
+        REQUIRE(num_pairs == 180);
+    }
+
+    SECTION("Registry")
+    {
+        Registry registry;
+        registry.RegisterComponent<Collider>();
+        std::vector<Entity> entities;
+        for (int i = 0; i < 1000; ++i) {
+            entities.push_back(registry.CreateEntity().Build());
+            registry.AddComponent<Collider>(entities.back()) = Collider{ float(i % 100), float(i / 100), 0.f };
+        }
+        std::atomic<int> count{ 0 };
+        registry.RegisterSystem<CollisionSystem>(count);
+        registry.Run();
+        // Neighbours along both axes of a 100x10 lattice.
+        REQUIRE(count == 99 * 10 + 100 * 9);
+
+        std::stringstream stream;
+        registry.SaveSnapshot(stream);
+        const std::string snapshot = stream.str();
+        Registry loaded;
+        loaded.RegisterComponent<Collider>();
+        loaded.LoadSnapshot(snapshot.data(), snapshot.size());
+        std::atomic<int> loaded_count{ 0 };
+        loaded.RegisterSystem<CollisionSystem>(loaded_count);
+        loaded.Run();
+        REQUIRE(loaded_count == count);
+    }
+
+    SECTION("Parallel moves")
+    {
+        Registry registry(4);
+        registry.RegisterComponent<Collider>();
+        for (int i = 0; i < 1000; ++i) {
+            const Entity entity = registry.CreateEntity().Build();
+            registry.AddComponent<Collider>(entity) = Collider{ float(i % 100), float(i / 100), 0.f };
+        }
+        size_t count = 0;
+        registry.RegisterSystem<LiftSystem>();
+        registry.RegisterSystem<RadiusSystem>(count);
+        registry.Run();
+        // Only the lifted half of the lattice is around the point.
+        REQUIRE(count == 500);
+    }
+}
+
+struct Damage { ecs::Entity target; float amount; };
+struct Ping { int step; };
+struct Pong { int step; };
+
+// Receives Damage, registered before its sender but run after it.
+struct DamageReceiverSystem : public ecs::System {
+    using Receives = ecs::Events<Damage>;
+    float& m_total;
+    explicit DamageReceiverSystem(float& total) : m_total(total) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        access.Receive<Damage>().ForEachBatch([this](const Damage* events, size_t count) {
+            for (size_t i = 0; i < count; ++i) m_total += events[i].amount;
+        });
+    }
+};
+// Sends Damage from parallel subflow tasks.
+struct DamageSenderSystem : public ecs::System {
+    using Sends = ecs::Events<Damage>;
+    static constexpr int NUM_TASKS = 8, NUM_EVENTS = 100;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow& subflow) override
+    {
+        for (int t = 0; t < NUM_TASKS; ++t) {
+            subflow.emplace([&access, t]() {
+                for (int i = 0; i < NUM_EVENTS; ++i) access.Send(Damage{ ecs::Entity(t), 1.f });
+            });
+        }
+        subflow.join();
+    }
+};
+// Ping and pong receive what the other sends, so the later registered pong receives within the same step and
+// ping receives in the next one.
+struct PingSystem : public ecs::System {
+    using Sends    = ecs::Events<Ping>;
+    using Receives = ecs::Events<Pong>;
+    std::vector<int>& m_received;
+    int m_step = 0;
+    explicit PingSystem(std::vector<int>& received) : m_received(received) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        access.Receive<Pong>().ForEach([this](const Pong& pong) { m_received.push_back(pong.step); });
+        access.Send(Ping{ ++m_step });
+    }
+};
+struct PongSystem : public ecs::System {
+    using Sends    = ecs::Events<Pong>;
+    using Receives = ecs::Events<Ping>;
+    std::vector<int>& m_received;
+    bool m_valid = true;
+    explicit PongSystem(std::vector<int>& received) : m_received(received) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        auto pings = access.Receive<Ping>();
+        m_valid = m_valid && pings.Size() == 1;
+        pings.ForEach([this, &access](const Ping& ping) {
+            m_received.push_back(ping.step);
+            access.Send(Pong{ ping.step });
+        });
+        m_valid = m_valid && pings.Empty();
+        // Undeclared event types can neither be sent nor received.
+        try { access.Send(Damage{}); m_valid = false; } catch (const std::runtime_error&) {}
+        try { access.Receive<Pong>(); m_valid = false; } catch (const std::runtime_error&) {}
+    }
+};
+
+TEST_CASE("Events", "[registry|system]")
+{
+    using namespace ecs;
+    Registry registry;
+
+    float total = 0.f;
+    REQUIRE_THROWS_AS(registry.RegisterSystem<DamageReceiverSystem>(total), std::runtime_error);
+    REQUIRE_THROWS_AS(registry.SendEvent(Damage{}), std::runtime_error);
+    REQUIRE_NOTHROW(registry.RegisterEvent<Damage>());
+    REQUIRE_THROWS_AS(registry.RegisterEvent<Damage>(), std::runtime_error);
+    REQUIRE_NOTHROW(registry.RegisterSystem<DamageReceiverSystem>(total));
+    REQUIRE_NOTHROW(registry.RegisterSystem<DamageSenderSystem>());
+
+    // Events sent from outside are received during the next step along with those sent within it.
+    registry.SendEvent(Damage{ 0, 0.5f });
+    registry.Run();
+    constexpr int NUM_SENT = DamageSenderSystem::NUM_TASKS * DamageSenderSystem::NUM_EVENTS;
+    REQUIRE(total == NUM_SENT + 0.5f);
+    REQUIRE(registry.GetNumEvents<Damage>() == NUM_SENT + 1);
+    std::vector<int> per_target(DamageSenderSystem::NUM_TASKS, 0);
+    registry.ForEachEvent<Damage>([&per_target](const Damage& damage) { per_target[damage.target] += damage.amount == 1.f; });
+    REQUIRE(per_target == std::vector<int>(DamageSenderSystem::NUM_TASKS, DamageSenderSystem::NUM_EVENTS));
+
+    // Every event is received exactly once.
+    registry.Run();
+    REQUIRE(total == 2 * NUM_SENT + 0.5f);
+    REQUIRE(registry.GetNumEvents<Damage>() == NUM_SENT);
+
+    std::vector<int> pings, pongs;
+    REQUIRE_NOTHROW(registry.RegisterEvent<Ping>());
+    REQUIRE_NOTHROW(registry.RegisterEvent<Pong>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<PingSystem>(pongs));
+    REQUIRE_NOTHROW(registry.RegisterSystem<PongSystem>(pings));
+    registry.RunFor(3);
+    REQUIRE(pings == std::vector<int>{ 1, 2, 3 });
+    REQUIRE(pongs == std::vector<int>{ 1, 2 });
+    REQUIRE(registry.GetSystem<PongSystem>().m_valid);
+    REQUIRE(total == 5 * NUM_SENT + 0.5f);
+
+    registry.Reset();
+    REQUIRE_THROWS_AS(registry.GetNumEvents<Damage>(), std::runtime_error);
+}
+
+struct Signal { int step; };
+struct Echo { int step; };
+
+// Receives echoes and conflicts with SignalSystem, which is registered after it.
+struct EchoReceiverSystem : public ecs::System {
+    using Writes   = ecs::Components<TestData>;
+    using Receives = ecs::Events<Echo>;
+    std::vector<int>& m_received;
+    explicit EchoReceiverSystem(std::vector<int>& received) : m_received(received) {}
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        access.Receive<Echo>().ForEach([this](const Echo& echo) { m_received.push_back(echo.step); });
+    }
+};
+// Echoes every signal, so it runs before EchoReceiverSystem.
+struct RelaySystem : public ecs::System {
+    using Sends    = ecs::Events<Echo>;
+    using Receives = ecs::Events<Signal>;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        access.Receive<Signal>().ForEach([&access](const Signal& signal) { access.Send(Echo{ signal.step }); });
+    }
+};
+// Has to run after EchoReceiverSystem, which runs after RelaySystem, so RelaySystem receives its signals in the
+// next step instead of waiting for it.
+struct SignalSystem : public ecs::System {
+    using Writes = ecs::Components<TestData>;
+    using Sends  = ecs::Events<Signal>;
+    int m_step = 0;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override { access.Send(Signal{ ++m_step }); }
+};
+// Declares no access, so it must not send.
+struct UndeclaredSenderSystem : public ecs::System {
+    bool m_valid = true;
+    void Run(ecs::ComponentAccess& access, ecs::EntityQuery&, tf::Subflow&) override
+    {
+        try { access.Send(Signal{}); m_valid = false; } catch (const std::runtime_error&) {}
+    }
+};
+
+TEST_CASE("Event ordering", "[registry|system]")
+{
+    using namespace ecs;
+    Registry registry;
+    registry.RegisterComponent<TestData>();
+    registry.RegisterEvent<Signal>();
+    registry.RegisterEvent<Echo>();
+
+    // Conflicts take precedence over events, which would close the cycle signal -> relay -> echo receiver -> signal.
+    std::vector<int> echoes;
+    REQUIRE_NOTHROW(registry.RegisterSystem<EchoReceiverSystem>(echoes));
+    REQUIRE_NOTHROW(registry.RegisterSystem<RelaySystem>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<SignalSystem>());
+    REQUIRE_NOTHROW(registry.RegisterSystem<UndeclaredSenderSystem>());
+    registry.RunAsync(3).get();
+    REQUIRE(echoes == std::vector<int>{ 1, 2 });
+    REQUIRE(registry.GetSystem<UndeclaredSenderSystem>().m_valid);
+
+    // Declaring an access that conflicts with an explicit order fails and leaves the system undeclared.
+    REQUIRE_NOTHROW(registry.Precede<UndeclaredSenderSystem, EchoReceiverSystem>());
+    REQUIRE_THROWS_AS((registry.DeclareAccess<UndeclaredSenderSystem>(Components<>{}, Components<TestData>{})), std::runtime_error);
+    registry.RunAsync(1).get();
+    REQUIRE(echoes == std::vector<int>{ 1, 2, 3 });
+    REQUIRE(registry.GetSystem<UndeclaredSenderSystem>().m_valid);
+}